@@ -5,25 +5,20 @@ int LoadProg (Prog_t *prog, const char *filename)
     if (prog == nullptr || filename == nullptr) return TREE_NULLPTR_ARG;
     TreeVerify (&(prog -> tree));
 
-    FILE *file = fopen (filename, "r");
+    FILE *file = OpenStream (filename, "r");
     if (file == nullptr) return TREE_NULLPTR_ARG;
 
-    size_t filesize = GetSize (file);
-
-    char *text = (char *) calloc (filesize + 1, sizeof (char));
+    char *text = ReadStream (file, 0, nullptr);
     if (text == nullptr) return TREE_NULLPTR_ARG;
 
-    size_t len = fread (text, sizeof (char), filesize, file);
-    *(text + len) = '\0';
-
     char *ch = text;
 
     ch = Load_var_table  (prog, ch);
     ch = Load_func_table (prog, ch);
     ch = Load_tree       (prog, ch);
 
-    fclose (file);
-    free   (text);
+    CloseStream (file);
+    free        (text);
 
     TreeVerify (&(prog -> tree));
     return TREE_OK;
@@ -59,7 +54,7 @@ char *Load_func_table (Prog_t *prog, char *ch)
 
     sscanf (ch, "%d%n", &num_of_funcs, &symbs_read);
     ch += symbs_read;
-    char funcname [MAX_NAME_LEN] = "";
+    char funcname [MAX_NAME_LEN + 1] = "";          // room for the import mark
 
     for (; num_of_funcs > 0; num_of_funcs--)
     {
@@ -67,7 +62,20 @@ char *Load_func_table (Prog_t *prog, char *ch)
         sscanf (ch, "%s%n", funcname, &symbs_read);
         ch += symbs_read;
 
-        ProgAddFunc (prog, funcname);
+        // an imported function is marked and keeps its number of arguments, the rest are defined here
+        size_t mark_len = strlen (IMPORT_MARK);
+        int is_imported = strncmp (funcname, IMPORT_MARK, mark_len) == 0;
+
+        ProgAddFunc (prog, funcname + (is_imported ? mark_len : 0));
+
+        Func_t *func = prog -> func_table + prog -> func_table_size - 1;
+        func -> is_defined = !is_imported;
+
+        if (is_imported)
+        {
+            sscanf (ch, "%d%n", &(func -> num_of_args), &symbs_read);
+            ch += symbs_read;
+        }
     }
     return ch;
 }
@@ -80,39 +88,84 @@ char *Load_tree  (Prog_t *prog, char *ch)
     return ch;
 }
 
+// nodes nest as deep as the program is long, so the open ones are kept on their parent links, not on the C stack
 TreeElem_t *Read_node (char **ch_ptr)
 {
-    char *ch = *ch_ptr;
-    ch = SkipSpacesAndComments (ch);
+    char *ch = SkipSpacesAndComments (*ch_ptr);
     if (*ch != '{') return nullptr;
-    ch++;
-    ch = SkipSpacesAndComments (ch);
 
-    int type       = 0;
-    int value      = 0;
-    int symbs_read = 0;
+    TreeElem_t *root = nullptr;
+    TreeElem_t *elem = nullptr;                 // the innermost node not closed yet
 
-    sscanf (ch, "%d%n", &type, &symbs_read);
-    ch += symbs_read;
-    ch = SkipSpacesAndComments (ch);
+    do
+    {
+        ch = SkipSpacesAndComments (ch);
 
-    sscanf (ch, "%d%n", &value, &symbs_read);
-    ch += symbs_read;
+        if (*ch == '{')
+        {
+            TreeElem_t *node = Read_node_head (&ch);
+            if (node == nullptr || (elem && TYPE != TYPE_BLOCK && L && R))
+            {
+                Tree_free_data (node, NULL);
+                Tree_free_data (root, NULL);
+                return nullptr;
+            }
+
+            node -> parent = elem;
+
+            int err = 0;
+
+            if      (elem == nullptr)     root = node;
+            else if (TYPE == TYPE_BLOCK)  err  = BlockAddStmt (elem, node);
+            else if (L    == nullptr)     L    = node;
+            else                          R    = node;
+
+            if (err)
+            {
+                Tree_free_data (node, NULL);
+                Tree_free_data (root, NULL);
+                return nullptr;
+            }
+
+            elem = node;
+        }
+        else if (*ch == '}')
+        {
+            ch++;
+            elem = P;
+        }
+        else
+        {
+            Tree_free_data (root, NULL);
+            return nullptr;
+        }
+    } while (elem);
 
-    TreeElem_t *elem = CreateNode (type, value, NULL, NULL);
-    L = Read_node (&ch);
-    R = Read_node (&ch);
+    *ch_ptr = ch;
+    return root;
+}
 
-    if (L) LP = elem;
-    if (R) RP = elem;
+// "{ type value [@line]", the node without its children; a block takes any number of them
+TreeElem_t *Read_node_head (char **ch_ptr)
+{
+    char *ch = *ch_ptr + 1;
+    ch = SkipSpacesAndComments (ch);
 
+    // not sscanf: it takes the length of the whole rest of the text on every call
+    int type = (int) strtol (ch, &ch, 10);
     ch = SkipSpacesAndComments (ch);
-    if (*ch != '}')
-    {
-        Tree_free_data (elem, NULL);
-        return nullptr;
-    }
-    *ch_ptr = ch + 1;
+
+    int value = (int) strtol (ch, &ch, 10);
+    ch = SkipSpacesAndComments (ch);
+
+    int line = 0;
+    if (*ch == '@') line = (int) strtol (ch + 1, &ch, 10);
+
+    TreeElem_t *elem = type == TYPE_BLOCK ? CreateBlock (value) : CreateNode (type, value, NULL, NULL);
+    if (elem == nullptr) return nullptr;
+    elem -> line = line;
+
+    *ch_ptr = ch;
     return elem;
 }
 
@@ -149,67 +202,364 @@ char *SkipComment (char *ch)
 
 int GenerateAsm (Prog_t *prog, const char *filename)
 {
-    Get_var_indexes (prog);
+    if (Get_var_indexes (prog)) return TREE_INCORRECT_FORMAT;
     TreeDump (&(prog -> tree));
     
-    FILE *file = fopen (filename, "w");
+    FILE *file = OpenStream (filename, "w");
     if (file == nullptr) return TREE_NULLPTR_ARG;
 
-    Compile_prog (prog, file);
+    int err = Compile_prog (prog, file);
 
-    fclose (file);
+    CloseStream (file);
 
-    return TREE_OK;
+    return err ? TREE_INCORRECT_FORMAT : TREE_OK;
 }
 
 int Compile_prog (Prog_t *prog, FILE *file)
 {
     fprintf (file, "#ACCURACY 1000\n");
-    fprintf (file, "PUSH 0\n");
-    fprintf (file, "POP rdx\n");
-    fprintf (file, "PUSH %d\n", prog -> vars_in_main);
-    fprintf (file, "POP rcx\n");
-    fprintf (file, "JMP main\n");
 
-    if ((prog -> tree).data.left) Compile (prog, file, (prog -> tree).data.left);
+    // a unit starts nowhere, the linker puts the start code before all units
+    if (prog -> is_unit)
+    {
+        int err = Compile_exports (prog, file);
+        if (err) return err;
+    }
+    else
+    {
+        for (size_t index = 0; index < prog -> func_table_size; index++)
+        {
+            if ((prog -> func_table [index]).is_defined) continue;
+
+            fprintf (stderr, "Compilation error: function (%s) is imported, compile with %s and link.\n",
+                             (prog -> func_table [index]).name, UNIT_OPTION);
+            return COMP_ERROR;
+        }
+
+        fprintf (file, "PUSH 0\n");
+        fprintf (file, "POP rdx\n");
+        fprintf (file, "PUSH %d\n", prog -> vars_in_main);
+        fprintf (file, "POP rcx\n");
+        fprintf (file, "JMP %s\n", MAIN_LABEL);
+    }
+
+    TreeElem_t *elem = (prog -> tree).data.left;
+    if (elem == nullptr || TYPE != TYPE_BLOCK) return COMP_ERROR;
+
+    int index = 0;
+    int err   = COMP_OK;
+
+    for (; index < NSTMTS && IsVardec (*STMTS [index]) && err == COMP_OK; index++)
+        err = Compile_top (prog, file, STMTS [index]);
+
+    int first = index;
+    for (; index < NSTMTS && IsFuncdec (*STMTS [index]); index++);
+
+    if (err == COMP_OK) err = Compile_funcs (prog, file, STMTS + first, index - first);
+
+    for (; index < NSTMTS && err == COMP_OK; index++)
+        err = Compile_top (prog, file, STMTS [index]);
+
+    if (err) return err;
+
+    // main of a unit would run on into the next one
+    if (prog -> is_unit) Compile_hlt (file);
 
     return COMP_OK;
 }
 
-int Get_var_indexes (Prog_t *prog)
+// defined functions, and main when the unit has a body, can be called from other units;
+// functions go with their number of arguments, so the linker can check the imports against them
+int Compile_exports (Prog_t *prog, FILE *file)
 {
     TreeElem_t *elem = (prog -> tree).data.left;
+    if (elem == nullptr || TYPE != TYPE_BLOCK) return COMP_ERROR;
 
-    int count = 0;
-    size_t func_count = 0;
+    for (size_t index = 0; index < prog -> func_table_size; index++)
+    {
+        Func_t *func = prog -> func_table + index;
 
-    while (elem)
+        fprintf (file, "%s %s%s %d\n", func -> is_defined ? EXPORT_DIRECTIVE : IMPORT_DIRECTIVE, FUNC_LABEL, func -> name, func -> num_of_args);
+    }
+
+    TreeElem_t *body = NSTMTS > 0 ? STMTS [NSTMTS - 1] : nullptr;
+
+    if (body && body -> type == TYPE_BLOCK && body -> value == BLOCK_MAIN && ((TreeBlock_t *) body) -> size > 0)
+        fprintf (file, "%s %s\n", EXPORT_DIRECTIVE, MAIN_LABEL);
+
+    return COMP_OK;
+}
+
+int Compile_top (Prog_t *prog, FILE *file, TreeElem_t *stmt)
+{
+    // a function or main starts from scratch, so its code does not depend on what is before it
+    if (!IsVardec (*stmt))
     {
-        if (!L || !IsVardec (*L)) break;
-        (prog -> var_table [LVAL]).index_in_func = -(++count);
-        elem = R;
+        prog -> label = 0;
+        prog -> line  = 0;
     }
 
-    while (elem)
+    if (prog -> frag_dir && IsFuncdec (*stmt)) return Compile_func_cached (prog, file, stmt);
+
+    return Compile (prog, file, stmt);
+}
+
+// workers take runs of functions in order, each into its own buffer, and the buffers are joined in order;
+// the code of a function does not depend on the others, so any number of workers writes the same
+int Compile_funcs (Prog_t *prog, FILE *file, TreeElem_t **funcs, int num)
+{
+    unsigned threads_num = prog -> threads_num ? prog -> threads_num : std::thread::hardware_concurrency ();
+    if (threads_num > (unsigned) num) threads_num = (unsigned) num;
+
+    Codegen_job_t *jobs    = nullptr;
+    std::thread   *workers = nullptr;
+
+    if (threads_num > 1)
     {
-        if (func_count >= prog -> func_table_size) break;
+        jobs    = (Codegen_job_t *) calloc (threads_num, sizeof (Codegen_job_t));
+        workers = new (std::nothrow) std::thread [threads_num];
+    }
+
+    unsigned active = 0;
 
-        if (L && IsFuncdec (*L))
+    for (int done = 0; jobs && workers && active < threads_num; active++)
+    {
+        Codegen_job_t *job = jobs + active;
+
+        job -> prog  = *prog;
+        job -> funcs = funcs + done;
+        job -> num   = (num - done) / (int) (threads_num - active);
+        job -> buf   = tmpfile ();
+        if (job -> buf == nullptr) break;
+
+        done += job -> num;
+    }
+
+    int err = COMP_OK;
+
+    // no buffers, no workers: one after another straight into the file
+    if (active < threads_num || threads_num <= 1)
+    {
+        for (int index = 0; index < num && err == COMP_OK; index++) err = Compile_top (prog, file, funcs [index]);
+    }
+    else
+    {
+        for (unsigned worker = 0; worker < active; worker++) workers [worker] = std::thread (CodegenWorker, jobs + worker);
+        for (unsigned worker = 0; worker < active; worker++) workers [worker].join ();
+
+        for (unsigned worker = 0; worker < active && err == COMP_OK; worker++)
         {
-            func_count ++;
-            Count_func_vars (prog, L);
+            err = jobs [worker].err;
+
+            rewind (jobs [worker].buf);
+            if (err == COMP_OK) Append_stream (file, jobs [worker].buf);
         }
+    }
+
+    for (unsigned worker = 0; jobs && worker < active; worker++)
+        if (jobs [worker].buf) fclose (jobs [worker].buf);
+
+    free (jobs);
+    delete [] workers;
+
+    return err;
+}
+
+void CodegenWorker (Codegen_job_t *job)
+{
+    for (int index = 0; index < job -> num && job -> err == COMP_OK; index++)
+        job -> err = Compile_top (&(job -> prog), job -> buf, job -> funcs [index]);
+}
+
+int UseFragCache (Prog_t *prog, const char *dir)
+{
+#ifdef _WIN32
+    mkdir (dir);
+#else
+    mkdir (dir, 0777);
+#endif
+
+    struct stat info = {};
+    if (stat (dir, &info) || !S_ISDIR (info.st_mode)) return COMP_ERROR;
+
+    prog -> frag_dir = dir;
+
+    return COMP_OK;
+}
+
+// a function hashing the same as when it was compiled last is not compiled again, its asm is copied;
+// lines are kept from its first one, so a function that only moved in the file is still a hit
+int Compile_func_cached (Prog_t *prog, FILE *file, TreeElem_t *func)
+{
+    unsigned long long hash = 0;
+    if (Hash_func (prog, func, &hash)) return Compile (prog, file, func);
 
-        elem = R;
+    char frag_name [BUFSIZE] = "";
+    snprintf (frag_name, BUFSIZE, "%s/%016llx%s", prog -> frag_dir, hash, FRAG_EXT);
+
+    if (Append_frag (file, frag_name, func -> line) == COMP_OK) return COMP_OK;
+
+    // written aside and renamed, so another back never reads half a fragment
+    char temp_name [BUFSIZE + 32] = "";
+    snprintf (temp_name, sizeof (temp_name), "%s.%d.tmp", frag_name, (int) getpid ());
+
+    FILE *frag = fopen (temp_name, "w");
+    if (frag == nullptr) return Compile (prog, file, func);
+
+    prog -> line_base = func -> line;
+    int err = Compile (prog, frag, func);
+    prog -> line_base = 0;
+
+    if (fclose (frag) && err == COMP_OK) err = COMP_ERROR;
+    if (err == COMP_OK) err = Append_frag (file, temp_name, func -> line);
+
+    if (err || rename (temp_name, frag_name)) remove (temp_name);
+
+    return err;
+}
+
+// FNV-1a over the subtree in preorder; a node adds what its code depends on, the symbols by their slots
+int Hash_func (Prog_t *prog, TreeElem_t *func, unsigned long long *hash_p)
+{
+    Tree_stack_t stk = {};
+    if (StackCtor (&stk, BASE_CAPACITY)) return COMP_ERROR;
+
+    unsigned long long hash = Hash_bytes (FRAG_VERSION, strlen (FRAG_VERSION), 0xcbf29ce484222325ULL);
+
+    int err = 0;
+
+    TreeElem_t *elem = func;
+    while (elem && err == 0)
+    {
+        hash = Hash_node (prog, elem, func -> line, hash);
+
+        // the children present, or the shape is lost
+        int num = TreeChildrenNum (elem);
+        hash = Hash_bytes (&num, sizeof (num), hash);
+
+        for (int index = 0; index < num; index++)
+        {
+            char is_child = TreeChild (elem, index) != nullptr;
+            hash = Hash_bytes (&is_child, sizeof (is_child), hash);
+        }
+
+        err = Tree_push_children (&stk, elem);
+
+        elem = nullptr;
+        if (stk.size) StackPop (&stk, &elem);
     }
 
-    VAL = FIC_START;
+    StackDtor (&stk);
 
-    while (elem)
+    *hash_p = hash;
+
+    return err ? COMP_ERROR : COMP_OK;
+}
+
+unsigned long long Hash_node (Prog_t *prog, TreeElem_t *elem, int line_base, unsigned long long hash)
+{
+    int line = elem -> line ? elem -> line - line_base : INT_MIN;    // 0 - no line, not the first one
+
+    hash = Hash_bytes (&TYPE, sizeof (TYPE), hash);
+    hash = Hash_bytes (&line, sizeof (line), hash);
+
+    switch (TYPE)
+    {
+    case TYPE_VAR:
+    case TYPE_VARDEC:
+        return Hash_bytes (&((prog -> var_table [VAL]).index_in_func), sizeof (int), hash);
+
+    case TYPE_CALL:
+    {
+        const char *name = (prog -> func_table [VAL]).name;
+        return Hash_bytes (name, strlen (name) + 1, hash);
+    }
+
+    case TYPE_FUNCDEC:
     {
-        if (L) Count_vars (prog , L, &count, 1);
-        elem = R;
+        Func_t *func = prog -> func_table + VAL;
+
+        hash = Hash_bytes (func -> name, strlen (func -> name) + 1, hash);
+        hash = Hash_bytes (&(func -> num_of_args), sizeof (int), hash);
+        return Hash_bytes (&(func -> num_of_vars), sizeof (int), hash);
+    }
+
+    default:
+        return Hash_bytes (&VAL, sizeof (VAL), hash);
     }
+}
+
+unsigned long long Hash_bytes (const void *data, size_t size, unsigned long long hash)
+{
+    const unsigned char *byte = (const unsigned char *) data;
+
+    for (size_t index = 0; index < size; index++)
+    {
+        hash ^= byte [index];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+// a fragment has its #LINE from line_base, they are put back where the function is now
+int Append_frag (FILE *file, const char *name, int line_base)
+{
+    FILE *frag = fopen (name, "r");
+    if (frag == nullptr) return COMP_ERROR;
+
+    const size_t directive_len = strlen (LINE_DIRECTIVE);
+
+    char buf [STREAM_CHUNK] = "";
+    int line_start = 1;
+
+    while (fgets (buf, STREAM_CHUNK, frag))
+    {
+        char *end = nullptr;
+
+        if (line_start && strncmp (buf, LINE_DIRECTIVE, directive_len) == 0 && buf [directive_len] == ' ')
+        {
+            long line = strtol (buf + directive_len, &end, 10);
+            if (*end == '\n') fprintf (file, "%s %ld\n", LINE_DIRECTIVE, line + line_base);
+            else               end = nullptr;
+        }
+
+        if (end == nullptr) fputs (buf, file);
+
+        line_start = strchr (buf, '\n') != nullptr;
+    }
+
+    fclose (frag);
+
+    return COMP_OK;
+}
+
+void Append_stream (FILE *file, FILE *from)
+{
+    char buf [STREAM_CHUNK] = "";
+
+    size_t len = 0;
+    while ((len = fread (buf, sizeof (char), STREAM_CHUNK, from)) > 0) fwrite (buf, sizeof (char), len, file);
+}
+
+// the program is a block of global declarations, then functions, then the main body
+int Get_var_indexes (Prog_t *prog)
+{
+    TreeElem_t *elem = (prog -> tree).data.left;
+    if (elem == nullptr || TYPE != TYPE_BLOCK) return COMP_ERROR;
+
+    int count = 0;
+
+    int index = 0;
+
+    for (; index < NSTMTS && IsVardec (*STMTS [index]); index++)
+        (prog -> var_table [STMTS [index] -> value]).index_in_func = -(++count);
+
+    for (; index < NSTMTS && IsFuncdec (*STMTS [index]); index++)
+        Count_func_vars (prog, STMTS [index]);
+
+    for (; index < NSTMTS; index++)
+        Count_vars (prog, STMTS [index], &count, 1);
 
     prog -> vars_in_main = count;
 
@@ -239,95 +589,148 @@ void Count_func_vars (Prog_t *prog, TreeElem_t *func)
     return;
 }
 
+// numbers the variables in the order they are declared
 void Count_vars (Prog_t *prog, TreeElem_t *elem, int *count, int is_main)
 {
-    if (elem == nullptr) return;
+    Tree_stack_t stk = {};
+    if (StackCtor (&stk, BASE_CAPACITY)) return;
 
-    if (is_main && IsReturn (*elem)) 
+    while (elem)
     {
-        TYPE = TYPE_HLT;
-        return;
-    }
+        if (is_main && IsReturn (*elem)) TYPE = TYPE_HLT;
+        else
+        {
+            if (IsVardec (*elem))
+            {
+                if (is_main) (prog -> var_table [elem -> value]).index_in_func = -(++(*count));
+                else         (prog -> var_table [elem -> value]).index_in_func =   ++(*count) ;
+            }
 
-    if (IsVardec (*elem))
-    {
-        if (is_main) (prog -> var_table [elem -> value]).index_in_func = -(++(*count));
-        else         (prog -> var_table [elem -> value]).index_in_func =   ++(*count) ;
-    }
+            Tree_push_children (&stk, elem);
+        }
 
-    if (IsCall (*elem)) Replace_fic_with_call (L);
+        elem = nullptr;
+        if (stk.size) StackPop (&stk, &elem);
+    }
 
-    if (L) Count_vars (prog, L, count, is_main);
-    if (R) Count_vars (prog, R, count, is_main);
+    StackDtor (&stk);
 }
 
-void Replace_fic_with_call (TreeElem_t *elem)
+int Compile (Prog_t *prog, FILE *file, TreeElem_t *elem)
 {
-    if (elem == nullptr) return;
-    if (TYPE == TYPE_FIC) VAL = FIC_CALL;
+    Walk_ctx_t ctx = {prog, file};
 
-    Replace_fic_with_call (L);
-    Replace_fic_with_call (R);
+    return TreeWalk (elem, Compile_step, &ctx, 0);
 }
 
-int Compile (Prog_t *prog, FILE *file, TreeElem_t *elem)
+// one step of the node on top of the walk: the code before its next child, or after the last one
+int Compile_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx)
 {
-    if (elem == nullptr) return COMP_OK;
+    Prog_t *prog = ((Walk_ctx_t *) ctx) -> prog;
+    FILE   *file = ((Walk_ctx_t *) ctx) -> file;
+
+    TreeElem_t *elem = frame -> elem;
+
+    if (frame -> step == 0) Compile_line (prog, file, elem);
 
     switch (TYPE)
     {
     case TYPE_FIC:
-        return Compile_fic (prog, file, elem);
+        return Compile_fic (frame, child);
+
+    case TYPE_BLOCK:
+        return Compile_block (file, frame, child);
 
     case TYPE_NUM:
-        return Compile_num (file, elem);
+        Compile_num (file, elem);
+        return WALK_DONE;
 
     case TYPE_VAR:
-        return Compile_var (prog, file, elem);
+        Compile_var (prog, file, elem);
+        return WALK_DONE;
     
     case TYPE_IF:
-        return Compile_if (prog, file, elem);
+        return Compile_if (prog, file, frame, child);
         
     case TYPE_WHILE:
-        return Compile_while (prog, file, elem);
+        return Compile_while (prog, file, frame, child);
 
     case TYPE_OP:
-        return Compile_op (prog, file, elem);
+        return Compile_op (prog, file, frame, child);
     
     case TYPE_VARDEC:
-        return Compile_vardec (prog, file, elem);
+        Compile_vardec (prog, file, elem);
+        return WALK_DONE;
     
     case TYPE_FUNCDEC:
-        return Compile_funcdec (prog, file, elem);
+        return Compile_funcdec (prog, file, frame, child);
     
     case TYPE_CALL:
-        return Compile_call (prog, file, elem);
+        return Compile_call (prog, file, frame, child);
     
     case TYPE_RETURN:
-        return Compile_return (prog, file, elem);
+        return Compile_return (file, frame, child);
 
     case TYPE_HLT:
-        return Compile_hlt (file);
+        Compile_hlt (file);
+        return WALK_DONE;
 
     default:
         return COMP_ERROR;
     }
 }
 
-int Compile_fic (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Compile_line (Prog_t *prog, FILE *file, TreeElem_t *elem)
 {
-    if (VAL == FIC_START) fprintf (file, "main:\n");
-    if (L)
-    {   
-        Compile (prog, file, L);
-        if (VAL != FIC_CALL && (LTYPE == TYPE_OP || LTYPE == TYPE_NUM || LTYPE == TYPE_VAR || LTYPE == TYPE_CALL)) fprintf (file, "POP rax\n");
-    }
-    if (R)
-    {   
-        Compile (prog, file, R);
-        if (VAL != FIC_CALL && (RTYPE == TYPE_OP || RTYPE == TYPE_NUM || RTYPE == TYPE_VAR || RTYPE == TYPE_CALL)) fprintf (file, "POP rax\n");
+    if (elem -> line == 0 || elem -> line == prog -> line) return COMP_OK;
+
+    fprintf (file, "%s %d\n", LINE_DIRECTIVE, elem -> line - prog -> line_base);
+    prog -> line = elem -> line;
+
+    return COMP_OK;
+}
+
+// FICs are left in argument lists only, the values stay on the stack for the call
+int Compile_fic (TreeWalk_t *frame, TreeWalk_t *child)
+{
+    TreeElem_t *elem = frame -> elem;
+
+    switch (frame -> step)
+    {
+    case 0:
+        child -> elem = L;
+        return WALK_CHILD;
+
+    case 1:
+        child -> elem = R;
+        return WALK_CHILD;
+
+    default:
+        return WALK_DONE;
     }
-    return COMP_OK;;
+}
+
+// step n compiles statement n, after dropping what statement n - 1 left
+int Compile_block (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
+{
+    TreeElem_t *elem = frame -> elem;
+
+    int index = frame -> step;
+
+    if (index == 0 && VAL == BLOCK_MAIN) fprintf (file, "%s:\n", MAIN_LABEL);
+
+    if (index > 0) Compile_drop (file, STMTS [index - 1]);
+
+    if (index >= NSTMTS) return WALK_DONE;
+
+    child -> elem = STMTS [index];
+    return WALK_CHILD;
+}
+
+// an expression used as a statement leaves its value on the stack
+void Compile_drop (FILE *file, TreeElem_t *elem)
+{
+    if (TYPE == TYPE_OP || TYPE == TYPE_NUM || TYPE == TYPE_VAR || TYPE == TYPE_CALL) fprintf (file, "POP rax\n");
 }
 
 int Compile_num (FILE *file, TreeElem_t *elem)
@@ -345,73 +748,126 @@ int Compile_var (Prog_t *prog, FILE *file, TreeElem_t *elem)
     return COMP_OK;
 }
 
-int Compile_if (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Compile_if (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    Compile (prog, file, L);
+    TreeElem_t *elem = frame -> elem;
 
-    int label1 = prog -> label;
+    int label1 = frame -> arg;
     int label2 = label1 + 1;
 
-    prog -> label += 2;
+    switch (frame -> step)
+    {
+    case 0:
+        child -> elem = L;
+        return WALK_CHILD;
 
-    fprintf (file, "PUSH 0\n"
-                   "JE l%d\n", label1);
-    
-    Compile (prog, file, RL);
+    case 1:
+        frame -> arg = prog -> label;
+        prog -> label += 2;
 
-    fprintf (file, "JMP l%d\n"
-                   "l%d:\n", label2, label1);
-    
-    if (RR) Compile (prog, file, RR);
+        fprintf (file, "PUSH 0\n"
+                       "JE .l%d\n", frame -> arg);
 
-    fprintf (file, "l%d:\n", label2);
+        child -> elem = RL;
+        return WALK_CHILD;
 
-    return COMP_OK;
+    case 2:
+        Compile_line (prog, file, elem);
+        fprintf (file, "JMP .l%d\n"
+                       ".l%d:\n", label2, label1);
+
+        child -> elem = RR;
+        return WALK_CHILD;
+
+    default:
+        fprintf (file, ".l%d:\n", label2);
+        return WALK_DONE;
+    }
 }
 
-int Compile_while (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Compile_while (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    int label1 = prog -> label;
+    TreeElem_t *elem = frame -> elem;
+
+    int label1 = frame -> arg;
     int label2 = label1 + 1;
 
-    prog -> label += 2;
+    switch (frame -> step)
+    {
+    case 0:
+        frame -> arg = prog -> label;
+        prog -> label += 2;
 
-    fprintf (file, "l%d:\n", label1);
+        fprintf (file, ".l%d:\n", frame -> arg);
 
-    Compile (prog, file, L);
+        child -> elem = L;
+        return WALK_CHILD;
 
-    fprintf (file, "PUSH 0\n"
-                   "JE l%d\n", label2);
-    
-    Compile (prog, file, R);
+    case 1:
+        fprintf (file, "PUSH 0\n"
+                       "JE .l%d\n", label2);
 
-    fprintf (file, "JMP l%d\n"
-                   "l%d:\n", label1, label2);
+        child -> elem = R;
+        return WALK_CHILD;
 
-    return COMP_OK;
+    default:
+        Compile_line (prog, file, elem);
+        fprintf (file, "JMP .l%d\n"
+                       ".l%d:\n", label1, label2);
+        return WALK_DONE;
+    }
 }
 
-int Compile_op (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Compile_op (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    if (IsAssign (*elem)) return Compile_assign (prog, file, elem);
-    if (VAL == OP_IN)     return Compile_in     (file);
+    TreeElem_t *elem = frame -> elem;
 
-    Compile (prog, file, L);
+    if (IsAssign (*elem)) return Compile_assign (prog, file, frame, child);
 
-    if (IsOneargOp (*elem)) return Compile_onearg (prog, file, elem);
+    if (VAL == OP_IN)
+    {
+        Compile_in (file);
+        return WALK_DONE;
+    }
 
-    Compile (prog, file, R);
+    int err = COMP_OK;
 
-    if (IsArithm (*elem)) return Compile_arithm (file ,elem);
-    if (IsComp   (*elem)) return Compile_comp   (prog, file, elem);
-    if (IsLogic  (*elem)) return Compile_logic  (prog, file, elem);
+    switch (frame -> step)
+    {
+    case 0:
+        child -> elem = L;
+        return WALK_CHILD;
 
-    return COMP_ERROR;
+    case 1:
+        if (IsOneargOp (*elem))
+        {
+            err = Compile_onearg (prog, file, elem);
+            break;
+        }
+        child -> elem = R;
+        return WALK_CHILD;
+
+    default:
+        if      (IsArithm (*elem)) err = Compile_arithm (file ,elem);
+        else if (IsComp   (*elem)) err = Compile_comp   (prog, file, elem);
+        else if (IsLogic  (*elem)) err = Compile_logic  (prog, file, elem);
+        else                       err = COMP_ERROR;
+        break;
+    }
+
+    return err ? err : WALK_DONE;
 }
 
-int Compile_assign (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Compile_assign (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    Compile (prog, file, R);
+    TreeElem_t *elem = frame -> elem;
+
+    if (frame -> step == 0)
+    {
+        child -> elem = R;
+        return WALK_CHILD;
+    }
+
     fprintf (file, "POP rax\n"
                    "PUSH rax\n"
                    "PUSH rax\n");
@@ -420,7 +876,7 @@ int Compile_assign (Prog_t *prog, FILE *file, TreeElem_t *elem)
 
     if (index_in_func > 0) fprintf (file, "POP [rdx + %d]\n",  index_in_func);
     else                   fprintf (file, "POP [%d]      \n", -index_in_func);
-    return COMP_OK;
+    return WALK_DONE;
 }
 
 int Compile_onearg (Prog_t *prog, FILE *file, TreeElem_t *elem)
@@ -462,12 +918,12 @@ int Compile_out (FILE *file)
 int Compile_not (Prog_t *prog, FILE *file)
 {
     fprintf (file, "PUSH 0\n"
-                   "JE l%d\n"
+                   "JE .l%d\n"
                    "PUSH 0\n"
-                   "JMP l%d\n"
-                   "l%d:\n"
+                   "JMP .l%d\n"
+                   ".l%d:\n"
                    "PUSH 1\n"
-                   "l%d:\n", prog -> label, prog -> label + 1, prog -> label, prog -> label + 1);
+                   ".l%d:\n", prog -> label, prog -> label + 1, prog -> label, prog -> label + 1);
     prog -> label += 2;
     return COMP_OK;
 }
@@ -536,12 +992,12 @@ int Compile_comp (Prog_t *prog, FILE *file, TreeElem_t *elem)
         break;
     }
 
-    fprintf (file, "%s l%d\n"
+    fprintf (file, "%s .l%d\n"
                    "PUSH 0\n"
-                   "JMP l%d\n"
-                   "l%d:\n"
+                   "JMP .l%d\n"
+                   ".l%d:\n"
                    "PUSH 1\n"
-                   "l%d:\n", jump, prog -> label, prog -> label + 1, prog -> label, prog -> label + 1);
+                   ".l%d:\n", jump, prog -> label, prog -> label + 1, prog -> label, prog -> label + 1);
     prog -> label += 2;
 
     return COMP_OK;
@@ -561,15 +1017,15 @@ int Compile_logic (Prog_t *prog, FILE *file, TreeElem_t *elem)
 
     fprintf (file, "POP rax\n"
                    "PUSH 0\n"
-                   "%s l%d\n"
+                   "%s .l%d\n"
                    "PUSH 0\n"
                    "PUSH rax\n"
-                   "%s l%d\n"
+                   "%s .l%d\n"
                    "PUSH %d\n"
-                   "JMP l%d\n"
-                   "l%d:\n"
+                   "JMP .l%d\n"
+                   ".l%d:\n"
                    "PUSH %d\n"
-                   "l%d:", jump, prog -> label, jump, prog -> label, num, prog -> label + 1, prog -> label, !num, prog -> label + 1);
+                   ".l%d:", jump, prog -> label, jump, prog -> label, num, prog -> label + 1, prog -> label, !num, prog -> label + 1);
     prog -> label += 2;
 
     return COMP_OK;
@@ -587,9 +1043,13 @@ int Compile_vardec (Prog_t *prog, FILE *file, TreeElem_t *elem)
     return COMP_OK;
 }
 
-int Compile_funcdec (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Compile_funcdec (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    fprintf (file, "f%d:\n", VAL);
+    TreeElem_t *elem = frame -> elem;
+
+    if (frame -> step > 0) return WALK_DONE;
+
+    fprintf (file, "%s%s:\n", FUNC_LABEL, (prog -> func_table [VAL]).name);
 
     fprintf (file, "PUSH %d\n"
                    "POP rcx\n", (prog -> func_table [VAL]).num_of_vars);
@@ -598,22 +1058,29 @@ int Compile_funcdec (Prog_t *prog, FILE *file, TreeElem_t *elem)
     {
         fprintf (file, "POP [rdx + %d]\n", index);
     }
-    Compile (prog, file, R);
 
-    return COMP_OK;
+    child -> elem = R;
+    return WALK_CHILD;
 }
 
-int Compile_call (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Compile_call (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    fprintf (file, "PUSH rcx\n");
-    Compile (prog, file, L);
+    TreeElem_t *elem = frame -> elem;
+
+    if (frame -> step == 0)
+    {
+        fprintf (file, "PUSH rcx\n");
+        child -> elem = L;
+        return WALK_CHILD;
+    }
+
     fprintf (file, "PUSH rdx\n"
                    "PUSH 1\n"
                    "PUSH rcx\n"
                    "ADD\n"
                    "ADD\n"
                    "POP rdx\n"
-                   "CALL f%d\n"
+                   "CALL %s%s\n"
                    "POP rax\n"
                    "POP rcx\n"
                    "PUSH rdx\n"
@@ -622,16 +1089,20 @@ int Compile_call (Prog_t *prog, FILE *file, TreeElem_t *elem)
                    "ADD\n"
                    "SUB\n"
                    "POP rdx\n"
-                   "PUSH rax\n", VAL);
-    return COMP_OK;
+                   "PUSH rax\n", FUNC_LABEL, (prog -> func_table [VAL]).name);
+    return WALK_DONE;
 }
 
-int Compile_return (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Compile_return (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    Compile (prog, file, L);
-    fprintf (file, "RET\n");
+    if (frame -> step == 0)
+    {
+        child -> elem = frame -> elem -> left;
+        return WALK_CHILD;
+    }
 
-    return COMP_OK;
+    fprintf (file, "RET\n");
+    return WALK_DONE;
 }
 
 int Compile_hlt (FILE *file)
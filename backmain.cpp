@@ -4,29 +4,58 @@ FILE *LOG = NULL;
 
 int main (int argc, char *argv [])
 {
-    LOG = fopen (LOGFILENAME, "w");
-    if (LOG == nullptr) return 0;
-    fprintf (LOG, "<pre>\n");
+    const char *file_args [2] = {};
+    int     file_args_num = 0;
+    int           is_unit = 0;
+    const char  *frag_dir = nullptr;
+    unsigned  threads_num = 0;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if (TreeDumpOption (argv [index])) continue;
+        if (strcmp (argv [index], UNIT_OPTION) == 0)
+        {
+            is_unit = 1;
+            continue;
+        }
+        if (strcmp (argv [index], THREADS_OPTION) == 0 && index + 1 < argc)
+        {
+            int num = atoi (argv [++index]);
+            threads_num = num > 0 ? (unsigned) num : 0;
+            continue;
+        }
+        if (strcmp (argv [index], FRAG_CACHE_OPTION) == 0 && index + 1 < argc)
+        {
+            frag_dir = argv [++index];
+            continue;
+        }
+        if (file_args_num < 2) file_args [file_args_num++] = argv [index];
+    }
+
+    TreeDumpStart ();
 
     const char * input_file_name = nullptr;
     const char *output_file_name = nullptr;
 
-    if (argc >= 2)  input_file_name = argv [1];
-    else            input_file_name = "save.txt";
+    if (file_args_num >= 1)  input_file_name = file_args [0];
+    else                     input_file_name = "save.txt";
 
-    if (argc >= 3) output_file_name = argv [2];
-    else           output_file_name = "asm.txt";
+    if (file_args_num >= 2) output_file_name = file_args [1];
+    else                    output_file_name = "asm.txt";
 
     Prog_t prog = {};
     ProgCtor (&prog);
+    prog.is_unit     = is_unit;
+    prog.threads_num = threads_num;
+    if (frag_dir && UseFragCache (&prog, frag_dir)) fprintf (stderr, "Cannot use cache directory (%s), compiling everything.\n", frag_dir);
     LoadProg (&prog, input_file_name);
 
     TreeDump (&(prog.tree));
 
-    GenerateAsm (&prog, output_file_name);
+    int err = GenerateAsm (&prog, output_file_name);
 
     ProgDtor (&prog);
 
-    fclose (LOG);
-    return 0;
+    TreeDumpFinish ();
+    return err;
 }
\ No newline at end of file
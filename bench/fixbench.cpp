@@ -0,0 +1,54 @@
+#include <chrono>
+#include "../proc/proc.h"
+
+
+// fixbench.exe: ns per call of the fixed-point kernels and of the libm expressions they replaced
+
+const int FIX_BENCH_NUM  = 10000000;
+const int FIX_BENCH_COEF = 1000;
+
+static volatile arg_t BENCH_SINK = 0;
+static volatile arg_t BENCH_EXP  = 2 * FIX_BENCH_COEF;    // so the compiler does not turn pow (x, 2.0) into x * x
+
+static double Elapsed_ns (std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration <double, std::nano> (std::chrono::steady_clock::now () - start).count () / FIX_BENCH_NUM;
+}
+
+int main ()
+{
+    const int coef = FIX_BENCH_COEF;
+
+    auto start = std::chrono::steady_clock::now ();
+    for (int index = 0; index < FIX_BENCH_NUM; index++) BENCH_SINK = FixSqrt (index, coef);
+    double fix_sqrt = Elapsed_ns (start);
+
+    start = std::chrono::steady_clock::now ();
+    for (int index = 0; index < FIX_BENCH_NUM; index++) BENCH_SINK = (arg_t) (sqrt (((double) index) / coef) * coef);
+    double libm_sqrt = Elapsed_ns (start);
+
+    start = std::chrono::steady_clock::now ();
+    for (int index = 0; index < FIX_BENCH_NUM; index++) BENCH_SINK = FixSin (index, coef);
+    double fix_sin = Elapsed_ns (start);
+
+    start = std::chrono::steady_clock::now ();
+    for (int index = 0; index < FIX_BENCH_NUM; index++) BENCH_SINK = (arg_t) (sin (((double) index) / coef) * coef);
+    double libm_sin = Elapsed_ns (start);
+
+    // the discriminant of square.txt: b^2
+    start = std::chrono::steady_clock::now ();
+    for (int index = 0; index < FIX_BENCH_NUM; index++) BENCH_SINK = FixPow (index % 1000, BENCH_EXP, coef);
+    double fix_pow = Elapsed_ns (start);
+
+    start = std::chrono::steady_clock::now ();
+    for (int index = 0; index < FIX_BENCH_NUM; index++)
+        BENCH_SINK = (arg_t) (pow (((double) (index % 1000)) / coef, ((double) BENCH_EXP) / coef) * coef);
+    double libm_pow = Elapsed_ns (start);
+
+    printf ("ns per call  fixed  libm\n");
+    printf ("SQRT        %6.2f %6.2f\n", fix_sqrt, libm_sqrt);
+    printf ("SIN         %6.2f %6.2f\n", fix_sin,  libm_sin);
+    printf ("POW         %6.2f %6.2f\n", fix_pow,  libm_pow);
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <limits.h>
+#include "../proc/proc.h"
+
+
+// fixtest.exe: the fixed-point kernels against libm, the way cmd.h computed them before,
+// for every accuracy coefficient in FIX_TEST_COEFS; a result more than one unit away fails
+
+const int FIX_TEST_COEFS [] = {1, 10, 1000, 100000};
+const int FIX_TEST_NUM      = 1000000;
+const int FIX_TEST_MAX_ERR  = 1;
+
+static unsigned long long TEST_SEED = 0x9E3779B97F4A7C15ULL;
+
+static unsigned int Next_rand (void)
+{
+    TEST_SEED ^= TEST_SEED << 13;
+    TEST_SEED ^= TEST_SEED >> 7;
+    TEST_SEED ^= TEST_SEED << 17;
+
+    return (unsigned int) (TEST_SEED >> 32);
+}
+
+// in [-range, range]
+static long long Rand_range (long long range)
+{
+    return (long long) (Next_rand () % (unsigned long long) (2 * range + 1)) - range;
+}
+
+static long long Check (const char *name, int coef, long long got, double ref, long long *max_err)
+{
+    long long err = llabs (got - (long long) ref);
+    if (err > *max_err) *max_err = err;
+
+    if (err > FIX_TEST_MAX_ERR)
+    {
+        printf ("%s, coef %d: got %lld, libm %lld\n", name, coef, got, (long long) ref);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main ()
+{
+    long long fails = 0;
+
+    for (size_t index = 0; index < sizeof (FIX_TEST_COEFS) / sizeof (FIX_TEST_COEFS [0]); index++)
+    {
+        int coef = FIX_TEST_COEFS [index];
+
+        long long sqrt_err = 0;
+        long long  sin_err = 0;
+        long long  pow_err = 0;
+
+        for (int test = 0; test < FIX_TEST_NUM; test++)
+        {
+            arg_t x = (arg_t) (Next_rand () >> 1);
+            fails += Check ("SQRT", coef, FixSqrt (x, coef), sqrt (((double) x) / coef) * coef, &sqrt_err);
+
+            x = (arg_t) Rand_range (coef * 100LL > INT_MAX ? INT_MAX : coef * 100LL);
+            fails += Check ("SIN", coef, FixSin (x, coef), sin (((double) x) / coef) * coef, &sin_err);
+
+            arg_t base = (arg_t) Rand_range (10LL * coef);
+            arg_t exp  = (arg_t) ((Next_rand () % 7) * (unsigned) coef);
+
+            double ref = pow (((double) base) / coef, ((double) exp) / coef) * coef;
+            if (fabs (ref) > INT_MAX) continue;
+
+            fails += Check ("POW", coef, FixPow (base, exp, coef), ref, &pow_err);
+        }
+
+        printf ("coef %6d: max error SQRT %lld, SIN %lld, POW %lld\n", coef, sqrt_err, sin_err, pow_err);
+    }
+
+    printf ("%s\n", fails ? "FAILED" : "OK");
+
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,72 @@
+#include <chrono>
+#include "../stack/stack.h"
+
+
+// stackbench.exe: a stack whose size bounces over a power of two, as call and return do in recursive code;
+// trimming on every pop is what StackPop used to do, pushes and pops alone is what it does now
+
+const int STACK_BENCH_FILL    = 8;
+const int STACK_BENCH_LOW     = 2;
+const int STACK_BENCH_HIGH    = 5;
+const int STACK_BENCH_BOUNCES = 1000000;
+
+static volatile int BENCH_SINK = 0;
+
+template <typename Policy>
+static void Bench_policy (const char *name, int trim)
+{
+    Stack_t <int, Policy> stk = {};
+    StackCtor (&stk, 0);
+
+    for (int index = 0; index < STACK_BENCH_FILL; index++) StackPush (&stk, index);
+
+    int val = 0;
+    while ((int) stk.size > STACK_BENCH_HIGH) StackPop (&stk, &val);
+
+    long reallocs = 0;
+    size_t capacity = stk.capacity;
+
+    auto start = std::chrono::steady_clock::now ();
+
+    for (int bounce = 0; bounce < STACK_BENCH_BOUNCES; bounce++)
+    {
+        while ((int) stk.size > STACK_BENCH_LOW)
+        {
+            StackPop (&stk, &val);
+            if (trim) StackTrim (&stk);
+
+            if (stk.capacity != capacity) reallocs++;
+            capacity = stk.capacity;
+        }
+
+        while ((int) stk.size < STACK_BENCH_HIGH)
+        {
+            StackPush (&stk, val);
+
+            if (stk.capacity != capacity) reallocs++;
+            capacity = stk.capacity;
+        }
+    }
+
+    double ms = std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+    BENCH_SINK = val;
+    StackDtor (&stk);
+
+    printf ("%-8s %-13s %9.1f ms %9ld reallocs\n", name, trim ? "trim each pop" : "no trim", ms, reallocs);
+}
+
+int main ()
+{
+    printf ("%d elements, then the size bounces between %d and %d %d times\n",
+            STACK_BENCH_FILL, STACK_BENCH_LOW, STACK_BENCH_HIGH, STACK_BENCH_BOUNCES);
+
+    Bench_policy <Stack_none_t>   ("none",   1);
+    Bench_policy <Stack_none_t>   ("none",   0);
+    Bench_policy <Stack_canary_t> ("canary", 1);
+    Bench_policy <Stack_canary_t> ("canary", 0);
+    Bench_policy <Stack_hash_t>   ("hash",   1);
+    Bench_policy <Stack_hash_t>   ("hash",   0);
+
+    return 0;
+}
@@ -1,16 +1,440 @@
-#include <stdlib.h>
-#include <string.h>
+#include "compile.h"
 
+// compile.exe [--cache dir [--cache-max entries]] [--run] source ...
+// every source gets source.a and source.bin next to it, the tree never touches the disk without the cache
 int main (int argc, char *argv[])
 {
+    Cache_t cache = {};
+    cache.max_entries = CACHE_BASE_MAX;
+
+    int run = 0;
+
     for (int index = 1; index < argc; index++)
-    {   
-        char cmd [128] = "front.exe ";
-        strcat (cmd, argv[index]);
-        strcat (cmd, " treesave");
+    {
+        if      (strcmp (argv [index], CACHE_OPTION)     == 0 && index + 1 < argc) cache.dir = argv [++index];
+        else if (strcmp (argv [index], CACHE_MAX_OPTION) == 0 && index + 1 < argc) cache.max_entries = (size_t) atol (argv [++index]);
+        else if (strcmp (argv [index], RUN_OPTION)       == 0) run = 1;
+    }
+
+    Toolchain_t tools = {};
+
+    if (ToolchainInit (&tools, argv [0]))
+    {
+        fprintf (stderr, "Cannot find the directory of (%s).\n", argv [0]);
+        return DRIVER_FILE;
+    }
+
+    if (cache.dir && CacheInit (&cache, &tools))
+    {
+        fprintf (stderr, "Cannot use cache directory (%s).\n", cache.dir);
+        return DRIVER_FILE;
+    }
+
+    int ret = DRIVER_OK;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if (strcmp (argv [index], CACHE_OPTION) == 0 || strcmp (argv [index], CACHE_MAX_OPTION) == 0)
+        {
+            index++;
+            continue;
+        }
+        if (strcmp (argv [index], RUN_OPTION) == 0) continue;
+
+        int err = CompileSource (&tools, &cache, argv [index], run);
+        if (err)
+        {
+            fprintf (stderr, err == DRIVER_RUN ? "Cannot run (%s).\n" : "Cannot compile (%s).\n", argv [index]);
+            ret = err;
+        }
+    }
+
+    if (cache.dir) CacheReport (&cache, stderr);
+
+    return ret;
+}
+
+// the stages sit next to the driver; found through PATH, the driver name has no directory
+int ToolchainInit (Toolchain_t *tools, const char *driver_name)
+{
+    char dir [PATH_LEN] = "";
+
+    const char *slash = strrchr (driver_name, '/');
+#ifdef _WIN32
+    const char *back_slash = strrchr (driver_name, '\\');
+    if (back_slash && (slash == nullptr || back_slash > slash)) slash = back_slash;
+#endif
+
+    if (slash == nullptr)
+    {
+        if (Find_in_path (driver_name, dir)) return DRIVER_FILE;
+    }
+    else if (slash == driver_name) strcpy (dir, "/");
+    else
+    {
+        size_t len = (size_t) (slash - driver_name);
+        if (len >= PATH_LEN) return DRIVER_FILE;
+
+        memcpy (dir, driver_name, len);
+        dir [len] = '\0';
+    }
+
+    for (int stage = 0; stage < STAGES_NUM; stage++)
+        if (snprintf (tools -> stages [stage], PATH_LEN, "%s/%s", dir, STAGE_FILES [stage]) >= (int) PATH_LEN) return DRIVER_FILE;
+
+    return DRIVER_OK;
+}
+
+// the first PATH directory with the file, as the shell looks for a command; Windows looks in the current one first
+int Find_in_path (const char *name, char *dir)
+{
+    char file [PATH_LEN * 2] = "";
+
+#ifdef _WIN32
+    snprintf (file, sizeof (file), "%s.exe", name);
+    if (access (name, F_OK) == 0 || access (file, F_OK) == 0)
+    {
+        strcpy (dir, ".");
+        return DRIVER_OK;
+    }
+#endif
+
+    const char *path = getenv ("PATH");
+    if (path == nullptr) return DRIVER_FILE;
+
+    const char seps [] = {PATH_LIST_SEP, '\0'};
+
+    while (*path)
+    {
+        size_t len = strcspn (path, seps);
+
+        if (len > 0 && len < PATH_LEN)
+        {
+            memcpy (dir, path, len);
+            dir [len] = '\0';
+
+            snprintf (file, sizeof (file), "%s/%s", dir, name);
+            if (access (file, F_OK) == 0) return DRIVER_OK;
+
+            snprintf (file, sizeof (file), "%s/%s.exe", dir, name);
+            if (access (file, F_OK) == 0) return DRIVER_OK;
+        }
+
+        path += len;
+        if (*path) path++;
+    }
+
+    return DRIVER_FILE;
+}
+
+int CompileSource (const Toolchain_t *tools, Cache_t *cache, const char *src_name, int run)
+{
+    char asm_name [PATH_LEN] = "";
+    char bin_name [PATH_LEN] = "";
+
+    snprintf (asm_name, PATH_LEN, "%s%s", src_name, ASM_EXT);
+    snprintf (bin_name, PATH_LEN, "%s%s", src_name, BIN_EXT);
+
+    int err = cache -> dir ? Compile_cached (tools, cache, src_name, asm_name, bin_name) :
+                             Compile_stages (tools, src_name, nullptr, asm_name, bin_name);
+    if (err || !run) return err;
+
+    char cmd [CMD_LEN] = "";
+    if (Make_cmd (cmd, "\"%s\" \"%s\"", tools -> stages [STAGE_PROC], bin_name)) return DRIVER_FILE;
+
+    return Run_cmd (cmd) ? DRIVER_RUN : DRIVER_OK;
+}
+
+// tree_name nullptr - front and back are piped
+int Compile_stages (const Toolchain_t *tools, const char *src_name, const char *tree_name, const char *asm_name, const char *bin_name)
+{
+    char cmd [CMD_LEN] = "";
+
+    const char *front = tools -> stages [STAGE_FRONT];
+    const char *back  = tools -> stages [STAGE_BACK];
+
+    if (tree_name == nullptr)
+    {
+        if (Make_cmd (cmd, "\"%s\" \"%s\" - | \"%s\" - \"%s\"", front, src_name, back, asm_name)) return DRIVER_FILE;
+        if (Run_cmd (cmd)) return DRIVER_STAGE;
+    }
+    else
+    {
+        if (Make_cmd (cmd, "\"%s\" \"%s\" \"%s\"", front, src_name, tree_name)) return DRIVER_FILE;
+        if (Run_cmd (cmd)) return DRIVER_STAGE;
+
+        if (Make_cmd (cmd, "\"%s\" \"%s\" \"%s\"", back, tree_name, asm_name)) return DRIVER_FILE;
+        if (Run_cmd (cmd)) return DRIVER_STAGE;
+    }
+
+    if (Make_cmd (cmd, "\"%s\" \"%s\" \"%s\"", tools -> stages [STAGE_ASM], asm_name, bin_name)) return DRIVER_FILE;
+    if (Run_cmd (cmd)) return DRIVER_STAGE;
+
+    return DRIVER_OK;
+}
+
+// the entry is named by the hash of the source bytes and the toolchain, a hit only copies its files out
+int Compile_cached (const Toolchain_t *tools, Cache_t *cache, const char *src_name, const char *asm_name, const char *bin_name)
+{
+    unsigned long long hash = cache -> toolchain;
+    if (HashFile (src_name, &hash)) return DRIVER_FILE;
+
+    char entry       [PATH_LEN] = "";
+    char entry_asm   [PATH_LEN + 8] = "";
+    char entry_bin   [PATH_LEN + 8] = "";
+
+    snprintf (entry,     PATH_LEN,          "%s/%0*llx", cache -> dir, (int) CACHE_HASH_LEN, hash);
+    snprintf (entry_asm, sizeof (entry_asm), "%s%s", entry, ASM_EXT);
+    snprintf (entry_bin, sizeof (entry_bin), "%s%s", entry, BIN_EXT);
+
+    if (access (entry_bin, F_OK) == 0)
+    {
+        cache -> hits++;
+        utime (entry_bin, nullptr);             // the modification time is the last use
+    }
+    else
+    {
+        cache -> misses++;
+
+        int err = Cache_store (tools, src_name, entry);
+        if (err) return err;
+
+        CacheEvict (cache, entry_bin + strlen (cache -> dir) + 1);
+    }
+
+    if (Copy_file (entry_asm, asm_name) || Copy_file (entry_bin, bin_name)) return DRIVER_FILE;
+
+    return DRIVER_OK;
+}
+
+// the stages write temporary files that are renamed when all of them are done, bin the last,
+// so neither a failed stage nor another driver ever sees half an entry
+int Cache_store (const Toolchain_t *tools, const char *src_name, const char *entry)
+{
+    char temp [PATH_LEN + 32] = "";
+    snprintf (temp, sizeof (temp), "%s.%d.tmp", entry, (int) getpid ());
+
+    char temp_tree [PATH_LEN + 48] = "";
+    char temp_asm  [PATH_LEN + 48] = "";
+    char temp_bin  [PATH_LEN + 48] = "";
+
+    snprintf (temp_tree, sizeof (temp_tree), "%s%s", temp, TREE_EXT);
+    snprintf (temp_asm,  sizeof (temp_asm),  "%s%s", temp, ASM_EXT);
+    snprintf (temp_bin,  sizeof (temp_bin),  "%s%s", temp, BIN_EXT);
+
+    int err = Compile_stages (tools, src_name, temp_tree, temp_asm, temp_bin);
 
-        system (cmd);
-        system ("back.exe treesave asm.txt");
+    if (err == DRIVER_OK) err = Cache_publish (temp_tree, entry, TREE_EXT);
+    if (err == DRIVER_OK) err = Cache_publish (temp_asm,  entry,  ASM_EXT);
+    if (err == DRIVER_OK) err = Cache_publish (temp_bin,  entry,  BIN_EXT);
+
+    remove (temp_tree);
+    remove (temp_asm);
+    remove (temp_bin);
+
+    return err;
+}
+
+// losing the race to another driver is fine, its file is the same
+int Cache_publish (const char *temp_name, const char *entry, const char *ext)
+{
+    char name [PATH_LEN + 8] = "";
+    snprintf (name, sizeof (name), "%s%s", entry, ext);
+
+    if (rename (temp_name, name) && access (name, F_OK)) return DRIVER_FILE;
+
+    return DRIVER_OK;
+}
+
+int CacheInit (Cache_t *cache, const Toolchain_t *tools)
+{
+#ifdef _WIN32
+    mkdir (cache -> dir);
+#else
+    mkdir (cache -> dir, 0777);
+#endif
+
+    struct stat info = {};
+    if (stat (cache -> dir, &info) || !S_ISDIR (info.st_mode)) return DRIVER_FILE;
+
+    // a rebuilt stage changes every key, so stale artifacts are never hit; a stage that cannot be
+    // read would leave the key to the version alone
+    cache -> toolchain = HashBytes (TOOLCHAIN_VERSION, strlen (TOOLCHAIN_VERSION), 0xcbf29ce484222325ULL);
+
+    for (int stage = 0; stage <= STAGE_ASM; stage++)
+    {
+        if (HashFile (tools -> stages [stage], &(cache -> toolchain)) == DRIVER_OK) continue;
+
+        fprintf (stderr, "Cannot read (%s).\n", tools -> stages [stage]);
+        return DRIVER_FILE;
+    }
+
+    // a lowered --cache-max takes effect even if every source hits
+    CacheEvict (cache, nullptr);
+
+    return DRIVER_OK;
+}
+
+// entries above max_entries are removed, least recently used first; keep is the bin of the entry
+// just stored, times are in seconds and it must not lose a tie with its neighbours (nullptr - none)
+void CacheEvict (Cache_t *cache, const char *keep)
+{
+    DIR *dir = opendir (cache -> dir);
+    if (dir == nullptr) return;
+
+    Cache_entry_t *entries = nullptr;
+    size_t num     = 0;
+    size_t max_num = 0;
+
+    size_t bin_len = strlen (BIN_EXT);
+
+    for (struct dirent *file = readdir (dir); file != nullptr; file = readdir (dir))
+    {
+        size_t len = strlen (file -> d_name);
+        if (len != CACHE_HASH_LEN + bin_len || strcmp (file -> d_name + CACHE_HASH_LEN, BIN_EXT)) continue;
+        if (keep && strcmp (file -> d_name, keep) == 0) continue;
+
+        if (num >= max_num)
+        {
+            size_t new_num = max_num ? max_num * 2 : CACHE_BASE_MAX;
+
+            Cache_entry_t *new_entries = (Cache_entry_t *) realloc (entries, new_num * sizeof (Cache_entry_t));
+            if (new_entries == nullptr) break;
+
+            entries = new_entries;
+            max_num = new_num;
+        }
+
+        char path [PATH_LEN * 2] = "";
+        snprintf (path, sizeof (path), "%s/%s", cache -> dir, file -> d_name);
+
+        struct stat info = {};
+        if (stat (path, &info)) continue;
+
+        snprintf (entries [num].name, PATH_LEN, "%s", file -> d_name);
+        entries [num].used = info.st_mtime;
+        num++;
+    }
+
+    closedir (dir);
+
+    // the kept entry is one of max_entries
+    size_t room = keep == nullptr ? cache -> max_entries : cache -> max_entries > 0 ? cache -> max_entries - 1 : 0;
+
+    if (num > room)
+    {
+        qsort (entries, num, sizeof (Cache_entry_t), Compare_entries);
+
+        for (size_t index = 0; index < num - room; index++)
+        {
+            char entry [PATH_LEN * 2] = "";
+            snprintf (entry, sizeof (entry), "%s/%.*s", cache -> dir, (int) CACHE_HASH_LEN, entries [index].name);
+
+            // bin goes first, without it the entry is a miss
+            char path [PATH_LEN * 2 + 8] = "";
+            snprintf (path, sizeof (path), "%s%s", entry,  BIN_EXT); remove (path);
+            snprintf (path, sizeof (path), "%s%s", entry,  ASM_EXT); remove (path);
+            snprintf (path, sizeof (path), "%s%s", entry, TREE_EXT); remove (path);
+
+            cache -> evicted++;
+        }
+    }
+
+    free (entries);
+}
+
+int Compare_entries (const void *entry1, const void *entry2)
+{
+    time_t used1 = ((const Cache_entry_t *) entry1) -> used;
+    time_t used2 = ((const Cache_entry_t *) entry2) -> used;
+
+    return (used1 > used2) - (used1 < used2);
+}
+
+void CacheReport (Cache_t *cache, FILE *stream)
+{
+    fprintf (stream, "cache: %u hits, %u misses, %u evicted\n", (unsigned) cache -> hits, (unsigned) cache -> misses, (unsigned) cache -> evicted);
+}
+
+// FNV-1a over the file, continuing from *hash_p
+int HashFile (const char *file_name, unsigned long long *hash_p)
+{
+    FILE *file = fopen (file_name, "rb");
+    if (file == nullptr) return DRIVER_FILE;
+
+    unsigned char *buf = (unsigned char *) calloc (COPY_CHUNK, sizeof (char));
+    if (buf == nullptr)
+    {
+        fclose (file);
+        return DRIVER_ALLOC;
+    }
+
+    size_t len = 0;
+    while ((len = fread (buf, sizeof (char), COPY_CHUNK, file)) > 0) *hash_p = HashBytes (buf, len, *hash_p);
+
+    int err = ferror (file) ? DRIVER_FILE : DRIVER_OK;
+
+    free (buf);
+    fclose (file);
+
+    return err;
+}
+
+unsigned long long HashBytes (const void *data, size_t size, unsigned long long hash)
+{
+    const unsigned char *byte = (const unsigned char *) data;
+
+    for (size_t index = 0; index < size; index++)
+    {
+        hash ^= byte [index];
+        hash *= 0x100000001b3ULL;
     }
-    return 0;
-}
\ No newline at end of file
+
+    return hash;
+}
+
+int Copy_file (const char *from_name, const char *to_name)
+{
+    FILE *from = fopen (from_name, "rb");
+    if (from == nullptr) return DRIVER_FILE;
+
+    FILE *to = fopen (to_name, "wb");
+    if (to == nullptr)
+    {
+        fclose (from);
+        return DRIVER_FILE;
+    }
+
+    unsigned char *buf = (unsigned char *) calloc (COPY_CHUNK, sizeof (char));
+
+    int err = buf ? DRIVER_OK : DRIVER_ALLOC;
+
+    size_t len = 0;
+    while (err == DRIVER_OK && (len = fread (buf, sizeof (char), COPY_CHUNK, from)) > 0)
+        if (fwrite (buf, sizeof (char), len, to) != len) err = DRIVER_FILE;
+
+    free (buf);
+    fclose (from);
+    if (fclose (to)) err = DRIVER_FILE;
+
+    return err;
+}
+
+// every path in a command is quoted, a command that does not fit is an error, not a shorter command
+int Make_cmd (char *cmd, const char *format, ...)
+{
+    va_list args;
+    va_start (args, format);
+
+    int len = vsnprintf (cmd, CMD_LEN, format, args);
+
+    va_end (args);
+
+    return len < 0 || (size_t) len >= CMD_LEN ? DRIVER_FILE : DRIVER_OK;
+}
+
+// nonzero - the command failed
+int Run_cmd (const char *cmd)
+{
+    return system (cmd) != 0;
+}
@@ -0,0 +1,117 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+
+// the driver: every source goes through front, back and asm, with --cache the artifacts are kept
+// in a directory under the hash of the source and the toolchain, and a hit runs no stage at all
+
+const char CACHE_OPTION     [] = "--cache";
+const char CACHE_MAX_OPTION [] = "--cache-max";     // entries kept, the least recently used go first
+const char RUN_OPTION       [] = "--run";           // run each program after it is compiled
+
+const char TOOLCHAIN_VERSION [] = "16";             // bytecode version, the executables are hashed too
+
+#ifdef _WIN32
+const char PATH_LIST_SEP = ';';
+#else
+const char PATH_LIST_SEP = ':';
+#endif
+
+const char TREE_EXT [] = ".tree";
+const char  ASM_EXT [] = ".a";
+const char  BIN_EXT [] = ".bin";                    // written last, an entry without it is not complete
+
+const size_t CMD_LEN           = 1024;
+const size_t PATH_LEN          = 512;
+const size_t COPY_CHUNK        = 1 << 16;
+const size_t CACHE_BASE_MAX    = 256;
+const size_t CACHE_HASH_LEN    = 16;                // hex digits of the key in the entry names
+
+// the stages are taken from the directory compile.exe is in, the same files are run and hashed
+enum STAGES
+{
+    STAGE_FRONT = 0,
+    STAGE_BACK  = 1,
+    STAGE_ASM   = 2,                                // the stages up to it make the cached artifacts
+    STAGE_PROC  = 3,
+    STAGES_NUM  = 4,
+};
+
+const char *const STAGE_FILES [STAGES_NUM] = {"front.exe", "back.exe", "asm.exe", "proc.exe"};
+
+enum DRIVER_ERRORS
+{
+    DRIVER_OK         = 0,
+    DRIVER_STAGE      = 1,                          // front, back or asm failed
+    DRIVER_FILE       = 2,
+    DRIVER_ALLOC      = 3,
+    DRIVER_RUN        = 4,                          // the program ran by --run failed
+};
+
+struct Toolchain_t
+{
+    char stages [STAGES_NUM][PATH_LEN];
+};
+
+struct Cache_t
+{
+    const char *dir;                                // nullptr - no cache
+    size_t max_entries;
+
+    unsigned long long toolchain;                   // hash of the version and the stage executables
+
+    size_t hits;
+    size_t misses;
+    size_t evicted;
+};
+
+struct Cache_entry_t
+{
+    char   name [PATH_LEN];                         // <hash>.bin
+    time_t used;
+};
+
+
+int ToolchainInit (Toolchain_t *tools, const char *driver_name);
+
+int Find_in_path (const char *name, char *dir);
+
+int CompileSource (const Toolchain_t *tools, Cache_t *cache, const char *src_name, int run);
+
+int Compile_stages (const Toolchain_t *tools, const char *src_name, const char *tree_name, const char *asm_name, const char *bin_name);
+
+int Compile_cached (const Toolchain_t *tools, Cache_t *cache, const char *src_name, const char *asm_name, const char *bin_name);
+
+int Cache_store (const Toolchain_t *tools, const char *src_name, const char *entry);
+
+int Cache_publish (const char *temp_name, const char *entry, const char *ext);
+
+int CacheInit (Cache_t *cache, const Toolchain_t *tools);
+
+void CacheEvict (Cache_t *cache, const char *keep);
+
+int Compare_entries (const void *entry1, const void *entry2);
+
+void CacheReport (Cache_t *cache, FILE *stream);
+
+int HashFile (const char *file_name, unsigned long long *hash_p);
+
+unsigned long long HashBytes (const void *data, size_t size, unsigned long long hash);
+
+int Copy_file (const char *from_name, const char *to_name);
+
+int Make_cmd (char *cmd, const char *format, ...);
+
+int Run_cmd (const char *cmd);
+
+#endif
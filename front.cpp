@@ -27,6 +27,7 @@ int ProgCtor (Prog_t *prog)
     prog ->       code_size = 0;
 
     prog -> index = 0;
+    prog -> line  = 0;
 
     TreeCtor (&(prog -> tree));
 
@@ -137,6 +138,7 @@ int ProgAddNode (Prog_t *prog, int type, int value)
 
     prog -> code [prog -> code_size].type   = type;
     prog -> code [prog -> code_size].value  = value;
+    prog -> code [prog -> code_size].line   = prog -> line;
     prog -> code [prog -> code_size].left   = nullptr;
     prog -> code [prog -> code_size].right  = nullptr;
     prog -> code [prog -> code_size].parent = nullptr;
@@ -150,33 +152,16 @@ char *ReadProg (const char *filename)
 {
     if (filename == nullptr) return nullptr;
 
-    FILE *file = fopen (filename, "r");
+    FILE *file = OpenStream (filename, "r");
     if (file == nullptr) return nullptr;
 
-    size_t filesize = GetSize (file);
+    char *text = ReadStream (file, 1, nullptr);
 
-    char *text = (char *) calloc (filesize + 2, sizeof (char));
-    if (text == nullptr) return nullptr;
-
-    size_t len = fread (text + 1, sizeof (char), filesize, file);
-    *text             = '\0';
-    *(text + len + 1) = '\0';
-
-    fclose (file);
+    CloseStream (file);
 
     return text;
 }
 
-size_t GetSize (FILE *inp_file)
-{
-    if (inp_file == NULL) return 0;
-    struct stat stat_buf = {};
-
-    fstat (fileno (inp_file), &stat_buf);
-    return stat_buf.st_size;
-}
-
-
 int GetCode (Prog_t *prog, char *text)
 {
     if (prog == nullptr || text == nullptr) return TREE_NULLPTR_ARG;
@@ -185,11 +170,18 @@ int GetCode (Prog_t *prog, char *text)
     char *ch = text + strlen (text + 1);
     int err = COMP_OK;
 
-    Stack_t vis_stk = {};
+    // text is read from the end, so lines are counted down from the last one
+    char *line_ch = ch;
+    prog -> line = 1;
+    for (char *cur = text + 1; cur < ch; cur++) if (*cur == '\n') prog -> line++;
+
+    Stack_t <int> vis_stk = {};
     StackCtor (&vis_stk, BASE_CAPACITY);
 
     while (ch > text)
     {
+        while (line_ch > ch) if (*(--line_ch) == '\n') prog -> line--;
+
         if (isspace (*ch))
         {
             ch--;
@@ -227,7 +219,7 @@ int GetCode (Prog_t *prog, char *text)
             err = Read_num (&ch, &num);
             if (err)
             {
-                printf ("Syntax error: incorrect number format.\n");
+                fprintf (stderr, "Syntax error: incorrect number format.\n");
                 return err;
             }
             ProgAddNode (prog, TYPE_NUM, num);
@@ -239,7 +231,7 @@ int GetCode (Prog_t *prog, char *text)
             err = Read_word (&ch, WHILE_WORD);
             if (err)
             {
-                printf ("Syntax error: incorrect while word.\n");
+                fprintf (stderr, "Syntax error: incorrect while word.\n");
                 return err;
             }
             ProgAddNode (prog, TYPE_WHILE, 0);
@@ -251,7 +243,7 @@ int GetCode (Prog_t *prog, char *text)
             err = Read_word (&ch, IF_WORD);
             if (err)
             {
-                printf ("Syntax error: incorrect if word.\n");
+                fprintf (stderr, "Syntax error: incorrect if word.\n");
                 return err;
             }
             ProgAddNode (prog, TYPE_IF, 0);
@@ -263,7 +255,7 @@ int GetCode (Prog_t *prog, char *text)
             err = Read_word (&ch, ELSE_WORD);
             if (err)
             {
-                printf ("Syntax error: incorrect else word.\n");
+                fprintf (stderr, "Syntax error: incorrect else word.\n");
                 return err;
             }
             ProgAddNode (prog, TYPE_ELSE, 0);
@@ -275,7 +267,7 @@ int GetCode (Prog_t *prog, char *text)
             err = Read_word (&ch, SQRT_WORD);
             if (err)
             {
-                printf ("Syntax error: incorrect sqrt word.\n");
+                fprintf (stderr, "Syntax error: incorrect sqrt word.\n");
                 return err;
             }
             ProgAddNode (prog, TYPE_OP, OP_SQRT);
@@ -287,7 +279,7 @@ int GetCode (Prog_t *prog, char *text)
             err = Read_word (&ch, SIN_WORD);
             if (err)
             {
-                printf ("Syntax error: incorrect sqrt word.\n");
+                fprintf (stderr, "Syntax error: incorrect sqrt word.\n");
                 return err;
             }
             ProgAddNode (prog, TYPE_OP, OP_SIN);
@@ -328,7 +320,7 @@ int GetCode (Prog_t *prog, char *text)
             err = Read_word (&ch, VARDEC_WORD);
             if (err)
             {
-                printf ("Syntax error: incorrect variable declaration word.\n");
+                fprintf (stderr, "Syntax error: incorrect variable declaration word.\n");
                 return err;
             }
             err = Prog_dec_var (prog, &ch, start_of_area_index, 1);
@@ -347,6 +339,12 @@ int GetCode (Prog_t *prog, char *text)
             if (err) return err;
             continue;
         }
+        if (*ch == '@')
+        {
+            err = Prog_import_func (prog, &ch);
+            if (err) return err;
+            continue;
+        }
 
         switch (*ch)
         {
@@ -423,7 +421,7 @@ int GetCode (Prog_t *prog, char *text)
             break;
 
         default:
-            printf ("Compilation error: unknown symbol \"%c\".\n", *ch);
+            fprintf (stderr, "Compilation error: unknown symbol \"%c\".\n", *ch);
             return COMP_ERROR;
         }
 
@@ -432,7 +430,7 @@ int GetCode (Prog_t *prog, char *text)
 
     if (vis_stk.size != 0)
     {
-        printf ("Syntax error: missing \"\\\".\n");
+        fprintf (stderr, "Syntax error: missing \"\\\".\n");
         return COMP_ERROR;
     }
 
@@ -503,7 +501,7 @@ int Back_skip_comment (char **ch_ptr)
 
     if (*ch == '\0')
     {
-        printf ("Syntax error: no end of comment.\n");
+        fprintf (stderr, "Syntax error: no end of comment.\n");
         return COMP_ERROR;
     }
 
@@ -511,17 +509,17 @@ int Back_skip_comment (char **ch_ptr)
     return COMP_OK;
 }
 
-int Start_of_area (Prog_t *prog, Stack_t *stk)
+int Start_of_area (Prog_t *prog, Stack_t <int> *stk)
 {
     StackPush (stk, (int) (prog -> var_table_size));
     return COMP_OK;
 }
 
-int End_of_area (Prog_t *prog, Stack_t *stk)
+int End_of_area (Prog_t *prog, Stack_t <int> *stk)
 {
     if (stk -> size == 0)
     {
-        printf ("Syntax error: \"\\\" without \"/\".\n");
+        fprintf (stderr, "Syntax error: \"\\\" without \"/\".\n");
         return COMP_ERROR;
     }
 
@@ -538,7 +536,7 @@ int Prog_dec_var (Prog_t *prog, char **ch_ptr, int start_of_area_index, int addn
 {
     if (!(isalpha (**ch_ptr) || **ch_ptr == '_'))
     {
-        printf ("Syntax error: missing variable name in variable declaration.\n");
+        fprintf (stderr, "Syntax error: missing variable name in variable declaration.\n");
         return COMP_ERROR;
     }
     char buf [MAX_NAME_LEN] = "";
@@ -549,7 +547,7 @@ int Prog_dec_var (Prog_t *prog, char **ch_ptr, int start_of_area_index, int addn
     int index = GetVarIndex (prog, buf);
     if (index >= start_of_area_index)
     {
-        printf ("Compilation error: multiple declaration of variable (%s).\n", buf);
+        fprintf (stderr, "Compilation error: multiple declaration of variable (%s).\n", buf);
         return COMP_ERROR;
     }
 
@@ -559,13 +557,13 @@ int Prog_dec_var (Prog_t *prog, char **ch_ptr, int start_of_area_index, int addn
     return COMP_OK;
 }
 
-int Prog_dec_func (Prog_t *prog, char **ch_ptr, Stack_t *stk)
+int Prog_dec_func (Prog_t *prog, char **ch_ptr, Stack_t <int> *stk)
 {
     *ch_ptr -= 1;
 
     if (!(isalpha (**ch_ptr) || **ch_ptr == '_'))
     {
-        printf ("Syntax error: missing function name in function declaration.\n");
+        fprintf (stderr, "Syntax error: missing function name in function declaration.\n");
         return COMP_ERROR;
     }
 
@@ -578,11 +576,12 @@ int Prog_dec_func (Prog_t *prog, char **ch_ptr, Stack_t *stk)
 
     if (index >= 0)
     {
-        printf ("Compilation error: multiple declaration of function (%s).\n", buf);
+        fprintf (stderr, "Compilation error: multiple declaration of function (%s).\n", buf);
         return COMP_ERROR;
     }
 
     ProgAddFunc (prog, buf);
+    (prog -> func_table [prog -> func_table_size - 1]).is_defined = 1;
 
     ProgAddNode (prog, TYPE_FUNCDEC, (int) (prog -> func_table_size - 1));
     Start_of_area (prog, stk);
@@ -601,7 +600,7 @@ int Prog_read_func_args (Prog_t *prog, char **ch_ptr, int start_of_area_index)
 
     if (*ch != '{')
     {
-        printf ("Syntax error: missing arguments in declaration of function.\n");
+        fprintf (stderr, "Syntax error: missing arguments in declaration of function.\n");
         return COMP_ERROR;
     }
     ch--;
@@ -619,7 +618,7 @@ int Prog_read_func_args (Prog_t *prog, char **ch_ptr, int start_of_area_index)
         }
         else
         {
-            printf ("Syntax error: incorrect argumetns format in declaration of function.\n");
+            fprintf (stderr, "Syntax error: incorrect argumetns format in declaration of function.\n");
             return COMP_ERROR;
         }
     }
@@ -628,7 +627,7 @@ int Prog_read_func_args (Prog_t *prog, char **ch_ptr, int start_of_area_index)
     BackSkipSpaces (&ch);
     if (*ch != '/')
     {
-        printf ("Compilation error: missing body in declaration of function.\n");
+        fprintf (stderr, "Compilation error: missing body in declaration of function.\n");
         return COMP_ERROR;
     }
 
@@ -638,6 +637,70 @@ int Prog_read_func_args (Prog_t *prog, char **ch_ptr, int start_of_area_index)
     return COMP_OK;
 }
 
+// "@name {a b}.," declares a function of another unit, the names only count the arguments
+int Prog_import_func (Prog_t *prog, char **ch_ptr)
+{
+    *ch_ptr -= 1;
+
+    if (!(isalpha (**ch_ptr) || **ch_ptr == '_'))
+    {
+        fprintf (stderr, "Syntax error: missing function name in import.\n");
+        return COMP_ERROR;
+    }
+
+    char buf [MAX_NAME_LEN] = "";
+
+    int err = Read_var (ch_ptr, buf, MAX_NAME_LEN);
+    if (err) return err;
+
+    if (GetFuncIndex (prog, buf) >= 0)
+    {
+        fprintf (stderr, "Compilation error: multiple declaration of function (%s).\n", buf);
+        return COMP_ERROR;
+    }
+
+    err = ProgAddFunc (prog, buf);
+    if (err) return err;
+
+    BackSkipSpaces (ch_ptr);
+    if (**ch_ptr != '{')
+    {
+        fprintf (stderr, "Syntax error: missing arguments in import.\n");
+        return COMP_ERROR;
+    }
+    (*ch_ptr)--;
+
+    while (1)
+    {
+        BackSkipSpaces (ch_ptr);
+        if (**ch_ptr == '}') break;
+
+        if (!(isalpha (**ch_ptr) || **ch_ptr == '_'))
+        {
+            fprintf (stderr, "Syntax error: incorrect arguments format in import.\n");
+            return COMP_ERROR;
+        }
+
+        char argname [MAX_NAME_LEN] = "";
+
+        err = Read_var (ch_ptr, argname, MAX_NAME_LEN);
+        if (err) return err;
+
+        (prog -> func_table [prog -> func_table_size - 1]).num_of_args++;
+    }
+    (*ch_ptr)--;
+
+    BackSkipSpaces (ch_ptr);
+    if (**ch_ptr != ',' || *(*ch_ptr - 1) != '.')
+    {
+        fprintf (stderr, "Syntax error: missing semicolon after import.\n");
+        return COMP_ERROR;
+    }
+    *ch_ptr -= 2;
+
+    return COMP_OK;
+}
+
 int Func_add_arg (Func_t *func, int index)
 {
     func -> num_of_args += 1;
@@ -671,7 +734,7 @@ int Prog_read_var (Prog_t *prog, char **ch_ptr)
     int index = GetVarIndex (prog, buf);
     if (index < 0)
     {
-        printf ("Compilation error: varialbe (%s) is not declared.\n", buf);
+        fprintf (stderr, "Compilation error: varialbe (%s) is not declared.\n", buf);
         return COMP_ERROR;
     }
     ProgAddNode (prog, TYPE_VAR, index);
@@ -685,7 +748,7 @@ int Prog_read_call (Prog_t *prog, char **ch_ptr)
 
     if (!(isalpha (**ch_ptr) || **ch_ptr == '_'))
     {
-        printf ("Syntax error: missing function name in call operator.\n");
+        fprintf (stderr, "Syntax error: missing function name in call operator.\n");
         return COMP_ERROR;
     }
     char buf [MAX_NAME_LEN] = "";
@@ -696,7 +759,7 @@ int Prog_read_call (Prog_t *prog, char **ch_ptr)
     int index = GetFuncIndex (prog, buf);
     if (index < 0)
     {
-        printf ("Compilation error: function (%s) is not declared.\n", buf);
+        fprintf (stderr, "Compilation error: function (%s) is not declared.\n", buf);
         return COMP_ERROR;
     }
 
@@ -714,7 +777,7 @@ int Read_var (char **ch_ptr, char *buf, size_t maxlen)
     {
         if (index >= maxlen)
         {
-            printf ("Syntax error: variable name is too long.\n");
+            fprintf (stderr, "Syntax error: variable name is too long.\n");
             return COMP_ERROR;
         }
         buf [index] = *ch;
@@ -770,14 +833,14 @@ int SaveProg (Prog_t *prog, const char *filename)
     if (prog == nullptr || filename == nullptr) return TREE_NULLPTR_ARG;
     TreeVerify (&(prog -> tree));
 
-    FILE *file = fopen (filename, "w");
+    FILE *file = OpenStream (filename, "w");
     if (file == nullptr) return TREE_NULLPTR_ARG;
 
     Save_var_table  (prog, file);
     Save_func_table (prog, file);
     Save_tree       (prog, file);
 
-    fclose (file);
+    CloseStream (file);
 
     return TREE_OK;
 }
@@ -799,7 +862,10 @@ void Save_func_table (Prog_t *prog, FILE *file)
     fprintf (file, "%lld\n", prog -> func_table_size);
     for (size_t index = 0; index < prog -> func_table_size; index++)
     {
-        fprintf (file, "\t%s\n", (prog -> func_table [index]).name);
+        Func_t *func = prog -> func_table + index;
+
+        if (func -> is_defined) fprintf (file, "\t%s\n", func -> name);
+        else                    fprintf (file, "\t%s%s %d\n", IMPORT_MARK, func -> name, func -> num_of_args);
     }
     fprintf (file, "\n");
 }
@@ -813,23 +879,38 @@ void Save_tree (Prog_t *prog, FILE *file)
 
 void Print_node (FILE *file, TreeElem_t *elem, int num_of_spaces)
 {
-    for (int i = 0; i < num_of_spaces; i++) fputc (' ', file);
+    TreeWalk (elem, Print_node_step, file, num_of_spaces);
+}
+
+int Print_node_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx)
+{
+    FILE *file = (FILE *) ctx;
+    TreeElem_t *elem = frame -> elem;
 
-    fprintf (file, "{ %d %d ", TYPE, VAL);
-    if (L)
+    int num_of_spaces = frame -> arg;
+
+    if (frame -> step == 0)
     {
-        fprintf (file, "\n");
-        Print_node (file, L, num_of_spaces + 1);
+        for (int i = 0; i < num_of_spaces; i++) fputc (' ', file);
+
+        fprintf (file, "{ %d %d ", TYPE, VAL);
+        if (elem -> line) fprintf (file, "@%d ", elem -> line);
     }
-    if (R)
+
+    if (frame -> step < TreeChildrenNum (elem))
     {
-        fprintf (file, "\n");
-        Print_node (file, R, num_of_spaces + 1);
+        child -> elem = TreeChild (elem, frame -> step);
+        child -> arg  = num_of_spaces + 1;
+
+        if (child -> elem) fprintf (file, "\n");
+        return WALK_CHILD;
     }
-    if (L || R)
+
+    if (L || R || (TYPE == TYPE_BLOCK && NSTMTS > 0))
     {
         fprintf (file, "\n");
         for (int i = 0; i < num_of_spaces; i++) fputc (' ', file);
     }
     fprintf (file, "}");
+    return WALK_DONE;
 }
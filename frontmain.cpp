@@ -4,25 +4,32 @@ FILE *LOG = NULL;
 
 int main (int argc, char *argv [])
 {
-    LOG = fopen (LOGFILENAME, "w");
-    if (LOG == nullptr) return 0;
-    fprintf (LOG, "<pre>\n");
+    const char *file_args [2] = {};
+    int     file_args_num = 0;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if (TreeDumpOption (argv [index])) continue;
+        if (file_args_num < 2) file_args [file_args_num++] = argv [index];
+    }
+
+    TreeDumpStart ();
 
     const char * input_file_name = nullptr;
     const char *output_file_name = nullptr;
 
-    if (argc >= 2)  input_file_name = argv [1];
-    else            input_file_name = "testprog.txt";
+    if (file_args_num >= 1)  input_file_name = file_args [0];
+    else                     input_file_name = "testprog.txt";
 
-    if (argc >= 3) output_file_name = argv [2];
-    else           output_file_name = "save.txt";
+    if (file_args_num >= 2) output_file_name = file_args [1];
+    else                    output_file_name = "save.txt";
 
     char *text = ReadProg (input_file_name);
     Prog_t prog = {};
     ProgCtor (&prog);    
 
-    GetCode (&prog, text);
-    GetTree (&prog);
+    int err = GetCode (&prog, text);
+    if (err == COMP_OK) err = GetTree (&prog);
     TreeDump (&(prog.tree));
 
     SaveProg (&prog, output_file_name);
@@ -30,6 +37,6 @@ int main (int argc, char *argv [])
     free (text);
     ProgDtor (&prog);
 
-    fclose (LOG);
-    return 0;
+    TreeDumpFinish ();
+    return err;
 }
\ No newline at end of file
@@ -3,42 +3,46 @@
 
 TreeElem_t *GetProg (Prog_t *prog)
 {
-    TreeElem_t *ret  = FIC (NULL, NULL);
-    TreeElem_t *elem = ret;
+    TreeElem_t *ret = BLOCK (BLOCK_PLAIN);
+    if (ret == nullptr) return nullptr;
 
     while (IsVardec (CURRENT))
     {
-        L = GetDec (prog);
-        
-        LP = elem;
-        R = FIC (NULL, NULL);
-        RP = elem;
-        elem = R;
+        int line = CURRENT.line;
+        TreeElem_t *stmt = GetDec (prog);
+        if (stmt == nullptr || BlockAddStmt (ret, stmt))
+        {
+            Tree_free_data (stmt, NULL);
+            Tree_free_data (ret,  NULL);
+            return nullptr;
+        }
+        stmt -> line = line;
     }
     while (IsFuncdec (CURRENT))
     {
-        L = GetFuncdec (prog);
-        if (L == nullptr)
+        int line = CURRENT.line;
+        TreeElem_t *stmt = GetFuncdec (prog);
+        if (stmt == nullptr || BlockAddStmt (ret, stmt))
         {
-            Tree_free_data (ret, NULL);
+            Tree_free_data (stmt, NULL);
+            Tree_free_data (ret,  NULL);
             return nullptr;
         }
-        LP = elem;
-        R = FIC (NULL, NULL);
-        RP = elem;
-        elem = R;
+        stmt -> line = line;
     }
 
-    R = GetBodyWithoutBraces (prog);
-    if (R == nullptr)
+    TreeElem_t *body = GetBodyWithoutBraces (prog);
+    if (body == nullptr || BlockAddStmt (ret, body))
     {
-        Tree_free_data (ret, NULL);
+        Tree_free_data (body, NULL);
+        Tree_free_data (ret,  NULL);
         return nullptr;
     }
-    RP = elem;
+    body -> value = BLOCK_MAIN;
+
     if (!IsEndOfProg (CURRENT))
     {
-        printf ("Syntax error: there mustn't be anything after main body.\n");
+        fprintf (stderr, "Syntax error: there mustn't be anything after main body.\n");
         Tree_free_data (ret, NULL);
         return nullptr;
     }
@@ -82,7 +86,7 @@ TreeElem_t *GetBody (Prog_t *prog)
 
     if (!IsCloseBrace (CURRENT)) 
     {
-        printf ("Syntax error: no closing bracket.\n");
+        fprintf (stderr, "Syntax error: no closing bracket.\n");
         Tree_free_data (ret, NULL);
         return nullptr;
     }
@@ -92,37 +96,39 @@ TreeElem_t *GetBody (Prog_t *prog)
 
 TreeElem_t *GetBodyWithoutBraces (Prog_t *prog)
 {
-    TreeElem_t *elem = FIC (NULL, NULL);
-    TreeElem_t *ret  = elem;
+    TreeElem_t *ret = BLOCK (BLOCK_PLAIN);
+    if (ret == nullptr) return nullptr;
 
     while (1)
     {
+        int line = CURRENT.line;
+        TreeElem_t *stmt = nullptr;
+
         if      (IsCloseBrace (CURRENT) || IsEndOfProg (CURRENT)) break;
-        else if (IsIf         (CURRENT)) L = GetIf     (prog);
-        else if (IsWhile      (CURRENT)) L = GetWhile  (prog);
-        else if (IsVardec     (CURRENT)) L = GetDec    (prog);
-        else if (IsOpenBrace  (CURRENT)) L = GetBody   (prog);
-        else if (IsReturn     (CURRENT)) L = GetReturn (prog);
+        else if (IsIf         (CURRENT)) stmt = GetIf     (prog);
+        else if (IsWhile      (CURRENT)) stmt = GetWhile  (prog);
+        else if (IsVardec     (CURRENT)) stmt = GetDec    (prog);
+        else if (IsOpenBrace  (CURRENT)) stmt = GetBody   (prog);
+        else if (IsReturn     (CURRENT)) stmt = GetReturn (prog);
         else
         {
-            L = GetExp (prog);
+            stmt = GetExp (prog);
             if (!IsSemicolon (CURRENT))
             {
-                printf ("Syntax error: missing semicolon after expression.\n");
-                Tree_free_data (ret, NULL);
+                fprintf (stderr, "Syntax error: missing semicolon after expression.\n");
+                Tree_free_data (stmt, NULL);
+                Tree_free_data (ret,  NULL);
                 return nullptr;
             }
             prog -> index ++;
         }
-        if (!L)
+        if (stmt == nullptr || BlockAddStmt (ret, stmt))
         {
-            Tree_free_data (ret, NULL);
+            Tree_free_data (stmt, NULL);
+            Tree_free_data (ret,  NULL);
             return nullptr;
         }
-        LP = elem;
-        R = FIC (NULL, NULL);
-        RP = elem;
-        elem = R;
+        stmt -> line = line;
     }
 
     return ret;
@@ -133,7 +139,7 @@ TreeElem_t *GetDec (Prog_t *prog)
     if (!IsVardec (CURRENT)) return nullptr;
     if (!IsSemicolon (NEXT))
     {
-        printf ("Syntax error: missing semicolon after variable declaration.\n");
+        fprintf (stderr, "Syntax error: missing semicolon after variable declaration.\n");
         return nullptr;
     }
     int var = CURRENT.value;
@@ -151,7 +157,7 @@ TreeElem_t *GetReturn (Prog_t *prog)
 
     if (!IsSemicolon (CURRENT))
     {
-        printf ("Syntax error: missing semicolon after return.\n");
+        fprintf (stderr, "Syntax error: missing semicolon after return.\n");
         return nullptr;
     }
     prog -> index ++;
@@ -168,14 +174,14 @@ TreeElem_t *GetIf (Prog_t *prog)
     TreeElem_t *iftrue = GetBody (prog);
     if (iftrue == nullptr)
     {
-        printf ("Syntax error: no body in if operator.\n");
+        fprintf (stderr, "Syntax error: no body in if operator.\n");
         return nullptr;
     }
 
     TreeElem_t *cond = GetCond (prog);
     if (cond == nullptr)
     {
-        printf ("Syntax error: no condition in if operator.\n");
+        fprintf (stderr, "Syntax error: no condition in if operator.\n");
         Tree_free_data (iftrue, NULL);
         return nullptr;
     }
@@ -187,7 +193,7 @@ TreeElem_t *GetIf (Prog_t *prog)
         iffalse = GetBody (prog);
         if (iffalse == nullptr)
         {
-            printf ("Syntax error: no body after else.\n");
+            fprintf (stderr, "Syntax error: no body after else.\n");
             Tree_free_data (iftrue, NULL);
             Tree_free_data (cond  , NULL);
             return nullptr;
@@ -206,14 +212,14 @@ TreeElem_t *GetWhile (Prog_t *prog)
     TreeElem_t *cond = GetCond (prog);
     if (cond == nullptr)
     {
-        printf ("Syntax error: no condition in while operator.\n");
+        fprintf (stderr, "Syntax error: no condition in while operator.\n");
         return nullptr;
     }
 
     TreeElem_t *body = GetBody (prog);
     if (cond == nullptr)
     {
-        printf ("Syntax error: no body in while operator.\n");
+        fprintf (stderr, "Syntax error: no body in while operator.\n");
         Tree_free_data (cond, NULL);
         return nullptr;
     }
@@ -231,7 +237,7 @@ TreeElem_t *GetCond (Prog_t *prog)
 
     if (!IsCloseBracket (CURRENT))
     {
-        printf ("Syntax error: no close bracket.\n");
+        fprintf (stderr, "Syntax error: no close bracket.\n");
         Tree_free_data (ret, NULL);
         return nullptr;
     }
@@ -433,7 +439,7 @@ TreeElem_t *GetFunc (Prog_t *prog)
         return GetCall (prog);
     }
 
-    printf ("Syntax error: incorrect expression format.\n");
+    fprintf (stderr, "Syntax error: incorrect expression format.\n");
     return nullptr;
 }
 
@@ -446,7 +452,7 @@ TreeElem_t *GetCall (Prog_t *prog)
     prog -> index ++;
     if (!IsOpenBracket (CURRENT))
     {
-        printf ("Syntax error: incorrect call format.\n");
+        fprintf (stderr, "Syntax error: incorrect call format.\n");
         return nullptr;
     }
     prog -> index ++;
@@ -477,7 +483,7 @@ TreeElem_t *GetCall (Prog_t *prog)
 
         if (!IsSemicolon (CURRENT))
         {
-            printf ("Syntax error: incorrect call format.\n");
+            fprintf (stderr, "Syntax error: incorrect call format.\n");
             Tree_free_data (ret, NULL);
             return nullptr;
         }
@@ -489,13 +495,13 @@ TreeElem_t *GetCall (Prog_t *prog)
 
     if (num_of_args > 0)
     {
-        printf ("Compilation error: not enough arguments in function call.\n");
+        fprintf (stderr, "Compilation error: not enough arguments in function call.\n");
         Tree_free_data (ret, NULL);
         return nullptr;
     }
     if (!IsCloseBracket (CURRENT))
     {
-        printf ("Syntax error: incorrect call format.\n");
+        fprintf (stderr, "Syntax error: incorrect call format.\n");
         Tree_free_data (ret, NULL);
         return nullptr;
     }
@@ -3,8 +3,13 @@
 
 #include "tree/tree.h"
 #include "stack/stack.h"
+#include "proc/stream.h"
 #include "math.h"
+#include "limits.h"
 #include "sys/stat.h"
+#include "unistd.h"
+#include <new>
+#include <thread>
 
 const size_t BUFSIZE = 256;
 const size_t BASE_TABLE_CAPACITY =  8;
@@ -24,6 +29,20 @@ const char *const REV_OP_WORDS [] = {"", "(", ")", "[", "]", SQRT_WORD, "?", "!"
 
 const char *const TEMPFILENAME = "temp.txt";
 
+const char *const LINE_DIRECTIVE = "#LINE";
+const char *const EXPORT_DIRECTIVE = "#EXPORT";
+const char *const IMPORT_DIRECTIVE = "#IMPORT";
+
+const char *const UNIT_OPTION = "-c";           // back: compile one unit for the linker, not a whole program
+const char *const FUNC_LABEL  = "f_";           // functions are labelled by name, so units can call each other
+const char *const MAIN_LABEL  = "main";
+const char *const IMPORT_MARK = "@";            // before an imported function in the saved function table
+
+const char *const THREADS_OPTION    = "-j";           // back: workers compiling the functions, one per core by default
+const char *const FRAG_CACHE_OPTION = "--cache";    // back: the asm of functions that did not change is reused
+const char *const FRAG_EXT          = ".frag";
+const char *const FRAG_VERSION      = "2";          // part of every fragment hash, change with the code Compile emits
+
 //DSL --------------------------------------------------------------------
 
 #define CURRENT (prog -> code [prog -> index    ])
@@ -77,6 +96,7 @@ const char *const TEMPFILENAME = "temp.txt";
 
 
 #define FIC(left, right)           CreateNode (TYPE_FIC    , 0    , left, right)
+#define BLOCK(value)               CreateBlock (value)
 #define IF(cond, iftrue, iffalse)  CreateNode (TYPE_IF     , 0    , cond, CreateNode (TYPE_ELSE, 0, iftrue, iffalse))
 #define WHILE(cond, body)          CreateNode (TYPE_WHILE  , 0    , cond, body)
 #define VARDEC(var)                CreateNode (TYPE_VARDEC , var  , NULL, NULL)
@@ -100,6 +120,7 @@ struct Func_t
     int num_of_vars;
     int *args;
     size_t args_capacity;
+    int is_defined;     // 0 - imported with @, its body is in another unit
 };
 
 
@@ -121,7 +142,27 @@ struct Prog_t
     Tree_t tree;
 
     int vars_in_main;
-    int label;
+    int label;      // back: next .l label, they start from zero in every function and asm scopes them
+    int line;       // front: line of the current token, back: last line emitted with #LINE
+    int line_base;  // back: #LINE is written from it, the first line of a function going to the fragment cache
+    int is_unit;    // back: no start code, functions and main are exported for the linker
+    const char *frag_dir;   // back: cached asm of functions by hash, nullptr - no cache
+    unsigned threads_num;   // back: 0 - one per core
+};
+
+struct Codegen_job_t    // a run of functions for one worker of back
+{
+    Prog_t prog;        // a copy for its own label and line, the tables are shared and only read
+    TreeElem_t **funcs;
+    int num;
+    FILE *buf;
+    int err;
+};
+
+struct Walk_ctx_t   // for the steps of Compile and Reverse
+{
+    Prog_t *prog;
+    FILE   *file;
 };
 
 
@@ -133,8 +174,12 @@ enum FICNODEVALUES
     FIC_CLOSEBRACKET = 4,
     FIC_OPENBRACE    = 5,
     FIC_CLOSEBRACE   = 6,
-    FIC_START        = 7,
-    FIC_CALL         = 8,
+};
+
+enum BLOCKVALUES
+{
+    BLOCK_PLAIN = 0,
+    BLOCK_MAIN  = 1,    // the main body, starts at the main: label
 };
 
 enum COMPRETVALS
@@ -160,8 +205,6 @@ int ProgAddNode (Prog_t *prog, int type, int value);
 
 char *ReadProg (const char *filename);
 
-size_t GetSize (FILE *inp_file);
-
 int GetCode (Prog_t *prog, char *text);
 
 int Read_num (char **ch_ptr, int *num);
@@ -172,16 +215,18 @@ int Read_word (char **ch_ptr, const char *word);
 
 int Back_skip_comment (char **ch_ptr);
 
-int Start_of_area (Prog_t *prog, Stack_t *stk);
+int Start_of_area (Prog_t *prog, Stack_t <int> *stk);
 
-int End_of_area (Prog_t *prog, Stack_t *stk);
+int End_of_area (Prog_t *prog, Stack_t <int> *stk);
 
 int Prog_dec_var (Prog_t *prog, char **ch_ptr, int start_of_area_index, int addnode);
 
-int Prog_dec_func (Prog_t *prog, char **ch_ptr, Stack_t *stk);
+int Prog_dec_func (Prog_t *prog, char **ch_ptr, Stack_t <int> *stk);
 
 int Prog_read_func_args (Prog_t *prog, char **ch_ptr, int start_of_area_index);
 
+int Prog_import_func (Prog_t *prog, char **ch_ptr);
+
 int Func_add_arg (Func_t *func, int index);
 
 int Prog_read_call (Prog_t *prog, char **ch_ptr);
@@ -206,6 +251,8 @@ void Save_tree (Prog_t *prog, FILE *file);
 
 void Print_node (FILE *file, TreeElem_t *elem, int num_of_spaces);
 
+int Print_node_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx);
+
 
 TreeElem_t *GetProg (Prog_t *prog);
 
@@ -254,6 +301,8 @@ char *Load_tree  (Prog_t *prog, char *ch);
 
 TreeElem_t *Read_node (char **ch_ptr);
 
+TreeElem_t *Read_node_head (char **ch_ptr);
+
 char *SkipSpacesAndComments (char *ch);
 
 char *SkipSpaces (char *ch);
@@ -264,29 +313,57 @@ int GenerateAsm (Prog_t *prog, const char *filename);
 
 int Compile_prog (Prog_t *prog, FILE *file);
 
+int Compile_exports (Prog_t *prog, FILE *file);
+
+int Compile_top (Prog_t *prog, FILE *file, TreeElem_t *stmt);
+
+int Compile_funcs (Prog_t *prog, FILE *file, TreeElem_t **funcs, int num);
+
+void CodegenWorker (Codegen_job_t *job);
+
+int UseFragCache (Prog_t *prog, const char *dir);
+
+int Compile_func_cached (Prog_t *prog, FILE *file, TreeElem_t *func);
+
+int Hash_func (Prog_t *prog, TreeElem_t *func, unsigned long long *hash_p);
+
+unsigned long long Hash_node (Prog_t *prog, TreeElem_t *elem, int line_base, unsigned long long hash);
+
+unsigned long long Hash_bytes (const void *data, size_t size, unsigned long long hash);
+
+int Append_frag (FILE *file, const char *name, int line_base);
+
+void Append_stream (FILE *file, FILE *from);
+
 int Get_var_indexes (Prog_t *prog);
 
 void Count_func_vars (Prog_t *prog, TreeElem_t *func);
 
 void Count_vars (Prog_t *prog, TreeElem_t *elem, int *count, int is_main);
 
-void Replace_fic_with_call (TreeElem_t *elem);
-
 int Compile (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
-int Compile_fic (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Compile_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx);
+
+int Compile_line (Prog_t *prog, FILE *file, TreeElem_t *elem);
+
+int Compile_fic (TreeWalk_t *frame, TreeWalk_t *child);
+
+int Compile_block (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
+
+void Compile_drop (FILE *file, TreeElem_t *elem);
 
 int Compile_num (FILE *file, TreeElem_t *elem);
 
 int Compile_var (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
-int Compile_if (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Compile_if (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Compile_while (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Compile_while (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Compile_op (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Compile_op (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Compile_assign (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Compile_assign (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
 int Compile_onearg (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
@@ -308,11 +385,11 @@ int Compile_logic (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
 int Compile_vardec (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
-int Compile_funcdec (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Compile_funcdec (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Compile_call (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Compile_call (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Compile_return (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Compile_return (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
 int Compile_hlt (FILE *file);
 
@@ -321,37 +398,47 @@ int GenerateText (Prog_t *prog, const char *filename);
 
 int ReverseFile (const char *in_name, const char *out_name);
 
+int Reverse_imports (Prog_t *prog, FILE *file);
+
 int Reverse (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
-int Reverse_fic (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx);
+
+int Reverse_fic (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
+
+int Reverse_block (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
+
+void Reverse_end_stmt (FILE *file, TreeElem_t *elem);
 
 int Reverse_num (FILE *file, TreeElem_t *elem);
 
 int Reverse_var (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
-int Reverse_if (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_if (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Reverse_while (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_while (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Reverse_op (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_op (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Reverse_onearg (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_onearg (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
-int Reverse_twoarg (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_twoarg (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
 int Reverse_in (FILE *file);
 
 int Reverse_vardec (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
-int Reverse_funcdec (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_funcdec (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
 int Reverse_decargs (Prog_t *prog, FILE *file, TreeElem_t *elem);
 
-int Reverse_call (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_call (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
+
+TreeElem_t *Reverse_first_arg (TreeElem_t *elem);
 
-int Reverse_callargs (Prog_t *prog, FILE *file, TreeElem_t *elem, int *first_arg);
+TreeElem_t *Reverse_next_arg (TreeElem_t *link, TreeElem_t *top);
 
-int Reverse_return (Prog_t *prog, FILE *file, TreeElem_t *elem);
+int Reverse_return (FILE *file, TreeWalk_t *frame, TreeWalk_t *child);
 
 void Dec_to_rev_tern (int num, char *buf);
 
@@ -1,54 +1,38 @@
 #include "proc.h"
 
 
-#define Ret_if_err(func)                    \
-    err = func;                             \
-    if (err)                                \
-    {                                       \
-        AsmErr (err, ERROR_STREAM);         \
-        return err;                         \
-    }
-
+//---------------------------------------------------------------------------------------------------------------------
 
-int main (int argc, char *argv[])
+int Compile (struct Text *txt, cmd_t **cmds_p, Label_list_t *label_list, unsigned threads_num)
 {
-    const char * input_file_name = nullptr;
-    const char *output_file_name = nullptr;
-
-    if (argc >= 2)  input_file_name = argv [1];
-    else            input_file_name = "in.txt";
-
-    if (argc >= 3) output_file_name = argv [2];
-    else           output_file_name =      "a";
-
-
-    cmd_t *commands = nullptr;
-    struct Text txt = {};
-
-    int err = OK;
-
-    Ret_if_err (ReadText (input_file_name, &txt));
+    if (txt           == nullptr) return NULLPTR_ARG;
+    if (txt -> buffer == nullptr) return NULLPTR_ARG;
+    if (txt ->  lines == nullptr) return NULLPTR_ARG;
+    if (cmds_p        == nullptr) return NULLPTR_ARG;
+    if (label_list    == nullptr) return NULLPTR_ARG;
 
-    Ret_if_err (Compile (&txt, &commands));
+    Line_table_t line_table = {};
 
-    FreeText (&txt);
+    int err = txt -> len >= 2 * ASM_CHUNK_LINES ? Compile_chunks (txt, cmds_p, label_list, &line_table, threads_num) :
+                                                  Compile_whole  (txt, cmds_p, label_list, &line_table);
+    if (err)
+    {
+        free (line_table.list);
+        return err;
+    }
 
-    Ret_if_err (WriteCmds (output_file_name, commands));
+    // depths are a hint for the cpu, a program that cannot be analysed still compiles
+    PutStackDepth (*cmds_p + CODE_SHIFT);
 
-    free (commands);
+    err = PutLineTable (cmds_p, &line_table);
+    free (line_table.list);
+    if (err) return err;
 
     return OK;
 }
 
-//---------------------------------------------------------------------------------------------------------------------
-
-int Compile (struct Text *txt, cmd_t **cmds_p)
+int Compile_whole (Text *txt, cmd_t **cmds_p, Label_list_t *label_list, Line_table_t *line_table)
 {
-    if (txt           == nullptr) return NULLPTR_ARG;
-    if (txt -> buffer == nullptr) return NULLPTR_ARG;
-    if (txt ->  lines == nullptr) return NULLPTR_ARG;
-    if (cmds_p        == nullptr) return NULLPTR_ARG;
-
     size_t size = (MAX_NUM_OF_ARGS * ARG_SIZE + CMD_SIZE) * (txt -> len) + INFO_SIZE;
 
     *cmds_p = (cmd_t *) (calloc (1, size));
@@ -60,24 +44,22 @@ int Compile (struct Text *txt, cmd_t **cmds_p)
     cmds [SIGNATURE_POS] = SIGNATURE;
     cmds [  VERSION_POS] = VERSION;
 
-    Label_list_t label_list = {};
-    int err = LabelListCtor (&label_list);
+    int err = LabelListCtor (label_list);
     if (err) return err;
-    
-    for (int pass = 0; pass < NUM_OF_ASM; pass++)
-    {
-        err = Assemble (txt, cmds, &label_list, pass);
-        if (err) return err;
-    }
 
-    return OK;
+    for (int pass = 0; pass < NUM_OF_ASM && err == OK; pass++)
+        err = Assemble (txt, 0, txt -> len, cmds, label_list, line_table, pass);
+
+    return err;
 }
 
-int Assemble (Text *txt, cmd_t *cmds, Label_list_t *label_list, int pass)
+int Assemble (Text *txt, size_t first, size_t last, cmd_t *cmds, Label_list_t *label_list, Line_table_t *line_table, int pass)
 {
     int ip = 0;
 
-    for (size_t line = 0; line < txt -> len; line++)
+    (label_list -> scope) [0] = '\0';
+
+    for (size_t line = first; line < last; line++)
     {
         if (line == 0)
         {   
@@ -96,8 +78,32 @@ int Assemble (Text *txt, cmd_t *cmds, Label_list_t *label_list, int pass)
 
         if (stricmp (cmd, "") == 0) continue;
 
+        if (stricmp (cmd, LINE_CMD_NAME) == 0)
+        {
+            if (pass < NUM_OF_ASM - 1) continue;
+            if (AddLine (line_table, ip, line_cpy + symbs_read))
+            {
+                fprintf (ERROR_STREAM, "Compilation error:\nincorrect %s at line (%Iu).\n", LINE_CMD_NAME, line + 1);
+                return COMP_ERROR;
+            }
+            continue;
+        }
+
+        if (stricmp (cmd, EXPORT_CMD_NAME) == 0 || stricmp (cmd, IMPORT_CMD_NAME) == 0)
+        {
+            if (pass < NUM_OF_ASM - 1 || label_list -> obj == nullptr) continue;
+
+            if (label_list -> chunk)
+            {
+                if (Chunk_add_export (label_list -> chunk, line)) return ALLOC_ERROR;
+            }
+            else if (AddSymbol (label_list, cmd, line_cpy + symbs_read, line)) return COMP_ERROR;
+            continue;
+        }
+
         if (strchr (cmd, ':'))
         {   
+            Set_label_scope (cmd, label_list);
             if (pass >= 1) continue;
             if (AddLabel (cmd, label_list, ip, line)) return COMP_ERROR;
         }
@@ -127,6 +133,637 @@ int Assemble (Text *txt, cmd_t *cmds, Label_list_t *label_list, int pass)
     return OK;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+
+// the chunks are assembled in parallel, then placed one after another and their references resolved;
+// a chunk starts at a function label, so its local labels are all in it and any cut gives the same code
+int Compile_chunks (Text *txt, cmd_t **cmds_p, Label_list_t *label_list, Line_table_t *line_table, unsigned threads_num)
+{
+    Asm_chunks_t chunks = {};
+
+    chunks.txt    = txt;
+    chunks.errors = ERROR_STREAM;
+    chunks.next   = 0;
+
+    int err = Split_chunks (&chunks);
+
+    if (threads_num == 0) threads_num = std::thread::hardware_concurrency ();
+    if (threads_num > chunks.num) threads_num = (unsigned) chunks.num;
+
+    std::thread *workers = nullptr;
+    if (err == OK && threads_num > 1)
+    {
+        workers = new (std::nothrow) std::thread [threads_num];
+        if (workers == nullptr) err = ALLOC_ERROR;
+    }
+
+    if (err == OK && workers)
+    {
+        for (unsigned index = 0; index < threads_num; index++) workers [index] = std::thread (AsmWorker, &chunks);
+        for (unsigned index = 0; index < threads_num; index++) workers [index].join ();
+    }
+    else if (err == OK) AsmWorker (&chunks);
+
+    delete [] workers;
+
+    for (size_t index = 0; index < chunks.num && err == OK; index++) err = chunks.list [index].err;
+
+    if (err == OK) err = Merge_chunks (&chunks, cmds_p, label_list, line_table);
+
+    ChunksDtor (&chunks);
+
+    return err;
+}
+
+// a chunk is ASM_CHUNK_LINES lines and the rest of the function it ends in
+int Split_chunks (Asm_chunks_t *chunks)
+{
+    Text *txt = chunks -> txt;
+
+    chunks -> list = (Asm_chunk_t *) calloc (txt -> len / ASM_CHUNK_LINES + 1, sizeof (Asm_chunk_t));
+    if (chunks -> list == nullptr) return ALLOC_ERROR;
+
+    for (size_t first = 0; first < txt -> len; )
+    {
+        size_t last = first + ASM_CHUNK_LINES;
+
+        while (last < txt -> len && !Is_scope_label (txt -> lines [last])) last++;
+        if (last > txt -> len) last = txt -> len;
+
+        Asm_chunk_t *chunk = chunks -> list + chunks -> num++;
+
+        chunk -> first = first;
+        chunk -> last  = last;
+
+        first = last;
+    }
+
+    return OK;
+}
+
+int Is_scope_label (const char *line)
+{
+    char line_cpy [BUFLEN] = "";
+    char cmd      [BUFLEN] = "";
+
+    strncpy (line_cpy, line, BUFLEN - 1);
+
+    if (sscanf (line_cpy, "%s", cmd) != 1) return 0;
+
+    return cmd [0] != LOCAL_LABEL_MARK && strchr (cmd, ':') != nullptr;
+}
+
+void AsmWorker (Asm_chunks_t *chunks)
+{
+    ERROR_STREAM = chunks -> errors;
+
+    while (1)
+    {
+        size_t index = chunks -> next++;
+        if (index >= chunks -> num) return;
+
+        Asm_chunk_t *chunk = chunks -> list + index;
+
+        chunk -> err = Assemble_chunk (chunks -> txt, chunk);
+    }
+}
+
+int Assemble_chunk (Text *txt, Asm_chunk_t *chunk)
+{
+    size_t size = (MAX_NUM_OF_ARGS * ARG_SIZE + CMD_SIZE) * (chunk -> last - chunk -> first) + INFO_SIZE;
+
+    chunk -> cmds = (cmd_t *) calloc (1, size);
+    if (chunk -> cmds == nullptr) return ALLOC_ERROR;
+
+    int err = ObjCtor (&(chunk -> obj));
+    if (err == OK) err = LabelListCtor (&(chunk -> labels));
+
+    chunk -> labels.obj   = &(chunk -> obj);
+    chunk -> labels.chunk = chunk;
+
+    for (int pass = 0; pass < NUM_OF_ASM && err == OK; pass++)
+        err = Assemble (txt, chunk -> first, chunk -> last, chunk -> cmds + CODE_SHIFT, &(chunk -> labels), &(chunk -> line_table), pass);
+
+    return err;
+}
+
+int Chunk_add_export (Asm_chunk_t *chunk, size_t line)
+{
+    if (chunk -> exports_num >= chunk -> exports_max)
+    {
+        size_t old_num = chunk -> exports_max;
+        size_t new_num = old_num ? old_num * 2 : RELOCS_BASE_NUM;
+
+        size_t *exports = (size_t *) Recalloc ((void *) chunk -> exports, new_num, sizeof (size_t), old_num);
+        if (exports == nullptr) return ALLOC_ERROR;
+
+        chunk -> exports     = exports;
+        chunk -> exports_max = new_num;
+    }
+
+    chunk -> exports [chunk -> exports_num++] = line;
+
+    return OK;
+}
+
+// in the order of the text, so labels, line table, imports and relocations come out as in one piece
+int Merge_chunks (Asm_chunks_t *chunks, cmd_t **cmds_p, Label_list_t *label_list, Line_table_t *line_table)
+{
+    int code_size = 0;
+
+    for (size_t index = 0; index < chunks -> num; index++)
+    {
+        Asm_chunk_t *chunk = chunks -> list + index;
+
+        chunk -> base = code_size;
+        code_size    += chunk -> cmds [CODE_SHIFT + CODESIZE_POS];
+    }
+
+    size_t size = (MAX_NUM_OF_ARGS * ARG_SIZE + CMD_SIZE) * (chunks -> txt -> len) + INFO_SIZE;
+
+    *cmds_p = (cmd_t *) (calloc (1, size));
+    if (*cmds_p == nullptr) return ALLOC_ERROR;
+
+    cmd_t *code = *cmds_p + CODE_SHIFT;
+
+    code [SIGNATURE_POS] = SIGNATURE;
+    code [  VERSION_POS] = VERSION;
+    code [ CODESIZE_POS] = code_size;
+    code [ ACCURACY_POS] = chunks -> list [0].cmds [CODE_SHIFT + ACCURACY_POS];
+
+    int err = LabelListCtor (label_list);
+
+    for (size_t index = 0; index < chunks -> num && err == OK; index++)
+    {
+        Asm_chunk_t *chunk = chunks -> list + index;
+
+        memcpy (code + chunk -> base, chunk -> cmds + CODE_SHIFT, (size_t) chunk -> cmds [CODE_SHIFT + CODESIZE_POS] * CMD_SIZE);
+
+        for (size_t label = 0; label < chunk -> labels.num && err == OK; label++)
+        {
+            err = ExpandLabelList (label_list);
+            if (err) break;
+
+            label_list -> list [label_list -> num] = chunk -> labels.list [label];
+            label_list -> list [label_list -> num].ip += chunk -> base;
+            label_list -> num++;
+        }
+
+        for (size_t line = 0; line < chunk -> line_table.num && err == OK; line++)
+            err = Put_line (line_table, chunk -> line_table.list [line].ip + chunk -> base, chunk -> line_table.list [line].line);
+    }
+
+    if (err) return err;
+
+    // sorted by name for the lookups, the list itself stays in the order of the text
+    Label_t **sorted = (Label_t **) calloc (label_list -> num + 1, sizeof (Label_t *));
+    if (sorted == nullptr) return ALLOC_ERROR;
+
+    for (size_t index = 0; index < label_list -> num; index++) sorted [index] = label_list -> list + index;
+
+    qsort (sorted, label_list -> num, sizeof (Label_t *), Compare_label_names);
+
+    for (size_t index = 1; index < label_list -> num && err == OK; index++)
+    {
+        if (strcmp (sorted [index - 1] -> name, sorted [index] -> name)) continue;
+
+        fprintf (ERROR_STREAM, "Compilation error:\nlabel (%s) has been already created.\n", sorted [index] -> name);
+        err = COMP_ERROR;
+    }
+
+    for (size_t index = 0; index < chunks -> num && err == OK; index++)
+    {
+        Asm_chunk_t *chunk = chunks -> list + index;
+
+        for (size_t reloc = 0; reloc < chunk -> obj.relocs.num && err == OK; reloc++)
+            err = Merge_reloc (label_list, sorted, code, chunk, chunk -> obj.relocs.list + reloc);
+
+        if (err == OK && label_list -> obj) err = Merge_exports (chunks -> txt, chunk, label_list);
+    }
+
+    free (sorted);
+
+    return err;
+}
+
+// what Put_label_ip and AddReloc would have done with the whole text
+int Merge_reloc (Label_list_t *label_list, Label_t **sorted, cmd_t *code, Asm_chunk_t *chunk, Reloc_t *reloc)
+{
+    int pos = chunk -> base + reloc -> pos;
+
+    switch (reloc -> kind)
+    {
+        case RELOC_CODE:
+            code [pos] += chunk -> base;
+            return AddReloc (label_list, code, pos, RELOC_CODE, 0, NUM_OF_ASM - 1);
+
+        case RELOC_GLOBAL:
+            return AddReloc (label_list, code, pos, RELOC_GLOBAL, 0, NUM_OF_ASM - 1);
+
+        case RELOC_SYMBOL:
+        {
+            const char *name = (chunk -> obj.imports.list [reloc -> sym]).name;
+
+            code [pos] = Find_label (sorted, label_list -> num, name);
+            if (code [pos] >= 0) return AddReloc (label_list, code, pos, RELOC_CODE, 0, NUM_OF_ASM - 1);
+
+            if (label_list -> obj == nullptr) return OK;
+
+            code [pos] = 0;
+
+            int sym = AddImport (label_list -> obj, name);
+            if (sym < 0) return ALLOC_ERROR;
+
+            return AddReloc (label_list, code, pos, RELOC_SYMBOL, sym, NUM_OF_ASM - 1);
+        }
+
+        default:
+            return COMP_ERROR;
+    }
+}
+
+int Merge_exports (Text *txt, Asm_chunk_t *chunk, Label_list_t *label_list)
+{
+    for (size_t index = 0; index < chunk -> exports_num; index++)
+    {
+        size_t line = chunk -> exports [index];
+
+        char line_cpy [BUFLEN] = "";
+        char cmd      [BUFLEN] = "";
+        int symbs_read = 0;
+
+        strncpy (line_cpy, txt -> lines [line], BUFLEN - 1);
+        sscanf (line_cpy, "%s%n", cmd, &symbs_read);
+
+        if (AddSymbol (label_list, cmd, line_cpy + symbs_read, line)) return COMP_ERROR;
+    }
+
+    return OK;
+}
+
+int Compare_label_names (const void *label1, const void *label2)
+{
+    return strcmp ((*(Label_t *const *) label1) -> name, (*(Label_t *const *) label2) -> name);
+}
+
+// ip of the label, -1 - not defined
+int Find_label (Label_t **sorted, size_t num, const char *name)
+{
+    size_t left  = 0;
+    size_t right = num;
+
+    while (left < right)
+    {
+        size_t mid = left + (right - left) / 2;
+
+        int cmp = strcmp (sorted [mid] -> name, name);
+        if (cmp == 0) return sorted [mid] -> ip;
+
+        if (cmp < 0) left  = mid + 1;
+        else         right = mid;
+    }
+
+    return -1;
+}
+
+void ChunksDtor (Asm_chunks_t *chunks)
+{
+    for (size_t index = 0; chunks -> list && index < chunks -> num; index++)
+    {
+        Asm_chunk_t *chunk = chunks -> list + index;
+
+        free (chunk -> cmds);
+        free (chunk -> exports);
+        free (chunk -> line_table.list);
+
+        LabelListDtor (&(chunk -> labels));
+        ObjDtor (&(chunk -> obj));
+    }
+
+    free (chunks -> list);
+
+    chunks -> list = nullptr;
+    chunks -> num  = 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// stack depths by abstract interpretation: every ip of a function gets one depth on all paths to it
+int PutStackDepth (cmd_t *cmds)
+{
+    if (cmds == nullptr) return NULLPTR_ARG;
+
+    int code_size = cmds [CODESIZE_POS];
+
+    cmds [STACKDEPTH_POS] = 0;
+    cmds [ CALLDEPTH_POS] = 0;
+    cmds [    FLAGS_POS] &= ~FLAG_DEPTH_EXACT;
+
+    if (code_size <= 0) return OK;
+
+    Depth_work_t work = {};
+
+    int err = Depth_work_ctor (&work, cmds, code_size);
+    if (err == OK) err = Depth_walk (&work);
+
+    if (err == OK)
+    {
+        cmds [STACKDEPTH_POS] = work.funcs [0].max;
+        cmds [ CALLDEPTH_POS] = work.funcs [0].calls;
+        cmds [    FLAGS_POS] |= FLAG_DEPTH_EXACT;
+    }
+
+    Depth_work_dtor (&work);
+
+    return err;
+}
+
+int Depth_work_ctor (Depth_work_t *work, const cmd_t *code, int code_size)
+{
+    if (work == nullptr || code == nullptr) return NULLPTR_ARG;
+
+    work -> code      = code;
+    work -> code_size = code_size;
+
+    work -> funcs = (Func_depth_t *) calloc ((size_t) code_size, sizeof (Func_depth_t));
+    work -> depth = (int *)          calloc ((size_t) code_size, sizeof (int));
+    work -> todo  = (int *)          calloc ((size_t) code_size, sizeof (int));
+    work -> stack = (int *)          calloc ((size_t) code_size, sizeof (int));
+
+    if (work -> funcs == nullptr || work -> depth == nullptr || work -> todo == nullptr || work -> stack == nullptr)
+    {
+        Depth_work_dtor (work);
+        return ALLOC_ERROR;
+    }
+
+    for (int ip = 0; ip < code_size; ip++) work -> depth [ip] = DEPTH_UNSET;
+
+    return OK;
+}
+
+void Depth_work_dtor (Depth_work_t *work)
+{
+    if (work == nullptr) return;
+
+    free (work -> funcs);
+    free (work -> depth);
+    free (work -> todo);
+    free (work -> stack);
+    free (work -> callees);
+
+    *work = {};
+}
+
+// callees are analysed before their callers, the call chain lives in work -> stack, not on the C stack
+int Depth_walk (Depth_work_t *work)
+{
+    Func_depth_t *funcs = work -> funcs;
+
+    int stack_num = 0;
+
+    funcs [0].state = DEPTH_BUSY;
+    work -> stack [stack_num++] = 0;
+
+    int err = Func_calls (work, 0);
+
+    while (stack_num > 0 && err == OK)
+    {
+        int entry = work -> stack [stack_num - 1];
+        Func_depth_t *func = funcs + entry;
+
+        if (func -> callee_pos < func -> callees_num)
+        {
+            int callee = work -> callees [func -> first_callee + func -> callee_pos++];
+
+            if (funcs [callee].state != DEPTH_NEW) continue;    // done, or recursion that Func_depth reports
+
+            funcs [callee].state = DEPTH_BUSY;
+            work -> stack [stack_num++] = callee;
+
+            err = Func_calls (work, callee);
+            continue;
+        }
+
+        err = Func_depth (work, entry);
+        stack_num--;
+    }
+
+    return err;
+}
+
+// call targets of a function, found on all paths from the entry as if every call returned,
+// so they include every callee Func_depth can reach
+int Func_calls (Depth_work_t *work, int entry)
+{
+    Func_depth_t *func = work -> funcs + entry;
+
+    func -> first_callee = work -> callees_num;
+    func -> callees_num  = 0;
+    func -> callee_pos   = 0;
+
+    int todo_num = 0;
+    int err = OK;
+
+    Depth_visit (work -> depth, work -> code_size, work -> todo, &todo_num, entry, 0);
+
+    for (int pos = 0; pos < todo_num && err == OK; pos++)
+    {
+        int ip = work -> todo [pos];
+        int next = 0, target = 0;
+
+        if (Cmd_target (work -> code, work -> code_size, ip, &next, &target)) continue;  // Func_depth reports it
+
+        int op = work -> code [ip] & CMD_MASK;
+
+        if (op == CMD_CALL)
+        {
+            if (work -> callees_num >= work -> callees_max_num)
+            {
+                size_t old_num = work -> callees_max_num;
+                size_t new_num = old_num ? old_num * 2 : (size_t) work -> code_size / 4 + 1;
+
+                int *callees = (int *) Recalloc (work -> callees, new_num, sizeof (int), old_num);
+                if (callees == nullptr)
+                {
+                    err = ALLOC_ERROR;
+                    break;
+                }
+
+                work -> callees         = callees;
+                work -> callees_max_num = new_num;
+            }
+
+            work -> callees [work -> callees_num++] = target;
+            func -> callees_num++;
+        }
+
+        if (op != CMD_HLT && op != CMD_RET && op != CMD_JMP && next < work -> code_size)
+            Depth_visit (work -> depth, work -> code_size, work -> todo, &todo_num, next, 0);
+
+        if (target >= 0 && op != CMD_CALL)
+            Depth_visit (work -> depth, work -> code_size, work -> todo, &todo_num, target, 0);
+    }
+
+    Depth_reset (work, todo_num);
+
+    return err;
+}
+
+// COMP_ERROR - no static bound: recursion, computed jumps, paths that disagree on the depth
+int Func_depth (Depth_work_t *work, int entry)
+{
+    const cmd_t *code = work -> code;
+    int code_size = work -> code_size;
+
+    int *depth = work -> depth;
+    int *todo  = work -> todo;
+
+    Func_depth_t *func = work -> funcs + entry;
+
+    func -> max   = 0;
+    func -> net   = DEPTH_NO_RET;
+    func -> calls = 0;
+
+    int todo_num = 0;
+    int err = Depth_visit (depth, code_size, todo, &todo_num, entry, 0);
+
+    for (int pos = 0; pos < todo_num && err == OK; pos++)
+    {
+        int ip  = todo [pos];
+        int cur = depth [ip];
+
+        cmd_t cmd = code [ip];
+        int op = cmd & CMD_MASK;
+
+        int next = 0, target = 0;
+
+        err = Cmd_target (code, code_size, ip, &next, &target);
+        if (err) break;
+
+        switch (op)
+        {
+            case CMD_HLT:
+                break;
+
+            case CMD_PUSH:
+            case CMD_IN:
+                err = Depth_visit (depth, code_size, todo, &todo_num, next, cur + 1);
+                break;
+
+            case CMD_POP:
+            case CMD_OUT:
+            case CMD_ADD:
+            case CMD_SUB:
+            case CMD_MUL:
+            case CMD_DIV:
+            case CMD_POW:
+                err = Depth_visit (depth, code_size, todo, &todo_num, next, cur - 1);
+                break;
+
+            case CMD_SQRT:
+            case CMD_SIN:
+            case CMD_DUMP:
+                err = Depth_visit (depth, code_size, todo, &todo_num, next, cur);
+                break;
+
+            case CMD_JMP:
+                err = Depth_visit (depth, code_size, todo, &todo_num, target, cur);
+                break;
+
+            case CMD_JMON:
+                err = Depth_visit (depth, code_size, todo, &todo_num, next, cur);
+                if (err == OK) err = Depth_visit (depth, code_size, todo, &todo_num, target, cur);
+                break;
+
+            case CMD_JA:
+            case CMD_JAE:
+            case CMD_JB:
+            case CMD_JBE:
+            case CMD_JE:
+            case CMD_JNE:
+                err = Depth_visit (depth, code_size, todo, &todo_num, ip + 2, cur - 2);
+                if (err == OK) err = Depth_visit (depth, code_size, todo, &todo_num, target, cur - 2);
+                break;
+
+            case CMD_CALL:
+            {
+                Func_depth_t *callee = work -> funcs + target;
+
+                if (callee -> state != DEPTH_DONE)      // recursion
+                {
+                    err = COMP_ERROR;
+                    break;
+                }
+
+                if (cur + callee -> max    > func -> max  ) func -> max   = cur + callee -> max;
+                if (    callee -> calls + 1 > func -> calls) func -> calls = callee -> calls + 1;
+
+                if (callee -> net != DEPTH_NO_RET) err = Depth_visit (depth, code_size, todo, &todo_num, next, cur + callee -> net);
+                break;
+            }
+
+            case CMD_RET:
+                if      (func -> net == DEPTH_NO_RET) func -> net = cur;
+                else if (func -> net != cur)          err = COMP_ERROR;
+                break;
+
+            default:
+                err = COMP_ERROR;
+                break;
+        }
+
+        if (cur + 1 > func -> max && (op == CMD_PUSH || op == CMD_IN)) func -> max = cur + 1;
+    }
+
+    Depth_reset (work, todo_num);
+
+    func -> state = DEPTH_DONE;
+
+    return err;
+}
+
+// next - the ip after the command, target - its constant jump label or -1, COMP_ERROR on anything else
+int Cmd_target (const cmd_t *code, int code_size, int ip, int *next, int *target)
+{
+    cmd_t cmd = code [ip];
+
+    *next   = ip + 1 + !!(cmd & ARG_REG) + !!(cmd & ARG_IM);
+    *target = -1;
+
+    if (*next > code_size) return COMP_ERROR;
+
+    // jumps are followed only to constant labels
+    int op = cmd & CMD_MASK;
+
+    if ((op >= CMD_JMP && op <= CMD_CALL) || op == CMD_JMON)
+    {
+        if ((cmd & ~CMD_MASK) != ARG_IM || code [ip + 1] < 0 || code [ip + 1] >= code_size) return COMP_ERROR;
+
+        *target = code [ip + 1];
+    }
+
+    return OK;
+}
+
+void Depth_reset (Depth_work_t *work, int todo_num)
+{
+    for (int pos = 0; pos < todo_num; pos++) work -> depth [work -> todo [pos]] = DEPTH_UNSET;
+}
+
+int Depth_visit (int *depth, int code_size, int *todo, int *todo_num, int ip, int new_depth)
+{
+    if (ip >= code_size) return COMP_ERROR;     // runs off the end of the code
+
+    if (depth [ip] == DEPTH_UNSET)
+    {
+        depth [ip] = new_depth;
+        todo [(*todo_num)++] = ip;
+        return OK;
+    }
+
+    return depth [ip] == new_depth ? OK : COMP_ERROR;
+}
+
 int SetAccuracyCoef (cmd_t *cmds, char *line)
 {
     if (cmds == nullptr) return NULLPTR_ARG;
@@ -149,6 +786,83 @@ int SetAccuracyCoef (cmd_t *cmds, char *line)
     return OK;
 }
 
+int AddLine (Line_table_t *line_table, int ip, char *args)
+{
+    if (line_table == nullptr || args == nullptr) return NULLPTR_ARG;
+
+    int src_line = 0;
+    if (sscanf (args, "%d", &src_line) != 1 || src_line <= 0) return COMP_ERROR;
+
+    return Put_line (line_table, ip, src_line);
+}
+
+int Put_line (Line_table_t *line_table, int ip, int src_line)
+{
+    if (line_table -> num > 0)
+    {
+        Line_t *last = line_table -> list + line_table -> num - 1;
+
+        if (last -> line == src_line) return OK;
+        if (last -> ip   == ip)                     // nothing was generated for the previous line
+        {
+            last -> line = src_line;
+            return OK;
+        }
+    }
+
+    if (line_table -> num >= line_table -> max_num)
+    {
+        size_t old_num = line_table -> max_num;
+        size_t new_num = old_num ? old_num * 2 : LINES_BASE_NUM;
+
+        Line_t *list = (Line_t *) Recalloc ((void *) line_table -> list, new_num, sizeof (Line_t), old_num);
+        if (list == nullptr) return ALLOC_ERROR;
+
+        line_table -> list    = list;
+        line_table -> max_num = new_num;
+    }
+
+    line_table -> list [line_table -> num].ip   = ip;
+    line_table -> list [line_table -> num].line = src_line;
+    line_table -> num++;
+
+    return OK;
+}
+
+int PutLineTable (cmd_t **cmds_p, Line_table_t *line_table)
+{
+    if (cmds_p == nullptr || *cmds_p == nullptr || line_table == nullptr) return NULLPTR_ARG;
+
+    if (line_table -> num == 0) return OK;
+
+    size_t code_size = (size_t) (*cmds_p) [CODE_SHIFT + CODESIZE_POS];
+    size_t  old_size = CODE_SHIFT + code_size;
+    size_t  new_size = old_size + LINES_HEADER_SIZE + line_table -> num * (sizeof (Line_t) / CMD_SIZE);
+
+    cmd_t *cmds = (cmd_t *) realloc (*cmds_p, new_size * CMD_SIZE);
+    if (cmds == nullptr) return ALLOC_ERROR;
+    *cmds_p = cmds;
+
+    cmds [old_size    ] = LINES_SIGNATURE;
+    cmds [old_size + 1] = (cmd_t) line_table -> num;
+
+    memcpy (cmds + old_size + LINES_HEADER_SIZE, line_table -> list, line_table -> num * sizeof (Line_t));
+
+    return OK;
+}
+
+size_t GetImageSize (const cmd_t *cmds)
+{
+    if (cmds == nullptr) return 0;
+
+    size_t size = CODE_SHIFT + (size_t) cmds [CODE_SHIFT + CODESIZE_POS];
+
+    // Compile allocates spare zeroed words after the code, so the word after it is always readable
+    if (cmds [size] == LINES_SIGNATURE) size += LINES_HEADER_SIZE + (size_t) cmds [size + 1] * (sizeof (Line_t) / CMD_SIZE);
+
+    return size;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 
 int LabelListCtor (Label_list_t *label_list)
@@ -170,19 +884,22 @@ int AddLabel (char *cmd, Label_list_t *label_list, int ip, size_t line)
 
     int err = OK;
 
-    err = CheckLabelName (&cmd, label_list, line);
+    char name [MAX_LABEL_LEN + 1] = "";
+
+    err = CheckLabelName (&cmd, name, label_list, line);
     if (err) return err;
 
     err = ExpandLabelList (label_list);
     if (err) return err;
 
-    strcpy (((label_list -> list) [label_list -> num  ]).name, cmd);
+    strcpy (((label_list -> list) [label_list -> num  ]).name, name);
             ((label_list -> list) [label_list -> num++]).ip = ip;
 
     return OK;
 }
 
-int CheckLabelName (char **name_p, Label_list_t *label_list, size_t line)
+// full_name is the name with its scope, MAX_LABEL_LEN + 1 chars
+int CheckLabelName (char **name_p, char *full_name, Label_list_t *label_list, size_t line)
 {
     if (name_p == nullptr || *name_p == nullptr || label_list == nullptr) return NULLPTR_ARG;
 
@@ -209,7 +926,7 @@ int CheckLabelName (char **name_p, Label_list_t *label_list, size_t line)
         return COMP_ERROR;
     }
 
-    if (len >= MAX_LABEL_LEN)
+    if (Scope_label (name, label_list, full_name))
     {
         fprintf (ERROR_STREAM, "Compilation error:\nlabel name at line (%Iu) is too long.\n", line + 1);
         return COMP_ERROR;
@@ -217,9 +934,9 @@ int CheckLabelName (char **name_p, Label_list_t *label_list, size_t line)
 
     for (size_t index = 0; index < label_list -> num; index++)
     {
-        if (strcmp ((label_list -> list [index]).name, name) == 0)
+        if (strcmp ((label_list -> list [index]).name, full_name) == 0)
         {
-            fprintf (ERROR_STREAM, "Compilation error at line (%Iu):\nlabel (%s) has been already created.\n", line + 1, name);
+            fprintf (ERROR_STREAM, "Compilation error at line (%Iu):\nlabel (%s) has been already created.\n", line + 1, full_name);
             return COMP_ERROR;
         }
     }
@@ -229,6 +946,31 @@ int CheckLabelName (char **name_p, Label_list_t *label_list, size_t line)
     return OK;
 }
 
+// a local label is named after the last label without the mark, so functions can number theirs from zero
+int Scope_label (const char *name, Label_list_t *label_list, char *full_name)
+{
+    const char *scope = (name [0] == LOCAL_LABEL_MARK) ? label_list -> scope : "";
+
+    if (strlen (scope) + strlen (name) >= MAX_LABEL_LEN) return COMP_ERROR;
+
+    strcpy (full_name, scope);
+    strcat (full_name, name);
+
+    return OK;
+}
+
+// every pass goes through the labels in order, so the scope is the same for definitions and uses
+void Set_label_scope (const char *cmd, Label_list_t *label_list)
+{
+    if (cmd [0] == LOCAL_LABEL_MARK) return;
+
+    size_t len = strcspn (cmd, ":");
+    if (len > MAX_LABEL_LEN) len = MAX_LABEL_LEN;
+
+    memcpy (label_list -> scope, cmd, len);
+    (label_list -> scope) [len] = '\0';
+}
+
 int ExpandLabelList (Label_list_t *label_list)
 {
     if (label_list == nullptr) return NULLPTR_ARG;
@@ -259,6 +1001,32 @@ int GetLabelIp (char *name, Label_list_t *label_list)
 
 //----------------------------------------------------------------------------------------------------------------------
 
+void LabelListDtor (Label_list_t *label_list)
+{
+    if (label_list == nullptr) return;
+
+    free (label_list -> list);
+
+    label_list -> list    = nullptr;
+    label_list -> num     = 0;
+    label_list -> max_num = 0;
+}
+
+int WriteSymbols (const char *output_file_name, Label_list_t *label_list)
+{
+    if (output_file_name == nullptr || label_list == nullptr) return NULLPTR_ARG;
+
+    FILE *out_file = fopen (output_file_name, "w");
+    if (out_file == nullptr) return FOPEN_ERROR;
+
+    for (size_t index = 0; index < label_list -> num; index++)
+        fprintf (out_file, "%d %s\n", (label_list -> list [index]).ip, (label_list -> list [index]).name);
+
+    fclose (out_file);
+
+    return OK;
+}
+
 int PutArgs (char *args, cmd_t *cmds, int *ip, Label_list_t *label_list, size_t line, int pass)
 {
     args = DeleteSpaces (args);
@@ -270,6 +1038,7 @@ int PutArgs (char *args, cmd_t *cmds, int *ip, Label_list_t *label_list, size_t
     }
 
     size_t len = strlen (args);
+    int is_mem = 0;
 
     if (strchr (args, '['))
     {
@@ -285,6 +1054,7 @@ int PutArgs (char *args, cmd_t *cmds, int *ip, Label_list_t *label_list, size_t
         len -= 2;
 
         cmds [*ip - 1] |= ARG_MEM;
+        is_mem = 1;
     }
     
     char *arg1 = args;
@@ -310,7 +1080,7 @@ int PutArgs (char *args, cmd_t *cmds, int *ip, Label_list_t *label_list, size_t
         }
         else
         {
-            cmds [*ip + 1] = GetLabelIp (arg2, label_list);
+            if (Put_label_ip (arg2, cmds, *ip + 1, label_list, pass)) return COMP_ERROR;
 
             if (pass >= 2 && cmds [*ip + 1] == -1)
             {
@@ -334,10 +1104,12 @@ int PutArgs (char *args, cmd_t *cmds, int *ip, Label_list_t *label_list, size_t
     {
         sscanf (arg1, "%d", cmds + (*ip)++);
         got_im = 1;
+
+        if (is_mem && !arg2 && AddReloc (label_list, cmds, *ip - 1, RELOC_GLOBAL, 0, pass)) return COMP_ERROR;
     }
     else
     {
-        if (!got_im) cmds [(*ip)++] = GetLabelIp (arg1, label_list);
+        if (!got_im && Put_label_ip (arg1, cmds, (*ip)++, label_list, pass)) return COMP_ERROR;
             
         if (got_im || (pass >= 2 && cmds [*ip - 1] == -1))
         {
@@ -354,6 +1126,173 @@ int PutArgs (char *args, cmd_t *cmds, int *ip, Label_list_t *label_list, size_t
     return OK;
 }
 
+// in a unit a label not defined here is left to the linker
+int Put_label_ip (char *name, cmd_t *cmds, int pos, Label_list_t *label_list, int pass)
+{
+    char full_name [MAX_LABEL_LEN + 1] = "";
+    if (Scope_label (name, label_list, full_name)) return COMP_ERROR;
+
+    cmds [pos] = GetLabelIp (full_name, label_list);
+
+    if (label_list -> obj == nullptr || pass < NUM_OF_ASM - 1) return OK;
+
+    if (cmds [pos] >= 0) return AddReloc (label_list, cmds, pos, RELOC_CODE, 0, pass);
+
+    cmds [pos] = 0;
+
+    int sym = AddImport (label_list -> obj, full_name);
+    if (sym < 0) return ALLOC_ERROR;
+
+    return AddReloc (label_list, cmds, pos, RELOC_SYMBOL, sym, pass);
+}
+
+int AddReloc (Label_list_t *label_list, const cmd_t *cmds, int pos, int kind, int sym, int pass)
+{
+    Obj_t *obj = label_list -> obj;
+    if (obj == nullptr || pass < NUM_OF_ASM - 1) return OK;
+
+    Reloc_list_t *relocs = &(obj -> relocs);
+
+    if (relocs -> num >= relocs -> max_num)
+    {
+        size_t old_num = relocs -> max_num;
+        size_t new_num = old_num ? old_num * 2 : RELOCS_BASE_NUM;
+
+        Reloc_t *list = (Reloc_t *) Recalloc ((void *) relocs -> list, new_num, sizeof (Reloc_t), old_num);
+        if (list == nullptr) return ALLOC_ERROR;
+
+        relocs -> list    = list;
+        relocs -> max_num = new_num;
+    }
+
+    relocs -> list [relocs -> num].pos  = pos;
+    relocs -> list [relocs -> num].kind = kind;
+    relocs -> list [relocs -> num].sym  = sym;
+    relocs -> num++;
+
+    if (kind == RELOC_GLOBAL && cmds [pos] > obj -> globals) obj -> globals = cmds [pos];
+
+    return OK;
+}
+
+// index of the name in the imports, -1 - no memory
+int AddImport (Obj_t *obj, const char *name)
+{
+    Label_list_t *imports = &(obj -> imports);
+
+    for (size_t index = 0; index < imports -> num; index++)
+        if (strcmp ((imports -> list [index]).name, name) == 0) return (int) index;
+
+    if (ExpandLabelList (imports)) return -1;
+
+    strcpy ((imports -> list [imports -> num]).name, name);
+    (imports -> list [imports -> num]).ip   = -1;
+    (imports -> list [imports -> num]).args = ARGS_UNKNOWN;
+
+    return (int) (imports -> num++);
+}
+
+// #EXPORT or #IMPORT: "label [number of arguments]"
+int AddSymbol (Label_list_t *label_list, const char *cmd, char *args, size_t line)
+{
+    char *name = DeleteSpaces (args);
+    char *num  = name + strcspn (name, " \t");
+
+    int num_of_args = ARGS_UNKNOWN;
+
+    if (*num != '\0')
+    {
+        *num++ = '\0';
+
+        if (sscanf (num, "%d", &num_of_args) != 1 || num_of_args < 0)
+        {
+            fprintf (ERROR_STREAM, "Compilation error:\nincorrect %s at line (%Iu).\n", cmd, line + 1);
+            return COMP_ERROR;
+        }
+    }
+
+    if (stricmp (cmd, EXPORT_CMD_NAME) == 0) return AddExport (label_list, name, num_of_args, line);
+
+    int sym = AddImport (label_list -> obj, name);
+    if (sym < 0) return ALLOC_ERROR;
+
+    (label_list -> obj -> imports.list [sym]).args = num_of_args;
+
+    return OK;
+}
+
+int AddExport (Label_list_t *label_list, char *name, int num_of_args, size_t line)
+{
+    int ip = GetLabelIp (name, label_list);
+    if (ip < 0)
+    {
+        fprintf (ERROR_STREAM, "Compilation error:\nexported label (%s) at line (%Iu) is not defined.\n", name, line + 1);
+        return COMP_ERROR;
+    }
+
+    Label_list_t *exports = &(label_list -> obj -> exports);
+
+    if (ExpandLabelList (exports)) return ALLOC_ERROR;
+
+    strcpy ((exports -> list [exports -> num  ]).name, name);
+            (exports -> list [exports -> num  ]).ip   = ip;
+            (exports -> list [exports -> num++]).args = num_of_args;
+
+    return OK;
+}
+
+int ObjCtor (Obj_t *obj)
+{
+    if (obj == nullptr) return NULLPTR_ARG;
+
+    int err = LabelListCtor (&(obj -> exports));
+    if (err == OK) err = LabelListCtor (&(obj -> imports));
+
+    return err;
+}
+
+void ObjDtor (Obj_t *obj)
+{
+    if (obj == nullptr) return;
+
+    LabelListDtor (&(obj -> exports));
+    LabelListDtor (&(obj -> imports));
+
+    free (obj -> relocs.list);
+    free (obj -> image);
+
+    obj -> relocs.list = nullptr;
+    obj -> relocs.num  = 0;
+    obj -> image       = nullptr;
+}
+
+// the image is kept in words, the linker patches it before the program is packed
+int WriteObj (const char *output_file_name, cmd_t *cmds, Obj_t *obj)
+{
+    if (output_file_name == nullptr || cmds == nullptr || obj == nullptr) return NULLPTR_ARG;
+
+    size_t size = GetImageSize (cmds);
+
+    cmd_t header [OBJ_HEADER_SIZE] = {OBJ_SIGNATURE, (cmd_t) size, obj -> globals,
+                                      (cmd_t) obj -> exports.num, (cmd_t) obj -> imports.num, (cmd_t) obj -> relocs.num};
+
+    FILE *out_file = OpenStream (output_file_name, "wb");
+    if (out_file == nullptr) return FOPEN_ERROR;
+
+    int err = OK;
+
+    if (fwrite (header,              CMD_SIZE,         OBJ_HEADER_SIZE,    out_file) != OBJ_HEADER_SIZE    ||
+        fwrite (cmds,                CMD_SIZE,         size,               out_file) != size               ||
+        fwrite (obj -> exports.list, sizeof (Label_t), obj -> exports.num, out_file) != obj -> exports.num ||
+        fwrite (obj -> imports.list, sizeof (Label_t), obj -> imports.num, out_file) != obj -> imports.num ||
+        fwrite (obj -> relocs.list,  sizeof (Reloc_t), obj -> relocs.num,  out_file) != obj -> relocs.num)
+        err = FWRITE_ERROR;
+
+    CloseStream (out_file);
+
+    return err;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 
 char *DeleteSpaces (char *str)
@@ -370,19 +1309,43 @@ char *DeleteSpaces (char *str)
     return str;
 }
 
-int WriteCmds (const char *output_file_name, cmd_t *cmds)
+// the file gets the packed image; labels, when label_list is not nullptr, move to the byte ips of their commands
+int WriteCmds (const char *output_file_name, cmd_t *cmds, Label_list_t *label_list)
 {
     if (output_file_name == nullptr) return NULLPTR_ARG;
     if             (cmds == nullptr) return NULLPTR_ARG;
 
-    FILE *out_file = fopen (output_file_name, "wb");
-    if (out_file == nullptr) return FOPEN_ERROR;
+    int code_size = cmds [CODE_SHIFT + CODESIZE_POS];
 
-    if (fwrite ((void *) cmds, CMD_SIZE, cmds [2] + CODE_SHIFT, out_file) != (size_t) (cmds [2] + CODE_SHIFT)) return FWRITE_ERROR;
+    cmd_t *image    = nullptr;
+    size_t size     = 0;
+    int   *byte_ips = nullptr;
 
-    fclose (out_file);
+    int err = PackImage (cmds, GetImageSize (cmds), &image, &size, label_list ? &byte_ips : nullptr);
+    if (err == ALLOC_ERROR) return err;
+    if (err)
+    {
+        fprintf (ERROR_STREAM, "Compilation error:\ncode cannot be packed.\n");
+        return COMP_ERROR;
+    }
 
-    return OK;
+    for (size_t index = 0; label_list && index < label_list -> num; index++)
+    {
+        int *ip = &((label_list -> list [index]).ip);
+        if (*ip >= 0 && *ip <= code_size) *ip = byte_ips [*ip];
+    }
+
+    free (byte_ips);
+
+    FILE *out_file = OpenStream (output_file_name, "wb");
+    if (out_file == nullptr) err = FOPEN_ERROR;
+
+    if (err == OK && fwrite ((void *) image, CMD_SIZE, size, out_file) != size) err = FWRITE_ERROR;
+
+    if (out_file) CloseStream (out_file);
+    free (image);
+
+    return err;
 }
 
 
@@ -395,16 +1358,9 @@ void AsmErr (int err, FILE *stream)
     else if (err == FOPEN_ERROR) fprintf (stream, "Cannot open the file.\n");
     else if (err == ALLOC_ERROR) fprintf (stream, "Cannot allocate memory.\n");
     else if (err ==  COMP_ERROR) fprintf (stream, "Compilation error.\n");
+    else if (err ==  LINK_ERROR) fprintf (stream, "Link error.\n");
+    else if (err == WRONG_SIGNATURE) fprintf (stream, "Unit has wrong signature.\n");
+    else if (err == WRONG_VERSION)   fprintf (stream, "Unit version differs from cpu version.\n");
+    else if (err == WRONG_CODESIZE)  fprintf (stream, "Unit has wrong code size.\n");
     else                         fprintf (stream, "Unknown error.\n");
 }
-
-
-void *Recalloc (void *memptr, size_t num, size_t size, size_t old_num)
-{
-    memptr = realloc (memptr, num * size);
-    if (memptr == NULL) return NULL;
-
-    if (num > old_num) memset ((void *) ((char *) memptr + old_num * size), 0, (num - old_num) * size);
-
-    return memptr;
-}
@@ -0,0 +1,89 @@
+#include "proc.h"
+
+
+#define Ret_if_err(func)                    \
+    err = func;                             \
+    if (err)                                \
+    {                                       \
+        AsmErr (err, ERROR_STREAM);         \
+        return err;                         \
+    }
+
+
+thread_local FILE *ERROR_STREAM = stdout;
+
+
+int main (int argc, char *argv[])
+{
+    const char *  input_file_name = nullptr;
+    const char * output_file_name = nullptr;
+    const char *symbols_file_name = nullptr;
+    int  write_symbols = 0;
+    int     write_obj  = 0;
+    int      file_args = 0;
+    unsigned threads_num = 0;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if (strcmp (argv [index], SYMBOLS_OPTION) == 0)
+        {
+            write_symbols = 1;
+            if (index + 1 < argc && argv [index + 1][0] != '-') symbols_file_name = argv [++index];
+        }
+        else if (strcmp (argv [index], OBJECT_OPTION) == 0) write_obj = 1;
+        else if (strcmp (argv [index], THREADS_OPTION) == 0 && index + 1 < argc)
+        {
+            int num = atoi (argv [++index]);
+            threads_num = num > 0 ? (unsigned) num : 0;
+        }
+        else if (file_args == 0) { file_args++;  input_file_name = argv [index]; }
+        else if (file_args == 1) { file_args++; output_file_name = argv [index]; }
+    }
+
+    if ( input_file_name == nullptr)  input_file_name = "in.txt";
+    if (output_file_name == nullptr) output_file_name =      "a";
+
+    // stdout carries the code, messages go aside
+    if (strcmp (output_file_name, STD_STREAM) == 0) ERROR_STREAM = stderr;
+
+    char default_symbols [BUFLEN] = "";
+    if (symbols_file_name == nullptr)
+    {
+        snprintf (default_symbols, BUFLEN, "%s%s", strcmp (output_file_name, STD_STREAM) ? output_file_name : "a", SYMBOLS_EXT);
+        symbols_file_name = default_symbols;
+    }
+
+
+    cmd_t *commands = nullptr;
+    struct Text txt = {};
+    Label_list_t label_list = {};
+    Obj_t obj = {};
+
+    int err = OK;
+
+    if (write_obj)
+    {
+        Ret_if_err (ObjCtor (&obj));
+        label_list.obj = &obj;
+    }
+
+    Ret_if_err (ReadText (input_file_name, &txt));
+
+    Ret_if_err (Compile (&txt, &commands, &label_list, threads_num));
+
+    FreeText (&txt);
+
+    if (write_obj) { Ret_if_err (WriteObj  (output_file_name, commands, &obj)); }
+    else           { Ret_if_err (WriteCmds (output_file_name, commands, &label_list)); }
+
+    if (write_symbols)
+    {
+        Ret_if_err (WriteSymbols (symbols_file_name, &label_list));
+    }
+
+    LabelListDtor (&label_list);
+    ObjDtor (&obj);
+    free (commands);
+
+    return OK;
+}
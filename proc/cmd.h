@@ -1,6 +1,6 @@
 DEF_CMD (HLT, 0, 0,
 {
-    return OK;
+    return FlushOut (cpu);
 })
 
 DEF_CMD (PUSH, 1, 1,
@@ -28,7 +28,13 @@ DEF_CMD (POP, 2, 1,
 DEF_CMD (IN, 3, 0,
 {
     arg_t val = 0;
-    ScanArg (&val);
+
+    if (ScanArg (cpu, &val) == RUN_BLOCKED)
+    {
+        cpu -> ip--;                            // IN runs again once the host feeds input
+        return RUN_BLOCKED;
+    }
+
     StackPush (&(cpu -> stk), val * cpu -> accuracy_coef);
 })
 
@@ -41,7 +47,7 @@ DEF_CMD (OUT, 4, 0,
 
     if (err) return EMPTY_STACK;
 
-    PrintArg (val, cpu -> accuracy_coef);
+    PrintArg (cpu, val);
 })
 
 DEF_CMD (ADD, 5, 0, 
@@ -102,26 +108,26 @@ DEF_CMD (DIV, 8, 0,
 
 DEF_CMD (DUMP, 9, 0,
 {
-    printf ("\nCPU DUMP:\n\n");
-    PrintCode (cpu, stdout);
-    PrintRegs (cpu, stdout);
-    printf ("\n");
+    FlushOut (cpu);
+
+    if (cpu -> out_file == nullptr && cpu -> write_cb == nullptr)
+    {
+        int err = CaptureDump (cpu);
+        if (err) return err;
+    }
+    else PrintDump (cpu, cpu -> out_file ? cpu -> out_file : cpu -> dump_file);
 })
 
 
 #define DEF_NONARITHM_JMP(name, num, cond)                  \
 DEF_CMD (name, num, 1,                                      \
 {                                                           \
-    arg_t arg = 0;                                          \
+    int ip = 0;                                             \
                                                             \
-    int err = GetArgs (cpu, cmd, &arg);                     \
+    int err = GetJumpIp (cpu, cmd, &ip);                    \
     if (err) return err;                                    \
                                                             \
-    arg = arg / cpu -> accuracy_coef;                       \
-                                                            \
-    if (arg >= cpu -> code_size) return INCORRECT_JMP_IP;   \
-                                                            \
-    if (cond) cpu -> ip = arg;                              \
+    if (cond) cpu -> ip = ip;                               \
 }) 
 
 DEF_NONARITHM_JMP (JMP, 10, 1)
@@ -144,20 +150,16 @@ DEF_CMD (name, num, 1,                                      \
                                                             \
     if (!(x2 op x1))                                        \
     {                                                       \
-        cpu -> ip ++;                                       \
+        Skip_args (cpu, cmd);                               \
         break;                                              \
     }                                                       \
                                                             \
-    arg_t arg = 0;                                          \
+    int ip = 0;                                             \
                                                             \
-    err |= GetArgs (cpu, cmd, &arg);                        \
+    err |= GetJumpIp (cpu, cmd, &ip);                       \
     if (err) return err;                                    \
                                                             \
-    arg = arg / cpu -> accuracy_coef;                       \
-                                                            \
-    if (arg >= cpu -> code_size) return INCORRECT_JMP_IP;   \
-                                                            \
-    cpu -> ip = arg;                                        \
+    cpu -> ip = ip;                                         \
 })
 
 DEF_JMP (JA , 11,  >)
@@ -177,18 +179,14 @@ DEF_JMP (JNE, 16, !=)
 
 DEF_CMD (CALL, 17, 1,
 {
-    arg_t arg = 0;
+    int ip = 0;
 
-    int err = GetArgs (cpu, cmd, &arg);
+    int err = GetJumpIp (cpu, cmd, &ip);
     if (err) return err;
 
-    arg = arg / cpu -> accuracy_coef;
-
-    if (arg >= cpu -> code_size) return INCORRECT_JMP_IP;
-
     StackPush (&(cpu -> call_stk), cpu -> ip);
 
-    cpu -> ip = arg;
+    cpu -> ip = ip;
 })
 
 DEF_CMD (RET, 18, 0,
@@ -211,7 +209,7 @@ DEF_CMD (SQRT, 19, 0,
 
     if (x < 0) return SQRT_OF_NEG;
 
-    x = (arg_t) (sqrt (((double) x) / cpu -> accuracy_coef) * cpu -> accuracy_coef); 
+    x = FixSqrt (x, cpu -> accuracy_coef);
 
     StackPush (&(cpu -> stk),  x);
 
@@ -225,7 +223,7 @@ DEF_CMD (SIN, 21, 0,
     err |= StackPop (&(cpu -> stk), &x);
     if (err) return EMPTY_STACK;
 
-    x = (arg_t) (sin (((double) x) / cpu -> accuracy_coef) * cpu -> accuracy_coef); 
+    x = FixSin (x, cpu -> accuracy_coef);
 
     StackPush (&(cpu -> stk),  x);
 })
@@ -240,6 +238,6 @@ DEF_CMD (POW, 22, 0,
 
     if (err) return EMPTY_STACK;
 
-    StackPush (&(cpu -> stk), (arg_t) (pow (((double) x2) / cpu -> accuracy_coef, ((double) x1) / cpu -> accuracy_coef) * cpu -> accuracy_coef));
+    StackPush (&(cpu -> stk), FixPow (x2, x1, cpu -> accuracy_coef));
 
 })
\ No newline at end of file
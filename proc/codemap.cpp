@@ -0,0 +1,227 @@
+#include "proc.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
+
+
+int MapFile (const char *file_name, Map_t *map)
+{
+    if (file_name == nullptr || map == nullptr) return NULLPTR_ARG;
+
+    *map = {};
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA (file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return FOPEN_ERROR;
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx (file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle (file);
+        return FOPEN_ERROR;
+    }
+
+    HANDLE mapping = CreateFileMappingA (file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle (file);
+    if (mapping == nullptr) return FOPEN_ERROR;
+
+    void *data = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        CloseHandle (mapping);
+        return FOPEN_ERROR;
+    }
+
+    map -> handle = (void *) mapping;
+    map -> size   = (size_t) size.QuadPart;
+#else
+    int fd = open (file_name, O_RDONLY);
+    if (fd < 0) return FOPEN_ERROR;
+
+    struct stat info = {};
+    if (fstat (fd, &info) || info.st_size == 0)
+    {
+        close (fd);
+        return FOPEN_ERROR;
+    }
+
+    void *data = mmap (nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (data == MAP_FAILED) return FOPEN_ERROR;
+
+    map -> size = (size_t) info.st_size;
+#endif
+
+    map -> data = data;
+
+    return OK;
+}
+
+void UnmapFile (Map_t *map)
+{
+    if (map == nullptr || map -> data == nullptr) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile (map -> data);
+    CloseHandle ((HANDLE) map -> handle);
+#else
+    munmap (map -> data, map -> size);
+#endif
+
+    *map = {};
+}
+
+// FNV-1a, 64 bit
+unsigned long long CodeHash (const void *data, size_t size)
+{
+    const unsigned char *byte = (const unsigned char *) data;
+
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+
+    for (size_t index = 0; index < size; index++)
+    {
+        hash ^= byte [index];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// checks what can be checked without running: commands, their bytes, registers, constant jumps
+int VerifyCode (const Cpu_t *cpu)
+{
+    if (cpu == nullptr || cpu -> code == nullptr) return NULLPTR_ARG;
+
+    const unsigned char *code = cpu -> code;
+    int code_size = cpu -> code_size;
+
+    char *starts = (char *) calloc ((size_t) code_size + 1, sizeof (char));
+    if (starts == nullptr) return ALLOC_ERROR;
+
+    int err = OK;
+    int ip  = 0;
+
+    while (ip < code_size && err == OK)
+    {
+        cmd_t cmd = 0;
+        int  next = UnpackCmd (code, code_size, ip, &cmd, nullptr);
+        int  args = Cmd_args_num (cmd & CMD_MASK);
+        int   reg = cmd >> CMD_REG_SHIFT;
+
+        starts [ip] = 1;
+
+        if      (next < 0)                                                  err = WRONG_CODESIZE;
+        else if (args < 0)                                                  err = UNKNOWN_CMD;
+        else if (args == 0 && (cmd & ~CMD_MASK))                            err = INCORRECT_ARG_TYPE;
+        else if ((cmd & ARG_REG) && (reg <= 0 || reg >= NUM_OF_REGS))       err = INCORRECT_REG;
+
+        ip = next;
+    }
+
+    // a constant jump has to land on a command
+    for (ip = 0; ip < code_size && err == OK; )
+    {
+        cmd_t cmd = 0;
+        arg_t  im = 0;
+
+        int next = UnpackCmd (code, code_size, ip, &cmd, &im);
+
+        if (Is_const_jump (cmd) && (im < 0 || im >= code_size || !starts [im])) err = INCORRECT_JMP_IP;
+
+        ip = next;
+    }
+
+    free (starts);
+
+    return err;
+}
+
+// header, code and line table of a loaded image
+size_t Image_words (const Cpu_t *cpu)
+{
+    size_t words = CODE_SHIFT + Code_words (cpu -> code_size);
+
+    if (cpu -> lines) words += LINES_HEADER_SIZE + cpu -> lines_num * (sizeof (Line_t) / CMD_SIZE);
+
+    return words;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// cache_dir/<hash>.pvc holds a verified image of the file, later runs map it and skip VerifyCode
+int ReadCodeCached (const char *input_file_name, Cpu_t *cpu, const char *cache_dir)
+{
+    if (input_file_name == nullptr || cpu == nullptr || cache_dir == nullptr) return NULLPTR_ARG;
+
+    Map_t source = {};
+    if (strcmp (input_file_name, STD_STREAM) == 0 || MapFile (input_file_name, &source) != OK || source.size < INFO_SIZE || source.size % CMD_SIZE)
+    {
+        UnmapFile (&source);
+        return ReadCode (input_file_name, cpu);
+    }
+
+    unsigned long long hash = CodeHash (source.data, source.size);
+
+    char cache_name [CACHE_NAME_LEN] = "";
+    snprintf (cache_name, CACHE_NAME_LEN, "%s/%016llx.pvc", cache_dir, hash);
+
+    Map_t cached = {};
+    if (MapFile (cache_name, &cached) == OK)
+    {
+        const cmd_t *header = (const cmd_t *) cached.data;
+
+        if (cached.size >= (size_t) CACHE_HEADER_SIZE * CMD_SIZE &&
+            header [0] == CACHE_SIGNATURE && header [1] == VERSION &&
+            (unsigned) header [2] == (unsigned) (hash & 0xFFFFFFFF) && (unsigned) header [3] == (unsigned) (hash >> 32) &&
+            cached.size == (CACHE_HEADER_SIZE + (size_t) header [4]) * CMD_SIZE)
+        {
+            UnmapFile (&source);
+            return Set_mapped_code (cpu, &cached, CACHE_HEADER_SIZE);
+        }
+
+        UnmapFile (&cached);
+    }
+
+    int err = Set_mapped_code (cpu, &source, 0);
+    if (err) return err;
+
+    // the cache keeps the packed image; only images that pass the checks are cached, the others just run as usual
+    if (InfoCheck (cpu) == OK && VerifyCode (cpu) == OK)
+        Cache_write (cache_name, hash, cpu -> header - CODE_SHIFT, Image_words (cpu));
+
+    return OK;
+}
+
+// written next to the final name and renamed, so a reader never maps half a file
+int Cache_write (const char *cache_name, unsigned long long hash, const cmd_t *image, size_t words)
+{
+    if (cache_name == nullptr || image == nullptr) return NULLPTR_ARG;
+
+    // the pid tells drivers apart, the counter the threads and calls of one process
+    static std::atomic <unsigned> temp_count (0);
+
+    char temp_name [CACHE_NAME_LEN + 48] = "";
+    snprintf (temp_name, sizeof (temp_name), "%s.%d.%u.tmp", cache_name, (int) getpid (), temp_count.fetch_add (1));
+
+    FILE *cache_file = fopen (temp_name, "wb");
+    if (cache_file == nullptr) return FOPEN_ERROR;
+
+    cmd_t header [CACHE_HEADER_SIZE] = {CACHE_SIGNATURE, VERSION, (cmd_t) (hash & 0xFFFFFFFF), (cmd_t) (hash >> 32), (cmd_t) words};
+
+    int err = OK;
+    if (fwrite (header, CMD_SIZE, CACHE_HEADER_SIZE, cache_file) != (size_t) CACHE_HEADER_SIZE) err = FWRITE_ERROR;
+    if (fwrite (image,  CMD_SIZE, words,             cache_file) != words)                     err = FWRITE_ERROR;
+
+    if (fclose (cache_file)) err = FWRITE_ERROR;
+
+    if (err == OK && rename (temp_name, cache_name)) err = FWRITE_ERROR;
+    if (err) remove (temp_name);
+
+    return err;
+}
@@ -0,0 +1,76 @@
+#include <math.h>
+#include "fixmath.h"
+
+
+// the double root is within one of the integer one below 2^52, the corrections make it exact anyway
+unsigned long long ISqrt (unsigned long long num)
+{
+    if (num < 2) return num;
+
+    unsigned long long x = (unsigned long long) sqrt ((double) num);
+    if (x > FIX_SQRT_MAX_ROOT) x = FIX_SQRT_MAX_ROOT;
+
+    while (x * x > num) x--;
+    while (x < FIX_SQRT_MAX_ROOT && (x + 1) * (x + 1) <= num) x++;
+
+    return x;
+}
+
+arg_t FixSqrt (arg_t x, int accuracy_coef)
+{
+    if (x <= 0) return 0;
+
+    // sqrt (x / coef) * coef == sqrt (x * coef)
+    return (arg_t) ISqrt ((unsigned long long) x * (unsigned long long) accuracy_coef);
+}
+
+arg_t FixSin (arg_t x, int accuracy_coef)
+{
+    // angle in 2^-32 turns, wraps around by itself
+    unsigned int turns = (unsigned int) ((long long) x * FIX_INV_TWO_PI / accuracy_coef);
+
+    unsigned int quadrant = turns >> 30;
+    long long    rest     = turns & (FIX_ONE - 1);
+
+    if (quadrant & 1) rest = FIX_ONE - rest;
+
+    long long rad = (rest * FIX_HALF_PI) >> 30;         // [0, pi / 2] in Q30
+    long long rad2 = (rad * rad) >> 30;
+
+    // Taylor series up to x^11 in Horner form, error < 1e-7 on [0, pi / 2]
+    long long sum = FIX_ONE - rad2 / 110;
+    sum = FIX_ONE - ((rad2 * sum) >> 30) / 72;
+    sum = FIX_ONE - ((rad2 * sum) >> 30) / 42;
+    sum = FIX_ONE - ((rad2 * sum) >> 30) / 20;
+    sum = FIX_ONE - ((rad2 * sum) >> 30) /  6;
+    sum = (rad * sum) >> 30;
+
+    arg_t res = (arg_t) (sum * accuracy_coef / FIX_ONE);
+
+    return quadrant >= 2 ? -res : res;
+}
+
+arg_t FixPow (arg_t base, arg_t exp, int accuracy_coef)
+{
+    if (exp % accuracy_coef != 0 || exp < 0 || exp / accuracy_coef > FIX_POW_MAX_EXP)
+        return (arg_t) (pow (((double) base) / accuracy_coef, ((double) exp) / accuracy_coef) * accuracy_coef);
+
+    int n = exp / accuracy_coef;
+
+    // FIX_POW_EXTRA_BITS more bits than the cpu keeps, so truncation does not pile up
+    fixwide_t one = (fixwide_t) accuracy_coef << FIX_POW_EXTRA_BITS;
+    fixwide_t res = one;
+    fixwide_t sqr = (fixwide_t) base << FIX_POW_EXTRA_BITS;
+
+    while (n)
+    {
+        if (n & 1) res = res * sqr / one;
+        n >>= 1;
+        if (n) sqr = sqr * sqr / one;
+
+        if (res > FIX_POW_LIMIT || res < -FIX_POW_LIMIT || sqr > FIX_POW_LIMIT || sqr < -FIX_POW_LIMIT)
+            return (arg_t) (pow (((double) base) / accuracy_coef, ((double) exp) / accuracy_coef) * accuracy_coef);
+    }
+
+    return (arg_t) (res / ((fixwide_t) 1 << FIX_POW_EXTRA_BITS));
+}
@@ -0,0 +1,29 @@
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include "proc.h"
+
+
+typedef __int128 fixwide_t;
+
+const long long FIX_ONE = 1LL << 30;                    // 1.0 in Q30
+
+const unsigned long long FIX_SQRT_MAX_ROOT = 0xFFFFFFFFULL; // its square still fits in 64 bits
+
+const long long FIX_HALF_PI    = 1686629713LL;          // round (pi / 2 * 2^30)
+const long long FIX_INV_TWO_PI =  683565276LL;          // round (2^32 / (2 * pi))
+
+const int FIX_POW_MAX_EXP    = 64;                      // bigger exponents go to libm
+const int FIX_POW_EXTRA_BITS = 30;
+const fixwide_t FIX_POW_LIMIT = (fixwide_t) 1 << 63;    // keeps res * sqr inside 128 bits
+
+
+unsigned long long ISqrt (unsigned long long num);
+
+arg_t FixSqrt (arg_t x, int accuracy_coef);
+
+arg_t FixSin (arg_t x, int accuracy_coef);
+
+arg_t FixPow (arg_t base, arg_t exp, int accuracy_coef);
+
+#endif
@@ -0,0 +1,125 @@
+#include "lanes.h"
+
+
+int LanesCtor (Lanes_t *lanes, const Cpu_t *image)
+{
+    if (lanes == nullptr || image == nullptr || image -> code == nullptr) return NULLPTR_ARG;
+
+    lanes -> code          = image -> code;
+    lanes -> code_size     = image -> code_size;
+    lanes -> accuracy_coef = image -> header [ACCURACY_POS];
+
+    lanes -> word_ips     = image -> word_ips;
+    lanes -> word_ips_num = image -> word_ips_num;
+
+    for (int l = 0; l < LANES; l++)
+    {
+        lanes -> out [l] = (char *) calloc (OUT_BUF_SIZE, sizeof (char));
+        if (lanes -> out [l] == nullptr) return ALLOC_ERROR;
+
+        lanes -> out_max_len [l] = OUT_BUF_SIZE;
+    }
+
+    LanesReset (lanes);
+
+    return OK;
+}
+
+void LanesDtor (Lanes_t *lanes)
+{
+    if (lanes == nullptr) return;
+
+    for (int l = 0; l < LANES; l++)
+    {
+        free (lanes -> out [l]);
+
+        lanes -> out         [l] = nullptr;
+        lanes -> out_len     [l] = 0;
+        lanes -> out_max_len [l] = 0;
+    }
+}
+
+void LanesReset (Lanes_t *lanes)
+{
+    if (lanes == nullptr) return;
+
+    for (int l = 0; l < LANES; l++)
+    {
+        lanes -> ip     [l] = 0;
+        lanes -> active [l] = 0;
+        lanes -> err    [l] = OK;
+        lanes -> sp     [l] = 0;
+        lanes -> csp    [l] = 0;
+
+        lanes -> in      [l] = nullptr;
+        lanes -> in_pos  [l] = 0;
+        lanes -> in_len  [l] = 0;
+        lanes -> out_len [l] = 0;
+    }
+
+    memset (lanes -> regs, 0, sizeof (lanes -> regs));
+    memset (lanes -> ram,  0, sizeof (lanes -> ram ));
+}
+
+void LanesSetInput (Lanes_t *lanes, int lane, const char *input, size_t input_len)
+{
+    lanes -> in     [lane] = input;
+    lanes -> in_pos [lane] = 0;
+    lanes -> in_len [lane] = input_len;
+
+    lanes -> active [lane] = 1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// the engine built for the cpu at hand; the check runs once
+int LanesRun (Lanes_t *lanes)
+{
+    static const int avx2 = __builtin_cpu_supports ("avx2");
+
+    return avx2 ? Lanes_run_avx2 (lanes) : Lanes_run_base (lanes);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// ScanArg on an input that is all in memory
+void Lane_scan (Lanes_t *lanes, int lane, arg_t *arg)
+{
+    const char *buf = lanes -> in [lane];
+    size_t len = lanes -> in_len [lane];
+    size_t pos = lanes -> in_pos [lane];
+
+    while (pos < len && isspace (buf [pos])) pos++;
+    lanes -> in_pos [lane] = pos;
+
+    if (pos >= len) return;
+
+    int sign = (buf [pos] == '-') ? -1 : 1;
+    if (buf [pos] == '-' || buf [pos] == '+') pos++;
+
+    if (pos >= len || (unsigned) (buf [pos] - '0') >= 10) return;
+
+    arg_t val = 0;
+    while (pos < len && (unsigned) (buf [pos] - '0') < 10) val = val * 10 + (buf [pos++] - '0');
+
+    *arg = sign * val;
+    lanes -> in_pos [lane] = pos;
+}
+
+int Lane_print (Lanes_t *lanes, int lane, arg_t arg)
+{
+    if (lanes -> out_len [lane] + MAX_NUM_LEN > lanes -> out_max_len [lane])
+    {
+        size_t old_len = lanes -> out_max_len [lane];
+
+        char *out = (char *) Recalloc (lanes -> out [lane], old_len * 2, sizeof (char), old_len);
+        if (out == nullptr) return ALLOC_ERROR;
+
+        lanes -> out         [lane] = out;
+        lanes -> out_max_len [lane] = old_len * 2;
+    }
+
+    lanes -> out_len [lane] += FormatArg (lanes -> out [lane] + lanes -> out_len [lane], arg, lanes -> accuracy_coef);
+
+    return OK;
+}
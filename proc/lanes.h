@@ -0,0 +1,69 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include "proc.h"
+
+
+// Experimental lock-step engine: LANES instances of one program run together, one instruction
+// at a time for every lane that stands at the smallest ip. Values live in rows of LANES cells,
+// so the per-lane loops below compile to vector code. The engine is built with -O2 twice, for any
+// x86-64 and with -mavx2, where one row is one ymm register; LanesRun runs the one the cpu supports.
+
+const int LANES = 8;
+
+const int LANES_STACK_SIZE      = 256;
+const int LANES_CALL_STACK_SIZE = 256;
+
+const int LANES_FALLBACK = -1;                  // lane hit something only the plain engine does (DUMP, deep stacks)
+
+const char LANES_OPTION [] = "--lanes";
+
+struct Lanes_t
+{
+    const unsigned char *code;                  // the packed code of the image, ips are bytes
+    int     code_size;
+    int accuracy_coef;
+
+    const int *word_ips;                        // targets of computed jumps, as in Cpu_t
+    int    word_ips_num;
+
+    int ip     [LANES];
+    int active [LANES];                         // 1 while the lane runs
+    int err    [LANES];                         // lanes with errors are rerun by the plain engine
+    int sp     [LANES];
+    int csp    [LANES];
+
+    arg_t stk  [LANES_STACK_SIZE]      [LANES];
+    int   call [LANES_CALL_STACK_SIZE] [LANES];
+    arg_t regs [NUM_OF_REGS]           [LANES];
+    arg_t ram  [RAM_SIZE]              [LANES];
+
+    const char *in     [LANES];
+    size_t      in_pos [LANES];
+    size_t      in_len [LANES];
+
+    char  *out         [LANES];
+    size_t out_len     [LANES];
+    size_t out_max_len [LANES];
+};
+
+
+int LanesCtor (Lanes_t *lanes, const Cpu_t *image);
+
+void LanesDtor (Lanes_t *lanes);
+
+void LanesReset (Lanes_t *lanes);
+
+void LanesSetInput (Lanes_t *lanes, int lane, const char *input, size_t input_len);
+
+int LanesRun (Lanes_t *lanes);
+
+int Lanes_run_base (Lanes_t *lanes);
+
+int Lanes_run_avx2 (Lanes_t *lanes);
+
+void Lane_scan (Lanes_t *lanes, int lane, arg_t *arg);
+
+int Lane_print (Lanes_t *lanes, int lane, arg_t arg);
+
+#endif
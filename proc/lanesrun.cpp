@@ -0,0 +1,537 @@
+#include "lanes.h"
+
+// The lock-step engine. The Makefile builds this file twice, as Lanes_run_base for any x86-64 and as
+// Lanes_run_avx2 with -mavx2; LanesRun picks one. The helpers are static, so each build keeps its own.
+
+#ifndef LANES_ENGINE
+#define LANES_ENGINE Lanes_run_base
+#endif
+
+
+static void Lane_fail (Lanes_t *lanes, int lane, int err);
+
+static int Lanes_uniform_depth (Lanes_t *lanes, const int *mask, int need, int *depth);
+
+static void Lanes_get_args (Lanes_t *lanes, int *mask, cmd_t cmd, arg_t im, arg_t *arg);
+
+static void Lanes_pop_to (Lanes_t *lanes, int *mask, cmd_t cmd, arg_t im, int next);
+
+static void Lanes_jump (Lanes_t *lanes, int *mask, cmd_t cmd, arg_t im, int next, const int *cond, int check_all);
+
+static int Lanes_target (const Lanes_t *lanes, cmd_t cmd, arg_t arg);
+
+// an instruction for all lanes of mask; x1 is the top of the stack, x2 the one below, as in cmd.h
+#define LANES_ARITHM(expr)                                                      \
+{                                                                               \
+    int depth = 0;                                                              \
+                                                                                \
+    if (Lanes_uniform_depth (lanes, mask, 2, &depth))                           \
+    {                                                                           \
+        const arg_t *x1_row = lanes -> stk [depth - 1];                         \
+              arg_t *x2_row = lanes -> stk [depth - 2];                         \
+                                                                                \
+        for (int l = 0; l < LANES; l++)                                         \
+        {                                                                       \
+            arg_t x1 = x1_row [l], x2 = x2_row [l];                             \
+            x2_row [l] = mask [l] ? (expr) : x2;                                \
+        }                                                                       \
+    }                                                                           \
+    else                                                                        \
+    {                                                                           \
+        for (int l = 0; l < LANES; l++)                                         \
+        {                                                                       \
+            if (!mask [l]) continue;                                            \
+                                                                                \
+            if (lanes -> sp [l] < 2)                                            \
+            {                                                                   \
+                Lane_fail (lanes, l, EMPTY_STACK);                              \
+                mask [l] = 0;                                                   \
+                continue;                                                       \
+            }                                                                   \
+                                                                                \
+            arg_t x1 = lanes -> stk [lanes -> sp [l] - 1][l];                   \
+            arg_t x2 = lanes -> stk [lanes -> sp [l] - 2][l];                   \
+            lanes -> stk [lanes -> sp [l] - 2][l] = (expr);                     \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    for (int l = 0; l < LANES; l++)                                             \
+    {                                                                           \
+        lanes -> sp [l] -= mask [l];                                            \
+        lanes -> ip [l]  = mask [l] ? next : lanes -> ip [l];                   \
+    }                                                                           \
+}
+
+// pops x, pushes (expr); a lane fails if (fail) holds
+#define LANES_UNARY(fail, fail_err, expr)                                       \
+{                                                                               \
+    for (int l = 0; l < LANES; l++)                                             \
+    {                                                                           \
+        if (!mask [l]) continue;                                                \
+                                                                                \
+        if (lanes -> sp [l] < 1)                                                \
+        {                                                                       \
+            Lane_fail (lanes, l, EMPTY_STACK);                                  \
+            continue;                                                           \
+        }                                                                       \
+                                                                                \
+        arg_t x = lanes -> stk [lanes -> sp [l] - 1][l];                        \
+        if (fail)                                                               \
+        {                                                                       \
+            Lane_fail (lanes, l, fail_err);                                     \
+            continue;                                                           \
+        }                                                                       \
+                                                                                \
+        lanes -> stk [lanes -> sp [l] - 1][l] = (expr);                         \
+        lanes -> ip [l] = next;                                                 \
+    }                                                                           \
+}
+
+// pops x1 and x2, pushes (expr)
+#define LANES_BINARY(fail, fail_err, expr)                                      \
+{                                                                               \
+    for (int l = 0; l < LANES; l++)                                             \
+    {                                                                           \
+        if (!mask [l]) continue;                                                \
+                                                                                \
+        if (lanes -> sp [l] < 2)                                                \
+        {                                                                       \
+            Lane_fail (lanes, l, EMPTY_STACK);                                  \
+            continue;                                                           \
+        }                                                                       \
+                                                                                \
+        arg_t x1 = lanes -> stk [lanes -> sp [l] - 1][l];                       \
+        arg_t x2 = lanes -> stk [lanes -> sp [l] - 2][l];                       \
+        if (fail)                                                               \
+        {                                                                       \
+            Lane_fail (lanes, l, fail_err);                                     \
+            continue;                                                           \
+        }                                                                       \
+                                                                                \
+        lanes -> stk [lanes -> sp [l] - 2][l] = (expr);                         \
+        lanes -> sp [l]--;                                                      \
+        lanes -> ip [l] = next;                                                 \
+    }                                                                           \
+}
+
+#define LANES_JMP(op)                                                           \
+{                                                                               \
+    int cond [LANES] = {};                                                      \
+                                                                                \
+    for (int l = 0; l < LANES; l++)                                             \
+    {                                                                           \
+        if (!mask [l]) continue;                                                \
+                                                                                \
+        if (lanes -> sp [l] < 2)                                                \
+        {                                                                       \
+            Lane_fail (lanes, l, EMPTY_STACK);                                  \
+            mask [l] = 0;                                                       \
+            continue;                                                           \
+        }                                                                       \
+                                                                                \
+        arg_t x1 = lanes -> stk [lanes -> sp [l] - 1][l];                       \
+        arg_t x2 = lanes -> stk [lanes -> sp [l] - 2][l];                       \
+        lanes -> sp [l] -= 2;                                                   \
+                                                                                \
+        cond [l] = x2 op x1;                                                    \
+    }                                                                           \
+                                                                                \
+    Lanes_jump (lanes, mask, cmd, im, next, cond, 0);                           \
+}
+
+
+int LANES_ENGINE (Lanes_t *lanes)
+{
+    if (lanes == nullptr || lanes -> code == nullptr) return NULLPTR_ARG;
+
+    const int coef = lanes -> accuracy_coef;
+
+    while (1)
+    {
+        // lanes that jumped back wait for the others at the smallest ip, so paths join again
+        int ip = lanes -> code_size;
+
+        for (int l = 0; l < LANES; l++)
+        {
+            if (!lanes -> active [l]) continue;
+
+            if (lanes -> ip [l] < 0 || lanes -> ip [l] >= lanes -> code_size) Lane_fail (lanes, l, INCORRECT_JMP_IP);
+            else if (lanes -> ip [l] < ip) ip = lanes -> ip [l];
+        }
+
+        if (ip == lanes -> code_size) return OK;
+
+        int mask [LANES] = {};
+        for (int l = 0; l < LANES; l++) mask [l] = lanes -> active [l] && lanes -> ip [l] == ip;
+
+        cmd_t cmd = 0;
+        arg_t im  = 0;
+
+        int next = UnpackCmd (lanes -> code, lanes -> code_size, ip, &cmd, &im);
+        if (next < 0)
+        {
+            for (int l = 0; l < LANES; l++) if (mask [l]) Lane_fail (lanes, l, WRONG_CODESIZE);
+            continue;
+        }
+
+        switch (cmd & CMD_MASK)
+        {
+            case CMD_HLT:
+                for (int l = 0; l < LANES; l++) lanes -> active [l] &= !mask [l];
+                break;
+
+            case CMD_PUSH:
+            {
+                arg_t arg [LANES] = {};
+
+                Lanes_get_args (lanes, mask, cmd, im, arg);
+
+                int depth = 0;
+                if (Lanes_uniform_depth (lanes, mask, 0, &depth) && depth < LANES_STACK_SIZE)
+                {
+                    arg_t *row = lanes -> stk [depth];
+
+                    for (int l = 0; l < LANES; l++)
+                    {
+                        row [l] = mask [l] ? arg [l] : row [l];
+                        lanes -> sp [l] += mask [l];
+                        lanes -> ip [l]  = mask [l] ? next : lanes -> ip [l];
+                    }
+                    break;
+                }
+
+                for (int l = 0; l < LANES; l++)
+                {
+                    if (!mask [l]) continue;
+
+                    if (lanes -> sp [l] >= LANES_STACK_SIZE)
+                    {
+                        Lane_fail (lanes, l, LANES_FALLBACK);
+                        continue;
+                    }
+
+                    lanes -> stk [lanes -> sp [l]++][l] = arg [l];
+                    lanes -> ip [l] = next;
+                }
+                break;
+            }
+
+            case CMD_POP:
+                Lanes_pop_to (lanes, mask, cmd, im, next);
+                break;
+
+            case CMD_IN:
+                for (int l = 0; l < LANES; l++)
+                {
+                    if (!mask [l]) continue;
+
+                    if (lanes -> sp [l] >= LANES_STACK_SIZE)
+                    {
+                        Lane_fail (lanes, l, LANES_FALLBACK);
+                        continue;
+                    }
+
+                    arg_t val = 0;
+                    Lane_scan (lanes, l, &val);
+
+                    lanes -> stk [lanes -> sp [l]++][l] = val * coef;
+                    lanes -> ip [l] = next;
+                }
+                break;
+
+            case CMD_OUT:
+                for (int l = 0; l < LANES; l++)
+                {
+                    if (!mask [l]) continue;
+
+                    if (lanes -> sp [l] < 1)
+                    {
+                        Lane_fail (lanes, l, EMPTY_STACK);
+                        continue;
+                    }
+
+                    if (Lane_print (lanes, l, lanes -> stk [--(lanes -> sp [l])][l]))
+                    {
+                        Lane_fail (lanes, l, ALLOC_ERROR);
+                        continue;
+                    }
+
+                    lanes -> ip [l] = next;
+                }
+                break;
+
+            case CMD_ADD:
+                LANES_ARITHM (x1 + x2)
+                break;
+
+            case CMD_SUB:
+                LANES_ARITHM (x2 - x1)
+                break;
+
+            case CMD_MUL:
+                LANES_ARITHM (x1 * x2 / coef)
+                break;
+
+            case CMD_DIV:
+                LANES_BINARY (x1 == 0, DIV_BY_ZERO, x2 * coef / x1)
+                break;
+
+            case CMD_POW:
+                LANES_BINARY (0, OK, FixPow (x2, x1, coef))
+                break;
+
+            case CMD_SQRT:
+                LANES_UNARY (x < 0, SQRT_OF_NEG, FixSqrt (x, coef))
+                break;
+
+            case CMD_SIN:
+                LANES_UNARY (0, OK, FixSin (x, coef))
+                break;
+
+            case CMD_JMP:
+            case CMD_JMON:
+            {
+                int cond [LANES] = {};
+                int taken = (cmd & CMD_MASK) == CMD_JMP || MondayToday ();
+
+                for (int l = 0; l < LANES; l++) cond [l] = taken;
+
+                Lanes_jump (lanes, mask, cmd, im, next, cond, 1);
+                break;
+            }
+
+            case CMD_JA:
+                LANES_JMP (>)
+                break;
+
+            case CMD_JAE:
+                LANES_JMP (>=)
+                break;
+
+            case CMD_JB:
+                LANES_JMP (<)
+                break;
+
+            case CMD_JBE:
+                LANES_JMP (<=)
+                break;
+
+            case CMD_JE:
+                LANES_JMP (==)
+                break;
+
+            case CMD_JNE:
+                LANES_JMP (!=)
+                break;
+
+            case CMD_CALL:
+            {
+                arg_t arg [LANES] = {};
+
+                Lanes_get_args (lanes, mask, cmd, im, arg);
+
+                for (int l = 0; l < LANES; l++)
+                {
+                    if (!mask [l]) continue;
+
+                    int target = Lanes_target (lanes, cmd, arg [l]);
+
+                    if (target < 0)
+                    {
+                        Lane_fail (lanes, l, INCORRECT_JMP_IP);
+                        continue;
+                    }
+
+                    if (lanes -> csp [l] >= LANES_CALL_STACK_SIZE)
+                    {
+                        Lane_fail (lanes, l, LANES_FALLBACK);
+                        continue;
+                    }
+
+                    lanes -> call [lanes -> csp [l]++][l] = next;
+                    lanes -> ip [l] = target;
+                }
+                break;
+            }
+
+            case CMD_RET:
+                for (int l = 0; l < LANES; l++)
+                {
+                    if (!mask [l]) continue;
+
+                    if (lanes -> csp [l] < 1)
+                    {
+                        Lane_fail (lanes, l, EMPTY_CALL_STACK);
+                        continue;
+                    }
+
+                    lanes -> ip [l] = lanes -> call [--(lanes -> csp [l])][l];
+                }
+                break;
+
+            case CMD_DUMP:                      // dumps are printed by the plain engine
+                for (int l = 0; l < LANES; l++) if (mask [l]) Lane_fail (lanes, l, LANES_FALLBACK);
+                break;
+
+            default:
+                for (int l = 0; l < LANES; l++) if (mask [l]) Lane_fail (lanes, l, UNKNOWN_CMD);
+                break;
+        }
+    }
+}
+
+static void Lane_fail (Lanes_t *lanes, int lane, int err)
+{
+    lanes -> active [lane] = 0;
+    lanes -> err    [lane] = err;
+}
+
+static int Lanes_uniform_depth (Lanes_t *lanes, const int *mask, int need, int *depth)
+{
+    int first = -1;
+
+    for (int l = 0; l < LANES; l++)
+    {
+        if (!mask [l]) continue;
+
+        if (first < 0) first = lanes -> sp [l];
+        else if (lanes -> sp [l] != first) return 0;
+    }
+
+    if (first < need) return 0;
+
+    *depth = first;
+    return 1;
+}
+
+// same decoding as GetArgs; the register and immediate are shared, registers and memory are per lane
+static void Lanes_get_args (Lanes_t *lanes, int *mask, cmd_t cmd, arg_t im, arg_t *arg)
+{
+    const int coef = lanes -> accuracy_coef;
+
+    int reg = cmd >> CMD_REG_SHIFT;
+
+    if ((cmd & ARG_REG) && (reg <= 0 || reg >= NUM_OF_REGS))
+    {
+        for (int l = 0; l < LANES; l++)
+            if (mask [l])
+            {
+                Lane_fail (lanes, l, INCORRECT_REG);
+                mask [l] = 0;
+            }
+
+        return;
+    }
+
+    for (int l = 0; l < LANES; l++)
+    {
+        if (!mask [l]) continue;
+
+        arg_t val = 0;
+
+        if (cmd & ARG_REG) val += lanes -> regs [reg][l];
+        if (cmd & ARG_IM ) val += im * coef;
+
+        if (cmd & ARG_MEM)
+        {
+            val = val / coef;
+            if (val < 0 || val >= RAM_SIZE)
+            {
+                Lane_fail (lanes, l, INCORRECT_RAM_ADRESS);
+                mask [l] = 0;
+                continue;
+            }
+            val = lanes -> ram [val][l];
+        }
+
+        arg [l] = val;
+    }
+}
+
+// same addressing as GetArgAdress
+static void Lanes_pop_to (Lanes_t *lanes, int *mask, cmd_t cmd, arg_t im, int next)
+{
+    const int coef = lanes -> accuracy_coef;
+
+    int reg = cmd >> CMD_REG_SHIFT;
+
+    int err = OK;
+    if ((cmd & ARG_IM) && !(cmd & ARG_MEM))            err = INCORRECT_ARG_TYPE;
+    if ((cmd & ARG_REG) && (reg <= 0 || reg >= NUM_OF_REGS)) err = INCORRECT_REG;
+    if (!(cmd & (ARG_REG | ARG_MEM)))                   err = LANES_FALLBACK;
+
+    for (int l = 0; l < LANES; l++)
+    {
+        if (!mask [l]) continue;
+
+        if (err)
+        {
+            Lane_fail (lanes, l, err);
+            continue;
+        }
+
+        arg_t *dest = nullptr;
+
+        if (cmd & ARG_MEM)
+        {
+            int addr = ((cmd & ARG_REG) ? lanes -> regs [reg][l] / coef : 0) + im;
+            if (addr < 0 || addr >= RAM_SIZE)
+            {
+                Lane_fail (lanes, l, INCORRECT_RAM_ADRESS);
+                continue;
+            }
+            dest = lanes -> ram [addr] + l;
+        }
+        else dest = lanes -> regs [reg] + l;
+
+        if (lanes -> sp [l] < 1)
+        {
+            Lane_fail (lanes, l, EMPTY_STACK);
+            continue;
+        }
+
+        *dest = lanes -> stk [--(lanes -> sp [l])][l];
+        lanes -> ip [l] = next;
+    }
+}
+
+// lanes with cond go to the argument, the others to next; JMP and JMON (check_all) check the argument
+// even when they do not jump
+static void Lanes_jump (Lanes_t *lanes, int *mask, cmd_t cmd, arg_t im, int next, const int *cond, int check_all)
+{
+    int taken_mask [LANES] = {};
+    for (int l = 0; l < LANES; l++) taken_mask [l] = mask [l] && (cond [l] || check_all);
+
+    arg_t arg [LANES] = {};
+
+    Lanes_get_args (lanes, taken_mask, cmd, im, arg);
+
+    for (int l = 0; l < LANES; l++)
+    {
+        if (!mask [l] || !lanes -> active [l]) continue;
+
+        int target = taken_mask [l] ? Lanes_target (lanes, cmd, arg [l]) : next;
+
+        if (target < 0)
+        {
+            Lane_fail (lanes, l, INCORRECT_JMP_IP);
+            continue;
+        }
+
+        lanes -> ip [l] = cond [l] ? target : next;
+    }
+}
+
+// the byte ip a jump goes to, as GetJumpIp finds it; -1 if there is none
+static int Lanes_target (const Lanes_t *lanes, cmd_t cmd, arg_t arg)
+{
+    int ip = arg / lanes -> accuracy_coef;
+
+    if (!Is_const_jump (cmd))
+    {
+        if (lanes -> word_ips == nullptr || ip < 0 || ip >= lanes -> word_ips_num) return -1;
+        ip = lanes -> word_ips [ip];
+    }
+
+    return ip >= 0 && ip < lanes -> code_size ? ip : -1;
+}
@@ -0,0 +1,148 @@
+#include "proc.h"
+
+
+struct Proc_t
+{
+    Cpu_t cpu;
+};
+
+
+// without a writer the output would pile up in the capture buffer
+static int Proc_drop (void *ctx, const char *buf, size_t len)
+{
+    (void) ctx;
+    (void) buf;
+    (void) len;
+
+    return 0;
+}
+
+Proc_t *ProcCreate (void)
+{
+    Proc_t *proc = (Proc_t *) calloc (1, sizeof (Proc_t));
+    if (proc == nullptr) return nullptr;
+
+    if (CpuCtor (&(proc -> cpu)))
+    {
+        FreeCpu (&(proc -> cpu));
+        free (proc);
+        return nullptr;
+    }
+
+    // nothing goes to the standard streams until the host asks for it
+    Proc_io_t io = {};
+    ProcSetIo (proc, &io);
+
+    return proc;
+}
+
+void ProcDestroy (Proc_t *proc)
+{
+    if (proc == nullptr) return;
+
+    FreeCpu (&(proc -> cpu));
+    free (proc);
+}
+
+// image is a whole code file in memory, it is copied
+int ProcLoad (Proc_t *proc, const void *image, size_t size)
+{
+    if (proc == nullptr || image == nullptr) return NULLPTR_ARG;
+
+    if (size < INFO_SIZE || size % CMD_SIZE) return WRONG_CODESIZE;
+
+    int err = LoadCode (&(proc -> cpu), (const cmd_t *) image, size / CMD_SIZE);
+    if (err) return err;
+
+    return InfoCheck (&(proc -> cpu));
+}
+
+int ProcLoadFile (Proc_t *proc, const char *file_name)
+{
+    if (proc == nullptr || file_name == nullptr) return NULLPTR_ARG;
+
+    int err = ReadCode (file_name, &(proc -> cpu));
+    if (err) return err;
+
+    return InfoCheck (&(proc -> cpu));
+}
+
+// the verified image is kept in cache_dir, keyed by the file contents
+int ProcLoadCached (Proc_t *proc, const char *file_name, const char *cache_dir)
+{
+    if (proc == nullptr || file_name == nullptr || cache_dir == nullptr) return NULLPTR_ARG;
+
+    int err = ReadCodeCached (file_name, &(proc -> cpu), cache_dir);
+    if (err) return err;
+
+    return InfoCheck (&(proc -> cpu));
+}
+
+void ProcSetIo (Proc_t *proc, const Proc_io_t *io)
+{
+    if (proc == nullptr || io == nullptr) return;
+
+    Cpu_t *cpu = &(proc -> cpu);
+
+    FlushOut (cpu);
+
+    cpu -> read_cb   = io -> read;
+    cpu -> write_cb  = io -> write ? io -> write : Proc_drop;
+    cpu -> io_ctx    = io -> ctx;
+    cpu -> dump_file = io -> dump;
+
+    cpu ->  in_file = nullptr;
+    cpu -> out_file = nullptr;
+}
+
+int ProcRun (Proc_t *proc)
+{
+    if (proc == nullptr) return NULLPTR_ARG;
+
+    int err = RunCode (&(proc -> cpu));
+    int flush_err = FlushOut (&(proc -> cpu));
+
+    CpuTrim (&(proc -> cpu));
+
+    return err ? err : flush_err;
+}
+
+// RUN_YIELD when the budget is over, call again to go on
+int ProcRunSlice (Proc_t *proc, long long budget)
+{
+    if (proc == nullptr) return NULLPTR_ARG;
+
+    int err = RunCodeSlice (&(proc -> cpu), budget);
+    int flush_err = FlushOut (&(proc -> cpu));
+
+    if (err != RUN_YIELD && err != RUN_BLOCKED) CpuTrim (&(proc -> cpu));
+
+    return err ? err : flush_err;
+}
+
+int ProcReset (Proc_t *proc)
+{
+    if (proc == nullptr) return NULLPTR_ARG;
+
+    return CpuReset (&(proc -> cpu));
+}
+
+// source line of the last executed instruction, 0 without line info
+int ProcSourceLine (const Proc_t *proc)
+{
+    if (proc == nullptr) return 0;
+
+    return GetSourceLine (&(proc -> cpu), proc -> cpu.ip - 1);
+}
+
+const char *ProcErrText (int err)
+{
+    return CpuErrText (err);
+}
+
+void ProcPrintErr (Proc_t *proc, int err, FILE *stream)
+{
+    if (stream == nullptr) return;
+
+    CpuErr (proc ? &(proc -> cpu) : nullptr, err, stream);
+}
@@ -0,0 +1,50 @@
+#ifndef LIBPROC_H
+#define LIBPROC_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+// libproc: the VM as a library. Every Proc_t is independent, so a host may run many of them
+// at once, one per thread. Functions return the ERRORS codes of proc.h, OK is 0.
+
+typedef long (*Proc_read_t)  (void *ctx,       char *buf, size_t len);  // bytes read, 0 - end of input
+typedef int  (*Proc_write_t) (void *ctx, const char *buf, size_t len);  // 0 - everything is written
+
+struct Proc_io_t
+{
+    Proc_read_t  read;                          // nullptr - IN gets end of input
+    Proc_write_t write;                         // nullptr - OUT is dropped
+    void *ctx;                                  // passed to both
+
+    FILE *dump;                                 // where DUMP prints, nullptr - nowhere
+};
+
+struct Proc_t;
+
+
+Proc_t *ProcCreate (void);
+
+void ProcDestroy (Proc_t *proc);
+
+int ProcLoad (Proc_t *proc, const void *image, size_t size);
+
+int ProcLoadFile (Proc_t *proc, const char *file_name);
+
+int ProcLoadCached (Proc_t *proc, const char *file_name, const char *cache_dir);
+
+void ProcSetIo (Proc_t *proc, const Proc_io_t *io);
+
+int ProcRun (Proc_t *proc);
+
+int ProcRunSlice (Proc_t *proc, long long budget);
+
+int ProcReset (Proc_t *proc);
+
+int ProcSourceLine (const Proc_t *proc);
+
+const char *ProcErrText (int err);
+
+void ProcPrintErr (Proc_t *proc, int err, FILE *stream);
+
+#endif
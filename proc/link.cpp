@@ -0,0 +1,340 @@
+#include "proc.h"
+
+
+//---------------------------------------------------------------------------------------------------------------------
+
+int ReadObj (const char *input_file_name, Obj_t *obj)
+{
+    if (input_file_name == nullptr || obj == nullptr) return NULLPTR_ARG;
+
+    FILE *inp_file = OpenStream (input_file_name, "rb");
+    if (inp_file == nullptr) return FOPEN_ERROR;
+
+    size_t filesize = 0;
+    char *data = ReadStream (inp_file, 0, &filesize);
+
+    CloseStream (inp_file);
+
+    if (data == nullptr) return ALLOC_ERROR;
+
+    const char *cur  = data;
+    size_t      left = filesize;
+
+    cmd_t header [OBJ_HEADER_SIZE] = {};
+
+    int err = Read_section (&cur, &left, header, OBJ_HEADER_SIZE, CMD_SIZE);
+
+    if (err == OK && header [0] != OBJ_SIGNATURE) err = WRONG_SIGNATURE;
+    if (err == OK && (header [1] < CODE_SHIFT || header [2] < 0 || header [3] < 0 || header [4] < 0 || header [5] < 0))
+        err = WRONG_CODESIZE;
+
+    if (err == OK)
+    {
+        obj -> globals = header [2];
+
+        // a spare zeroed word after the image, as Compile leaves, so GetImageSize can look past the code
+        obj -> image        = (cmd_t *)   calloc ((size_t) header [1] + 1, CMD_SIZE);
+        obj -> exports.list = (Label_t *) calloc ((size_t) header [3] + 1, sizeof (Label_t));
+        obj -> imports.list = (Label_t *) calloc ((size_t) header [4] + 1, sizeof (Label_t));
+        obj -> relocs.list  = (Reloc_t *) calloc ((size_t) header [5] + 1, sizeof (Reloc_t));
+
+        obj -> exports.num = obj -> exports.max_num = (size_t) header [3];
+        obj -> imports.num = obj -> imports.max_num = (size_t) header [4];
+        obj -> relocs.num  = obj -> relocs.max_num  = (size_t) header [5];
+
+        if (obj -> image == nullptr || obj -> exports.list == nullptr || obj -> imports.list == nullptr || obj -> relocs.list == nullptr)
+            err = ALLOC_ERROR;
+    }
+
+    if (err == OK) err = Read_section (&cur, &left, obj -> image,        (size_t) header [1], CMD_SIZE);
+    if (err == OK) err = Read_section (&cur, &left, obj -> exports.list, obj -> exports.num,  sizeof (Label_t));
+    if (err == OK) err = Read_section (&cur, &left, obj -> imports.list, obj -> imports.num,  sizeof (Label_t));
+    if (err == OK) err = Read_section (&cur, &left, obj -> relocs.list,  obj -> relocs.num,   sizeof (Reloc_t));
+
+    free (data);
+
+    if (err) return err;
+
+    cmd_t *code = obj -> image + CODE_SHIFT;
+
+    if (code [SIGNATURE_POS] != SIGNATURE) return WRONG_SIGNATURE;
+    if (code [  VERSION_POS] != VERSION)   return WRONG_VERSION;
+
+    // the code and the line table behind it must lie in the image before GetImageSize walks them
+    size_t image_size = (size_t) header [1];
+
+    int code_size = code [CODESIZE_POS];
+    if (code_size < 0 || (size_t) code_size > image_size - CODE_SHIFT) return WRONG_CODESIZE;
+
+    size_t tail_size = image_size - CODE_SHIFT - (size_t) code_size;
+    if (tail_size >= (size_t) LINES_HEADER_SIZE && code [code_size] == LINES_SIGNATURE)
+    {
+        cmd_t lines_num = code [code_size + 1];
+        if (lines_num < 0 || (size_t) lines_num > (tail_size - LINES_HEADER_SIZE) * CMD_SIZE / sizeof (Line_t)) return WRONG_CODESIZE;
+    }
+
+    if (GetImageSize (obj -> image) > image_size) return WRONG_CODESIZE;
+
+    for (size_t index = 0; index < obj -> exports.num; index++)
+    {
+        (obj -> exports.list [index]).name [MAX_LABEL_LEN] = '\0';
+        if ((obj -> exports.list [index]).ip < 0 || (obj -> exports.list [index]).ip >= code_size) return WRONG_CODESIZE;
+        if ((obj -> exports.list [index]).args < ARGS_UNKNOWN) return COMP_ERROR;
+    }
+
+    for (size_t index = 0; index < obj -> imports.num; index++)
+    {
+        (obj -> imports.list [index]).name [MAX_LABEL_LEN] = '\0';
+        if ((obj -> imports.list [index]).args < ARGS_UNKNOWN) return COMP_ERROR;
+    }
+
+    for (size_t index = 0; index < obj -> relocs.num; index++)
+    {
+        Reloc_t *reloc = obj -> relocs.list + index;
+
+        if (reloc -> pos < 0 || reloc -> pos >= code_size) return WRONG_CODESIZE;
+
+        if (reloc -> kind != RELOC_CODE && reloc -> kind != RELOC_GLOBAL && reloc -> kind != RELOC_SYMBOL) return COMP_ERROR;
+
+        if (reloc -> kind == RELOC_SYMBOL && (reloc -> sym < 0 || (size_t) reloc -> sym >= obj -> imports.num)) return COMP_ERROR;
+    }
+
+    return OK;
+}
+
+int Read_section (const char **data_p, size_t *left_p, void *dest, size_t num, size_t size)
+{
+    if (num * size > *left_p) return WRONG_CODESIZE;
+
+    memcpy (dest, *data_p, num * size);
+
+    *data_p += num * size;
+    *left_p -= num * size;
+
+    return OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// units go one after another behind the start code, their globals likewise
+int Link (Obj_t *objs, size_t num, cmd_t **cmds_p)
+{
+    if (objs == nullptr || cmds_p == nullptr) return NULLPTR_ARG;
+    if (num == 0) return LINK_ERROR;
+
+    int code_size = 0;
+    int   globals = 0;
+    size_t lines_num = 0;
+
+    int err = Link_place (objs, num, &code_size, &globals, &lines_num);
+    if (err) return err;
+
+    for (size_t unit = 1; unit < num; unit++)
+    {
+        for (size_t index = 0; index < objs [unit].exports.num; index++)
+        {
+            const char *name = (objs [unit].exports.list [index]).name;
+            if (Link_find (objs, unit, name) < 0) continue;
+
+            fprintf (ERROR_STREAM, "Link error:\nsymbol (%s) is defined in more than one unit.\n", name);
+            return LINK_ERROR;
+        }
+    }
+
+    err = Link_check_args (objs, num);
+    if (err) return err;
+
+    int main_ip = Link_find (objs, num, MAIN_LABEL_NAME);
+    if (main_ip < 0)
+    {
+        fprintf (ERROR_STREAM, "Link error:\nno unit has a (%s).\n", MAIN_LABEL_NAME);
+        return LINK_ERROR;
+    }
+
+    size_t size = CODE_SHIFT + (size_t) code_size + LINES_HEADER_SIZE + lines_num * (sizeof (Line_t) / CMD_SIZE) + 1;
+
+    cmd_t *cmds = (cmd_t *) calloc (size, CMD_SIZE);
+    if (cmds == nullptr) return ALLOC_ERROR;
+
+    cmd_t *code = cmds + CODE_SHIFT;
+
+    code [SIGNATURE_POS] = SIGNATURE;
+    code [  VERSION_POS] = VERSION;
+    code [ CODESIZE_POS] = code_size;
+    code [ ACCURACY_POS] = objs [0].image [CODE_SHIFT + ACCURACY_POS];
+
+    Link_start (code, globals, main_ip);
+
+    Line_t *lines = (Line_t *) (code + code_size + LINES_HEADER_SIZE);
+    size_t  line  = 0;
+
+    for (size_t unit = 0; unit < num && err == OK; unit++)
+    {
+        const cmd_t *unit_code = objs [unit].image + CODE_SHIFT;
+        int          unit_size = unit_code [CODESIZE_POS];
+
+        memcpy (code + objs [unit].code_base, unit_code, (size_t) unit_size * CMD_SIZE);
+
+        err = Link_relocate (objs, num, unit, code);
+
+        if (unit_code [unit_size] != LINES_SIGNATURE) continue;
+
+        size_t unit_lines = (size_t) unit_code [unit_size + 1];
+        memcpy (lines + line, unit_code + unit_size + LINES_HEADER_SIZE, unit_lines * sizeof (Line_t));
+
+        for (; unit_lines > 0; unit_lines--, line++) lines [line].ip += objs [unit].code_base;
+    }
+
+    if (lines_num > 0)
+    {
+        code [code_size    ] = LINES_SIGNATURE;
+        code [code_size + 1] = (cmd_t) lines_num;
+    }
+
+    if (err == OK) PutStackDepth (code);
+
+    if (err)
+    {
+        free (cmds);
+        return err;
+    }
+
+    *cmds_p = cmds;
+
+    return OK;
+}
+
+int Link_place (Obj_t *objs, size_t num, int *code_size_p, int *globals_p, size_t *lines_num_p)
+{
+    int code_size = LINK_START_SIZE;
+    int   globals = 0;
+    size_t lines_num = 0;
+
+    int accuracy = objs [0].image [CODE_SHIFT + ACCURACY_POS];
+
+    for (size_t unit = 0; unit < num; unit++)
+    {
+        const cmd_t *unit_code = objs [unit].image + CODE_SHIFT;
+        int          unit_size = unit_code [CODESIZE_POS];
+
+        if (unit_code [ACCURACY_POS] != accuracy)
+        {
+            fprintf (ERROR_STREAM, "Link error:\nunits have different accuracy coefficients.\n");
+            return LINK_ERROR;
+        }
+
+        objs [unit].code_base    = code_size;
+        objs [unit].globals_base = globals;
+
+        code_size += unit_size;
+        globals   += objs [unit].globals;
+
+        if (unit_code [unit_size] == LINES_SIGNATURE) lines_num += (size_t) unit_code [unit_size + 1];
+    }
+
+    *code_size_p = code_size;
+    *globals_p   = globals;
+    *lines_num_p = lines_num;
+
+    return OK;
+}
+
+// placed ip of an exported label, -1 - no unit exports it
+int Link_find (Obj_t *objs, size_t num, const char *name)
+{
+    for (size_t unit = 0; unit < num; unit++)
+    {
+        Label_list_t *exports = &(objs [unit].exports);
+
+        for (size_t index = 0; index < exports -> num; index++)
+            if (strcmp ((exports -> list [index]).name, name) == 0) return objs [unit].code_base + (exports -> list [index]).ip;
+    }
+
+    return -1;
+}
+
+// a call with another number of arguments than the function takes would leave the stack shifted
+int Link_check_args (Obj_t *objs, size_t num)
+{
+    for (size_t unit = 0; unit < num; unit++)
+    {
+        Label_list_t *imports = &(objs [unit].imports);
+
+        for (size_t index = 0; index < imports -> num; index++)
+        {
+            const Label_t *import = imports -> list + index;
+            if (import -> args == ARGS_UNKNOWN) continue;
+
+            for (size_t def_unit = 0; def_unit < num; def_unit++)
+            {
+                Label_list_t *exports = &(objs [def_unit].exports);
+
+                for (size_t def = 0; def < exports -> num; def++)
+                {
+                    const Label_t *exp = exports -> list + def;
+                    if (exp -> args == ARGS_UNKNOWN || exp -> args == import -> args || strcmp (exp -> name, import -> name)) continue;
+
+                    fprintf (ERROR_STREAM, "Link error:\nsymbol (%s) takes %d arguments, but is imported with %d.\n",
+                                           import -> name, exp -> args, import -> args);
+                    return LINK_ERROR;
+                }
+            }
+        }
+    }
+
+    return OK;
+}
+
+int Link_relocate (Obj_t *objs, size_t num, size_t unit, cmd_t *code)
+{
+    Obj_t *obj = objs + unit;
+
+    for (size_t index = 0; index < obj -> relocs.num; index++)
+    {
+        Reloc_t *reloc = obj -> relocs.list + index;
+        cmd_t   *word  = code + obj -> code_base + reloc -> pos;
+
+        switch (reloc -> kind)
+        {
+            case RELOC_CODE:
+                *word += obj -> code_base;
+                break;
+
+            case RELOC_GLOBAL:
+                *word += obj -> globals_base;
+                break;
+
+            case RELOC_SYMBOL:
+            {
+                const char *name = (obj -> imports.list [reloc -> sym]).name;
+
+                int ip = Link_find (objs, num, name);
+                if (ip < 0)
+                {
+                    fprintf (ERROR_STREAM, "Link error:\nsymbol (%s) is not defined in any unit.\n", name);
+                    return LINK_ERROR;
+                }
+
+                *word += ip;
+                break;
+            }
+
+            default:
+                return LINK_ERROR;
+        }
+    }
+
+    return OK;
+}
+
+// the start code back writes for a whole program, with the globals of all units
+void Link_start (cmd_t *code, int globals, int main_ip)
+{
+    cmd_t start [LINK_START_SIZE] = {CMD_PUSH | ARG_IM,  0,
+                                     CMD_POP  | ARG_REG, RDX,
+                                     CMD_PUSH | ARG_IM,  globals,
+                                     CMD_POP  | ARG_REG, RCX,
+                                     CMD_JMP  | ARG_IM,  main_ip};
+
+    memcpy (code, start, sizeof (start));
+}
@@ -0,0 +1,53 @@
+#include "proc.h"
+
+
+thread_local FILE *ERROR_STREAM = stdout;
+
+
+// link.exe [-o code] unit.o ...
+int main (int argc, char *argv[])
+{
+    const char *output_file_name = LINK_FILE_NAME;
+
+    Obj_t *objs = (Obj_t *) calloc ((size_t) argc, sizeof (Obj_t));
+    if (objs == nullptr)
+    {
+        AsmErr (ALLOC_ERROR, ERROR_STREAM);
+        return ALLOC_ERROR;
+    }
+
+    for (int index = 1; index + 1 < argc; index++)
+        if (strcmp (argv [index], OUTPUT_OPTION) == 0) output_file_name = argv [index + 1];
+
+    // stdout carries the code, messages go aside
+    if (strcmp (output_file_name, STD_STREAM) == 0) ERROR_STREAM = stderr;
+
+    size_t num = 0;
+    int    err = OK;
+
+    for (int index = 1; index < argc && err == OK; index++)
+    {
+        if (strcmp (argv [index], OUTPUT_OPTION) == 0)
+        {
+            index++;
+            continue;
+        }
+
+        err = ReadObj (argv [index], objs + num++);
+        if (err) fprintf (ERROR_STREAM, "Cannot read unit (%s).\n", argv [index]);
+    }
+
+    cmd_t *commands = nullptr;
+
+    if (err == OK) err = Link (objs, num, &commands);
+    if (err == OK) err = WriteCmds (output_file_name, commands, nullptr);
+
+    if (err) AsmErr (err, ERROR_STREAM);
+
+    for (size_t index = 0; index < num; index++) ObjDtor (objs + index);
+
+    free (objs);
+    free (commands);
+
+    return err;
+}
@@ -0,0 +1,322 @@
+#include "proc.h"
+
+
+// a word image (header, code, line table) to a packed one; byte_ips_p, when not nullptr, gets the byte ip
+// of every word ip up to code_size, for the labels
+int PackImage (const cmd_t *image, size_t words, cmd_t **new_image_p, size_t *new_words_p, int **byte_ips_p)
+{
+    if (image == nullptr || new_image_p == nullptr || new_words_p == nullptr) return NULLPTR_ARG;
+    if (words < (size_t) CODE_SHIFT) return WRONG_CODESIZE;
+
+    const cmd_t *code = image + CODE_SHIFT;
+
+    int code_size = code [CODESIZE_POS];
+    if (code_size < 0 || (size_t) code_size > words - CODE_SHIFT) return WRONG_CODESIZE;
+
+    const cmd_t *tail = code + code_size;
+    size_t  tail_size = words - CODE_SHIFT - (size_t) code_size;
+    size_t  lines_num = 0;
+
+    if (tail_size >= (size_t) LINES_HEADER_SIZE && tail [0] == LINES_SIGNATURE)
+    {
+        if (tail [1] < 0 || (size_t) tail [1] > (tail_size - LINES_HEADER_SIZE) * CMD_SIZE / sizeof (Line_t)) return WRONG_CODESIZE;
+        lines_num = (size_t) tail [1];
+    }
+
+    int           *byte_ips = (int *)           calloc ((size_t) code_size + 1, sizeof (int));
+    unsigned char *im_lens  = (unsigned char *) calloc ((size_t) code_size + 1, sizeof (char));
+
+    int err = byte_ips && im_lens ? OK : ALLOC_ERROR;
+
+    int word_jumps = 0;
+    if (err == OK) err = Pack_layout (code, code_size, byte_ips, im_lens, &word_jumps);
+
+    int    len       = err ? 0 : byte_ips [code_size];
+    size_t new_words = CODE_SHIFT + Code_words (len) + (lines_num ? LINES_HEADER_SIZE + lines_num * (sizeof (Line_t) / CMD_SIZE) : 0);
+
+    cmd_t *new_image = err ? nullptr : (cmd_t *) calloc (new_words, CMD_SIZE);
+    if (err == OK && new_image == nullptr) err = ALLOC_ERROR;
+
+    if (err == OK)
+    {
+        cmd_t *new_code = new_image + CODE_SHIFT;
+
+        memcpy (new_image, image, INFO_SIZE);
+        new_code [CODESIZE_POS] = len;
+        new_code [   FLAGS_POS] |= FLAG_COMPACT | (word_jumps ? FLAG_WORD_JUMPS : 0);
+
+        Pack_emit (code, code_size, byte_ips, im_lens, (unsigned char *) new_code);
+
+        if (lines_num)
+        {
+            cmd_t *new_tail = new_code + Code_words (len);
+
+            new_tail [0] = LINES_SIGNATURE;
+            new_tail [1] = (cmd_t) lines_num;
+
+            const Line_t *lines     = (const Line_t *) (tail     + LINES_HEADER_SIZE);
+                  Line_t *new_lines = (Line_t *)       (new_tail + LINES_HEADER_SIZE);
+
+            for (size_t index = 0; index < lines_num; index++)
+            {
+                int ip = lines [index].ip;
+
+                new_lines [index].ip   = ip >= 0 && ip <= code_size ? byte_ips [ip] : len;
+                new_lines [index].line = lines [index].line;
+            }
+        }
+
+        *new_image_p = new_image;
+        *new_words_p = new_words;
+    }
+
+    free (im_lens);
+
+    if (err == OK && byte_ips_p) *byte_ips_p = byte_ips;
+    else                         free (byte_ips);
+
+    return err;
+}
+
+// the byte ip of every word ip, the words of the arguments get the ip of their command. A constant jump takes
+// as many bytes as the ip of its target, and the ips depend on those lengths, so the lengths only grow
+// until no jump needs more
+int Pack_layout (const cmd_t *code, int code_size, int *byte_ips, unsigned char *im_lens, int *word_jumps_p)
+{
+    int next   = 0;
+    int target = 0;
+
+    // byte_ips marks the commands first, a constant jump has to land on one
+    for (int ip = 0; ip < code_size; ip = next)
+    {
+        int err = Pack_cmd (code, code_size, ip, &next, &target);
+        if (err) return err;
+
+        byte_ips [ip] = 1;
+
+        if (code [ip] & ARG_IM) im_lens [ip] = target < 0 ? (unsigned char) Varint_len (code [next - 1]) : 1;
+
+        int op = code [ip] & CMD_MASK;
+        if (((op >= CMD_JMP && op <= CMD_CALL) || op == CMD_JMON) && target < 0) *word_jumps_p = 1;
+    }
+
+    for (int ip = 0; ip < code_size; ip = next)
+    {
+        Pack_cmd (code, code_size, ip, &next, &target);
+        if (target >= 0 && !byte_ips [target]) return INCORRECT_JMP_IP;
+    }
+
+    int changed = 1;
+
+    while (changed)
+    {
+        int pos = 0;
+
+        for (int ip = 0; ip < code_size; ip = next)
+        {
+            cmd_t cmd = code [ip];
+            next = ip + 1 + !!(cmd & ARG_REG) + !!(cmd & ARG_IM);
+
+            for (int word = ip; word < next; word++) byte_ips [word] = pos;
+
+            pos += 1 + !!(cmd & (ARG_IM | ARG_REG | ARG_MEM)) + im_lens [ip];
+        }
+
+        byte_ips [code_size] = pos;
+
+        changed = 0;
+
+        for (int ip = 0; ip < code_size; ip = next)
+        {
+            cmd_t cmd = code [ip];
+            next = ip + 1 + !!(cmd & ARG_REG) + !!(cmd & ARG_IM);
+
+            if (!Is_const_jump (cmd)) continue;
+
+            unsigned char need = (unsigned char) Varint_len (byte_ips [code [ip + 1]]);
+            if (need <= im_lens [ip]) continue;
+
+            im_lens [ip] = need;
+            changed = 1;
+        }
+    }
+
+    return OK;
+}
+
+// checks a word command; target_p gets the word ip a constant jump goes to, -1 for the others
+int Pack_cmd (const cmd_t *code, int code_size, int ip, int *next_p, int *target_p)
+{
+    cmd_t cmd  = code [ip];
+    int   args = Cmd_args_num (cmd & CMD_MASK);
+
+    *next_p   = ip + 1 + !!(cmd & ARG_REG) + !!(cmd & ARG_IM);
+    *target_p = -1;
+
+    if (args < 0 || (cmd & ~(CMD_MASK | ARG_IM | ARG_REG | ARG_MEM))) return UNKNOWN_CMD;
+    if (args == 0 && (cmd & ~CMD_MASK))                               return INCORRECT_ARG_TYPE;
+    if (*next_p > code_size)                                          return WRONG_CODESIZE;
+
+    if ((cmd & ARG_REG) && (code [ip + 1] < 0 || code [ip + 1] > COMPACT_MAX_REG)) return INCORRECT_REG;
+
+    if (Is_const_jump (cmd))
+    {
+        *target_p = code [ip + 1];
+        if (*target_p < 0 || *target_p >= code_size) return INCORRECT_JMP_IP;
+    }
+
+    return OK;
+}
+
+void Pack_emit (const cmd_t *code, int code_size, const int *byte_ips, const unsigned char *im_lens, unsigned char *bytes)
+{
+    int ip = 0;
+
+    while (ip < code_size)
+    {
+        cmd_t cmd   = code [ip];
+        int   flags = (cmd >> ARG_SHIFT) & ARG_FLAGS_MASK;
+        int   pos   = ip + 1;
+
+        unsigned char *out = bytes + byte_ips [ip];
+
+        *(out++) = (unsigned char) ((cmd & CMD_MASK) | (flags ? COMPACT_MODE_BIT : 0));
+
+        if (flags)
+        {
+            int reg = (cmd & ARG_REG) ? code [pos++] : 0;
+            *(out++) = (unsigned char) (flags | reg << COMPACT_REG_SHIFT);
+        }
+
+        if (cmd & ARG_IM)
+        {
+            int val = Is_const_jump (cmd) ? byte_ips [code [pos]] : code [pos];
+            Put_varint (out, val, im_lens [ip]);
+            pos++;
+        }
+
+        ip = pos;
+    }
+}
+
+int Is_packed_image (const cmd_t *image, size_t words)
+{
+    return words >= (size_t) CODE_SHIFT && image [0] == SIGNATURE && image [1] == VERSION &&
+           (image [CODE_SHIFT + FLAGS_POS] & FLAG_COMPACT);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// the packed command at ip as the cpu fetches it (opcode, ARG_ flags, register at CMD_REG_SHIFT), its immediate
+// goes to im_p; returns the ip after it, -1 if code_size cuts it or the mode byte is not one the packer writes
+int UnpackCmd (const unsigned char *code, int code_size, int ip, cmd_t *cmd_p, arg_t *im_p)
+{
+    if (ip < 0 || ip >= code_size) return -1;
+
+    cmd_t cmd = code [ip] & ~COMPACT_MODE_BIT;
+    arg_t im  = 0;
+
+    if (code [ip++] & COMPACT_MODE_BIT)
+    {
+        if (ip >= code_size) return -1;
+
+        int mode  = code [ip++];
+        int flags = mode & ARG_FLAGS_MASK;
+
+        if (flags == 0 || (!((flags << ARG_SHIFT) & ARG_REG) && (mode >> COMPACT_REG_SHIFT))) return -1;
+
+        cmd |= flags << ARG_SHIFT | (mode >> COMPACT_REG_SHIFT) << CMD_REG_SHIFT;
+
+        if (cmd & ARG_IM)
+        {
+            size_t pos = (size_t) ip;
+            if (Get_varint (code, (size_t) code_size, &pos, &im)) return -1;
+
+            ip = (int) pos;
+        }
+    }
+
+    *cmd_p = cmd;
+    if (im_p) *im_p = im;
+
+    return ip;
+}
+
+// a jump whose argument is a lone immediate, the packer gives it the byte ip of the target
+int Is_const_jump (cmd_t cmd)
+{
+    int op = cmd & CMD_MASK;
+
+    return ((op >= CMD_JMP && op <= CMD_CALL) || op == CMD_JMON) && (cmd & (ARG_IM | ARG_REG | ARG_MEM)) == ARG_IM;
+}
+
+int Cmd_args_num (int op)
+{
+#define DEF_CMD(name, num, arg, ...)  \
+    case CMD_##name: return arg;
+
+    switch (op)
+    {
+        #include "cmd.h"
+
+        default: return -1;
+    }
+
+#undef DEF_CMD
+}
+
+size_t Code_words (int code_size)
+{
+    return ((size_t) code_size + CMD_SIZE - 1) / CMD_SIZE;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+size_t Varint_len (int val)
+{
+    unsigned zigzag = ((unsigned) val << 1) ^ (unsigned) (val >> 31);
+    size_t len = 1;
+
+    for (; zigzag >= 0x80; zigzag >>= 7) len++;
+
+    return len;
+}
+
+// zigzag, so small negative numbers are short too; 7 bits a byte, the high bit says more follow.
+// Bytes past the value carry nothing, so a jump keeps the length the layout gave it
+size_t Put_varint (unsigned char *bytes, int val, size_t len)
+{
+    unsigned zigzag = ((unsigned) val << 1) ^ (unsigned) (val >> 31);
+    size_t pos = 0;
+
+    for (; pos + 1 < len; pos++)
+    {
+        bytes [pos] = (unsigned char) (zigzag | 0x80);
+        zigzag >>= 7;
+    }
+
+    bytes [pos++] = (unsigned char) zigzag;
+
+    return pos;
+}
+
+int Get_varint (const unsigned char *bytes, size_t len, size_t *pos_p, int *val_p)
+{
+    unsigned zigzag = 0;
+    int shift = 0;
+
+    while (1)
+    {
+        if (*pos_p >= len || shift >= MAX_VARINT_LEN * 7) return WRONG_CODESIZE;
+
+        unsigned char byte = bytes [(*pos_p)++];
+        zigzag |= (unsigned) (byte & 0x7F) << shift;
+        shift += 7;
+
+        if (!(byte & 0x80)) break;
+    }
+
+    *val_p = (int) (zigzag >> 1) ^ -(int) (zigzag & 1);
+
+    return OK;
+}
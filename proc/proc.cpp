@@ -1,88 +1,361 @@
 #include "proc.h"
 
 
-#define Ret_if_err(func)                    \
-    err = func;                             \
-    if (err)                                \
-    {                                       \
-        CpuErr (&cpu, err, ERROR_STREAM);   \
-        return err;                         \
-    }
+int CpuCtor (Cpu_t *cpu)
+{
+    if (cpu == nullptr) return NULLPTR_ARG;
 
+    StackCtor (&(cpu -> call_stk), CALL_STACK_BASE_CAPACITY);
+    StackCtor (&(cpu ->      stk),      STACK_BASE_CAPACITY);
 
-int main (int argc, char *argv[])
-{    
-    const char *input_file_name = nullptr;
+    memset (cpu -> regs, 0, sizeof (cpu -> regs [0]) * NUM_OF_REGS);
+    memset (cpu -> ram , 0, sizeof (cpu -> ram  [0]) * RAM_SIZE);
+    
+    cpu -> ip = 0;
+    cpu -> accuracy_coef = 1;
 
-    if (argc >= 2)  input_file_name = argv [1];
-    else            input_file_name = "a";
+    cpu -> code_size = 0;
+    cpu -> header = nullptr;
+    cpu -> code   = nullptr;
+    cpu -> map    = {};
+
+    cpu -> word_ips     = nullptr;
+    cpu -> word_ips_num = 0;
 
-    struct Cpu_t cpu = {};
-    int err = OK;
+    cpu -> lines     = nullptr;
+    cpu -> lines_num = 0;
 
-    Ret_if_err (CpuCtor (&cpu));
+    cpu ->   in_file = stdin;
+    cpu ->  out_file = stdout;
+    cpu -> dump_file = stdout;
 
-    Ret_if_err (ReadCode (input_file_name, &cpu));
+    cpu -> read_cb  = nullptr;
+    cpu -> write_cb = nullptr;
+    cpu -> io_ctx   = nullptr;
 
-    Ret_if_err (InfoCheck (&cpu));
+    cpu -> out_buf = (char *) calloc (OUT_BUF_SIZE, sizeof (char));
+    cpu ->  in_buf = (char *) calloc ( IN_BUF_SIZE, sizeof (char));
+    if (cpu -> out_buf == nullptr || cpu -> in_buf == nullptr) return ALLOC_ERROR;
 
-    Ret_if_err (RunCode (&cpu));
+    cpu -> out_len = 0;
+    cpu ->  in_pos = 0;
+    cpu ->  in_len = 0;
+    cpu ->  in_eof = 0;
+    cpu -> in_wait = 0;
 
-    FreeCpu (&cpu);
+    cpu -> capture         = nullptr;
+    cpu -> capture_len     = 0;
+    cpu -> capture_max_len = 0;
 
     return OK;
 }
 
-
-int CpuCtor (Cpu_t *cpu)
+int CpuReset (Cpu_t *cpu)
 {
     if (cpu == nullptr) return NULLPTR_ARG;
 
-    StackCtor (&(cpu -> call_stk), CALL_STACK_BASE_CAPACITY);
-    StackCtor (&(cpu ->      stk),      STACK_BASE_CAPACITY);
+    arg_t val = 0;
+    while (cpu ->      stk.size) StackPop (&(cpu ->      stk), &val);
+    while (cpu -> call_stk.size) StackPop (&(cpu -> call_stk), &val);
 
     memset (cpu -> regs, 0, sizeof (cpu -> regs [0]) * NUM_OF_REGS);
     memset (cpu -> ram , 0, sizeof (cpu -> ram  [0]) * RAM_SIZE);
-    
+
     cpu -> ip = 0;
-    cpu -> accuracy_coef = 1;
 
-    cpu -> code_size = 0;
-    cpu -> code = nullptr;
+    cpu -> out_len = 0;
+    cpu ->  in_pos = 0;
+    cpu ->  in_len = 0;
+    cpu ->  in_eof = 0;
 
     return OK;
 }
 
+// after a run: memory a deep phase grew the stacks to goes back, the reserved depth stays;
+// a shrink that fails keeps the old buffer
+void CpuTrim (Cpu_t *cpu)
+{
+    if (cpu == nullptr) return;
+
+    StackTrim (&(cpu ->      stk));
+    StackTrim (&(cpu -> call_stk));
+}
+
 
 int ReadCode (const char *input_file_name, Cpu_t *cpu)
 {
     if (input_file_name == nullptr) return NULLPTR_ARG;
     if             (cpu == nullptr) return NULLPTR_ARG;
 
-    FILE *inp_file = fopen (input_file_name, "rb");
+    // the file is mapped read-only, stdin, tiny files and systems without mapping get a copy
+    Map_t map = {};
+    if (strcmp (input_file_name, STD_STREAM) == 0 || MapFile (input_file_name, &map) != OK || map.size < INFO_SIZE)
+    {
+        UnmapFile (&map);
+        return Read_code_copy (input_file_name, cpu);
+    }
+
+    return Set_mapped_code (cpu, &map, 0);
+}
+
+int Read_code_copy (const char *input_file_name, Cpu_t *cpu)
+{
+    FILE *inp_file = OpenStream (input_file_name, "rb");
     if (inp_file == nullptr) return FOPEN_ERROR;
 
-    size_t filesize = GetSize (inp_file);
-    cpu -> code_size = filesize / CMD_SIZE - CODE_SHIFT;
+    size_t filesize = 0;
+    cmd_t *image = (cmd_t *) ReadStream (inp_file, 0, &filesize);
 
-    cpu -> code = (cmd_t *) calloc (1, filesize);
-    if (cpu -> code == nullptr) return ALLOC_ERROR;
-    
-    fread (cpu -> code, 1, filesize, inp_file);
-    cpu -> code += CODE_SHIFT;
+    CloseStream (inp_file);
+
+    if (image == nullptr) return ALLOC_ERROR;
+
+    // the buffer is at least STREAM_CHUNK zeroed bytes, a short file reads as an empty header
+    size_t words = filesize / CMD_SIZE;
+    if (words < (size_t) CODE_SHIFT) words = CODE_SHIFT;
+
+    return Set_code (cpu, image, words);
+}
+
+int LoadCode (Cpu_t *cpu, const cmd_t *image, size_t words)
+{
+    if (cpu == nullptr || image == nullptr) return NULLPTR_ARG;
 
-    fclose (inp_file);
+    cmd_t *copy = (cmd_t *) calloc (words > (size_t) CODE_SHIFT ? words : CODE_SHIFT, CMD_SIZE);
+    if (copy == nullptr) return ALLOC_ERROR;
+
+    memcpy (copy, image, words * CMD_SIZE);
+
+    return Set_code (cpu, copy, words > (size_t) CODE_SHIFT ? words : CODE_SHIFT);
+}
+
+// cpu owns image from now on; word images are packed, packed ones run as they are
+int Set_code (Cpu_t *cpu, cmd_t *image, size_t words)
+{
+    Free_code (cpu);
+
+    int err = Check_image (image, words);
+
+    if (err == OK && Is_old_image (image, words))
+    {
+        cmd_t *new_image = Upgrade_image (image, &words);
+        free (image);
+
+        image = new_image;
+        if (image == nullptr) return ALLOC_ERROR;
+    }
+
+    if (err == OK && !Is_packed_image (image, words))
+    {
+        cmd_t *new_image = nullptr;
+        err = PackImage (image, words, &new_image, &words, nullptr);
+        free (image);
+
+        image = new_image;
+    }
+
+    if (err)
+    {
+        free (image);
+        return err;
+    }
+
+    return Attach_code (cpu, image, words);
+}
+
+// cpu owns the mapping from now on, the image starts skip words into it
+int Set_mapped_code (Cpu_t *cpu, Map_t *map, size_t skip)
+{
+    Free_code (cpu);
+
+    cmd_t *image = (cmd_t *) map -> data + skip;
+    size_t words = map -> size / CMD_SIZE - skip;
+
+    int err = Check_image (image, words);
+    if (err)
+    {
+        UnmapFile (map);
+        return err;
+    }
+
+    // packed code runs in place, a word image is packed into memory of its own
+    if (!Is_packed_image (image, words))
+    {
+        cmd_t *new_image = nullptr;
+
+        if (Is_old_image (image, words))
+        {
+            cmd_t *upgraded = Upgrade_image (image, &words);
+            if (upgraded == nullptr) err = ALLOC_ERROR;
+            else
+            {
+                err = PackImage (upgraded, words, &new_image, &words, nullptr);
+                free (upgraded);
+            }
+        }
+        else err = PackImage (image, words, &new_image, &words, nullptr);
+
+        UnmapFile (map);
+
+        if (err) return err;
+        return Attach_code (cpu, new_image, words);
+    }
+
+    cpu -> map = *map;
+    *map = {};
+
+    return Attach_code (cpu, image, words);
+}
+
+// signature and version are checked before anything reads the rest of the header
+int Check_image (const cmd_t *image, size_t words)
+{
+    if (words < (size_t) OLD_CODE_SHIFT || image [0] != SIGNATURE) return WRONG_SIGNATURE;
+
+    if (image [1] == OLD_VERSION) return OK;
+    if (image [1] != VERSION)     return WRONG_VERSION;
+
+    return words < (size_t) CODE_SHIFT ? WRONG_CODESIZE : OK;
+}
+
+// image is packed; the line table starts at the word after the code
+int Attach_code (Cpu_t *cpu, cmd_t *image, size_t words)
+{
+    cpu -> header = image + CODE_SHIFT;
+    cpu -> code   = (const unsigned char *) cpu -> header;
+
+    cpu -> lines     = nullptr;
+    cpu -> lines_num = 0;
+
+    int code_size = cpu -> header [CODESIZE_POS];
+    if (code_size < 0 || CODE_SHIFT + Code_words (code_size) > words) return WRONG_CODESIZE;
+
+    cpu -> code_size = code_size;
+
+    // a command the packer does not write could make the fetch run past the code
+    for (int ip = 0; ip < code_size; )
+    {
+        cmd_t cmd = 0;
+
+        ip = UnpackCmd (cpu -> code, code_size, ip, &cmd, nullptr);
+        if (ip < 0) return WRONG_CODESIZE;
+    }
+
+    int err = ReadLineTable (cpu, words - CODE_SHIFT - Code_words (code_size));
+    if (err == OK && (cpu -> header [FLAGS_POS] & FLAG_WORD_JUMPS)) err = Make_word_ips (cpu);
+    if (err) return err;
+
+    Reserve_stacks (cpu);
+
+    return OK;
+}
+
+// ips of the words the code had before packing, for jumps that compute their targets
+int Make_word_ips (Cpu_t *cpu)
+{
+    cmd_t cmd = 0;
+    int words = 0;
+
+    for (int ip = 0; ip < cpu -> code_size; words += 1 + !!(cmd & ARG_REG) + !!(cmd & ARG_IM))
+    {
+        ip = UnpackCmd (cpu -> code, cpu -> code_size, ip, &cmd, nullptr);
+        if (ip < 0) return WRONG_CODESIZE;
+    }
+
+    cpu -> word_ips = (int *) calloc ((size_t) words + 1, sizeof (int));
+    if (cpu -> word_ips == nullptr) return ALLOC_ERROR;
+
+    cpu -> word_ips_num = words;
+
+    int word = 0;
+
+    for (int ip = 0; ip < cpu -> code_size; )
+    {
+        int next = UnpackCmd (cpu -> code, cpu -> code_size, ip, &cmd, nullptr);
+
+        cpu -> word_ips [word++] = ip;
+        if (cmd & ARG_REG) cpu -> word_ips [word++] = -1;
+        if (cmd & ARG_IM)  cpu -> word_ips [word++] = -1;
+
+        ip = next;
+    }
+
+    return OK;
+}
+
+int Is_old_image (const cmd_t *image, size_t words)
+{
+    return words >= (size_t) OLD_CODE_SHIFT && image [0] == SIGNATURE && image [1] == OLD_VERSION;
+}
+
+// old header: signature, version, code size, accuracy; the new fields are left unknown
+cmd_t *Upgrade_image (const cmd_t *image, size_t *words_p)
+{
+    size_t words = *words_p - OLD_CODE_SHIFT + CODE_SHIFT;
+
+    cmd_t *new_image = (cmd_t *) calloc (words, CMD_SIZE);
+    if (new_image == nullptr) return nullptr;
+
+    cmd_t *code = new_image + CODE_SHIFT;
+
+    code [SIGNATURE_POS] = SIGNATURE;
+    code [  VERSION_POS] = VERSION;
+    code [ CODESIZE_POS] = image [2];
+    code [ ACCURACY_POS] = image [3];
+
+    memcpy (code, image + OLD_CODE_SHIFT, (*words_p - OLD_CODE_SHIFT) * CMD_SIZE);
+
+    *words_p = words;
+    return new_image;
+}
+
+// with depths known in advance the stacks are allocated once and never grow
+void Reserve_stacks (Cpu_t *cpu)
+{
+    if (!(cpu -> header [FLAGS_POS] & FLAG_DEPTH_EXACT)) return;
+
+    size_t      depth = (size_t) cpu -> header [STACKDEPTH_POS];
+    size_t call_depth = (size_t) cpu -> header [ CALLDEPTH_POS];
+
+    if (depth <= STACK_RESERVE_MAX && call_depth <= STACK_RESERVE_MAX)
+    {
+        StackReserve (&(cpu ->      stk),      depth);
+        StackReserve (&(cpu -> call_stk), call_depth);
+    }
+}
+
+int ReadLineTable (Cpu_t *cpu, size_t tail_size)
+{
+    if (cpu == nullptr || cpu -> header == nullptr) return NULLPTR_ARG;
+
+    const cmd_t *tail = cpu -> header + Code_words (cpu -> code_size);
+
+    if (tail_size < (size_t) LINES_HEADER_SIZE || tail [0] != LINES_SIGNATURE) return OK;
+
+    size_t num = (size_t) tail [1];
+    if (num > (tail_size - LINES_HEADER_SIZE) * CMD_SIZE / sizeof (Line_t)) return WRONG_CODESIZE;
+
+    cpu -> lines     = (const Line_t *) (tail + LINES_HEADER_SIZE);
+    cpu -> lines_num = num;
 
     return OK;
 }
 
-size_t GetSize (FILE *inp_file)
+int GetSourceLine (const Cpu_t *cpu, int ip)
 {
-    if (inp_file == nullptr) return 0;
-    struct stat stat_buf = {};
+    if (cpu == nullptr || cpu -> lines_num == 0 || cpu -> lines [0].ip > ip) return 0;
+
+    size_t left = 0, right = cpu -> lines_num;        // last entry with entry.ip <= ip
+
+    while (right - left > 1)
+    {
+        size_t mid = (left + right) / 2;
+
+        if (cpu -> lines [mid].ip <= ip) left  = mid;
+        else                             right = mid;
+    }
 
-    fstat (fileno (inp_file), &stat_buf);
-    return stat_buf.st_size;
+    return cpu -> lines [left].line;
 }
 
 
@@ -90,24 +363,58 @@ int InfoCheck (Cpu_t *cpu)
 {
     if (cpu == nullptr) return NULLPTR_ARG;
 
-    if (cpu -> code [SIGNATURE_POS] != SIGNATURE)        return WRONG_SIGNATURE;
-    if (cpu -> code [  VERSION_POS] != VERSION)          return WRONG_VERSION;
-    if (cpu -> code [ CODESIZE_POS] != cpu -> code_size) return WRONG_CODESIZE;
+    if (cpu -> header [SIGNATURE_POS] != SIGNATURE)        return WRONG_SIGNATURE;
+    if (cpu -> header [  VERSION_POS] != VERSION)          return WRONG_VERSION;
+    if (cpu -> header [ CODESIZE_POS] != cpu -> code_size) return WRONG_CODESIZE;
     
     return OK;
 }
 
 
 int RunCode (Cpu_t *cpu)
+{
+    return Run_code <0, 0> (cpu, nullptr, 0);
+}
+
+int RunCodeProfile (Cpu_t *cpu, Profile_t *prof)
+{
+    if (prof == nullptr) return NULLPTR_ARG;
+
+    prof -> start = __rdtsc ();
+
+    int err = Run_code <1, 0> (cpu, prof, 0);
+
+    ProfileFinish (prof);
+
+    return err;
+}
+
+// runs at most budget instructions, then returns RUN_YIELD
+int RunCodeSlice (Cpu_t *cpu, long long budget)
+{
+    return Run_code <0, 1> (cpu, nullptr, budget);
+}
+
+// PROFILE and SLICE are compile time constants, so RunCode has no profiling or budget code at all
+template <int PROFILE, int SLICE>
+int Run_code (Cpu_t *cpu, Profile_t *prof, long long budget)
 {
     if (cpu         == nullptr) return NULLPTR_ARG;
     if (cpu -> code == nullptr) return NULLPTR_ARG;
 
-    cpu -> accuracy_coef = cpu -> code [ACCURACY_POS];
+    cpu -> accuracy_coef = cpu -> header [ACCURACY_POS];
 
     while (1)
     {
-        cmd_t cmd = (cpu -> code [(cpu -> ip)++]);
+        if (SLICE && budget-- <= 0) return RUN_YIELD;
+
+        if (PROFILE && cpu -> ip >= 0 && cpu -> ip < prof -> code_size)
+        {
+            prof -> ip_count [cpu -> ip]++;
+            prof -> op_count [cpu -> code [cpu -> ip] & ~COMPACT_MODE_BIT]++;
+        }
+
+        cmd_t cmd = Fetch_cmd (cpu);
 
 #define DEF_CMD(name, num, arg, ...)  \
     case CMD_##name:                  \
@@ -129,7 +436,71 @@ int RunCode (Cpu_t *cpu)
 
 #undef DEF_CMD
 
+        if (PROFILE)
+        {
+            if ((cmd & CMD_MASK) == CMD_CALL)
+            {
+                int err = ProfileCall (prof, cpu -> ip);
+                if (err) return err;
+            }
+            else if ((cmd & CMD_MASK) == CMD_RET) ProfileRet (prof);
+        }
+    }
+    return OK;
+}
+
+// the opcode byte, and the mode byte after it when the opcode has the mode bit: ARG_ flags and the register
+cmd_t Fetch_cmd (Cpu_t *cpu)
+{
+    cmd_t cmd = cpu -> code [(cpu -> ip)++];
+    if (!(cmd & COMPACT_MODE_BIT)) return cmd;
+
+    int mode = cpu -> code [(cpu -> ip)++];
+
+    return (cmd & ~COMPACT_MODE_BIT) | (mode & ARG_FLAGS_MASK) << ARG_SHIFT | (mode >> COMPACT_REG_SHIFT) << CMD_REG_SHIFT;
+}
+
+// the code was checked at load, so the varint ends inside it
+arg_t Fetch_imm (Cpu_t *cpu)
+{
+    unsigned zigzag = 0;
+
+    for (int shift = 0; shift < MAX_VARINT_LEN * 7; shift += 7)
+    {
+        unsigned char byte = cpu -> code [(cpu -> ip)++];
+        zigzag |= (unsigned) (byte & 0x7F) << shift;
+
+        if (!(byte & 0x80)) break;
+    }
+
+    return (arg_t) (zigzag >> 1) ^ -(arg_t) (zigzag & 1);
+}
+
+// a jump not taken steps over its immediate, the register is in cmd already
+void Skip_args (Cpu_t *cpu, cmd_t cmd)
+{
+    if (cmd & ARG_IM) Fetch_imm (cpu);
+}
+
+// a constant target is the byte ip the packer put there, a computed one is a word ip of the unpacked code
+int GetJumpIp (Cpu_t *cpu, cmd_t cmd, int *ip_p)
+{
+    arg_t arg = 0;
+
+    int err = GetArgs (cpu, cmd, &arg);
+    if (err) return err;
+
+    int ip = arg / cpu -> accuracy_coef;
+
+    if (!Is_const_jump (cmd))
+    {
+        if (cpu -> word_ips == nullptr || ip < 0 || ip >= cpu -> word_ips_num) return INCORRECT_JMP_IP;
+        ip = cpu -> word_ips [ip];
     }
+
+    if (ip < 0 || ip >= cpu -> code_size) return INCORRECT_JMP_IP;
+
+    *ip_p = ip;
     return OK;
 }
 
@@ -142,12 +513,12 @@ int GetArgs (Cpu_t *cpu, cmd_t cmd, arg_t *arg_p)
 
     if (cmd & ARG_REG) 
     {
-        int reg = cpu -> code [(cpu -> ip)++];
+        int reg = cmd >> CMD_REG_SHIFT;
         if (reg <= 0 || reg >= NUM_OF_REGS) return INCORRECT_REG;
         arg += cpu -> regs [reg];
     }
 
-    if (cmd & ARG_IM ) arg += (cpu -> code [(cpu -> ip)++]) * cpu -> accuracy_coef;
+    if (cmd & ARG_IM ) arg += Fetch_imm (cpu) * cpu -> accuracy_coef;
 
     if (cmd & ARG_MEM)
     {
@@ -172,7 +543,7 @@ int GetArgAdress (Cpu_t *cpu, cmd_t cmd, arg_t **val_ptr_p)
 
     if (cmd & ARG_REG)
     {
-        int reg = cpu -> code [(cpu -> ip)++];
+        int reg = cmd >> CMD_REG_SHIFT;
         if (reg <= 0 || reg >= NUM_OF_REGS) return INCORRECT_REG;
         val_ptr = cpu -> regs + reg;
     }
@@ -182,7 +553,7 @@ int GetArgAdress (Cpu_t *cpu, cmd_t cmd, arg_t **val_ptr_p)
         if (val_ptr == nullptr) val_ptr = cpu -> ram;
         else                    val_ptr = cpu -> ram + *val_ptr / cpu -> accuracy_coef;
 
-        if (cmd & ARG_IM ) val_ptr += cpu -> code [(cpu -> ip)++];
+        if (cmd & ARG_IM ) val_ptr += Fetch_imm (cpu);
 
         if (val_ptr >= cpu -> ram + RAM_SIZE) return INCORRECT_RAM_ADRESS;
     }
@@ -192,15 +563,44 @@ int GetArgAdress (Cpu_t *cpu, cmd_t cmd, arg_t **val_ptr_p)
 }
 
 
+void Free_code (Cpu_t *cpu)
+{
+    if (cpu -> map.data) UnmapFile (&(cpu -> map));
+    else                 free (cpu -> header ? cpu -> header - CODE_SHIFT : nullptr);
+
+    free (cpu -> word_ips);
+
+    cpu -> header = nullptr;
+    cpu -> code   = nullptr;
+
+    cpu -> word_ips     = nullptr;
+    cpu -> word_ips_num = 0;
+}
+
 void FreeCpu (Cpu_t *cpu)
 {
     if (cpu == nullptr) return;
 
-    free (cpu -> code - CODE_SHIFT);
+    FlushOut (cpu);
+
+    Free_code (cpu);
+    free (cpu -> out_buf);
+    free (cpu ->  in_buf);
+    free (cpu -> capture);
+
+    cpu -> out_buf = nullptr;
+    cpu ->  in_buf = nullptr;
+    cpu -> capture = nullptr;
+
+    cpu -> capture_len     = 0;
+    cpu -> capture_max_len = 0;
     
     cpu -> ip = 0;
     cpu -> code_size = 0;
 
+    cpu -> lines     = nullptr;
+    cpu -> lines_num = 0;
+
     StackDtor (&(cpu ->      stk));
     StackDtor (&(cpu -> call_stk));
 
@@ -242,45 +642,301 @@ void FreeCpu (Cpu_t *cpu)
     return OK;
 }*/
 
-int PrintArg (arg_t arg, int accuracy_coef)
+int PrintArg (Cpu_t *cpu, arg_t arg)
+{
+    if (cpu == nullptr) return NULLPTR_ARG;
+
+    cpu -> out_len += FormatArg (cpu -> out_buf + cpu -> out_len, arg, cpu -> accuracy_coef);
+
+    if (cpu -> out_len >= OUT_FLUSH_SIZE) return FlushOut (cpu);
+
+    return OK;
+}
+
+size_t FormatArg (char *buf, arg_t arg, int accuracy_coef)
+{
+    // same text as printf ("%d\n") for integer programs and printf ("%.3lf\n") of arg / coef otherwise
+    char digits [MAX_NUM_LEN] = "";
+    size_t num_of_digits = 0;
+    size_t len = 0;
+
+    unsigned long long val = arg < 0 ? 0ULL - (unsigned long long) arg : (unsigned long long) arg;
+    int frac_digits = 0;
+
+    if (accuracy_coef != 1)
+    {
+        unsigned long long num  = val * OUT_PRECISION;
+        unsigned long long coef = (unsigned long long) accuracy_coef;
+        unsigned long long rem  = num % coef;
+
+        val = num / coef;
+        if (rem * 2 > coef || (rem * 2 == coef && Round_tie_up (arg, accuracy_coef, val))) val++;
+
+        frac_digits = 3;
+    }
+
+    do
+    {
+        digits [num_of_digits++] = (char) ('0' + val % 10);
+        val /= 10;
+    }
+    while (val || (int) num_of_digits <= frac_digits);
+
+    if (arg < 0) buf [len++] = '-';
+
+    while (num_of_digits > 0)
+    {
+        if ((int) num_of_digits == frac_digits) buf [len++] = '.';
+        buf [len++] = digits [--num_of_digits];
+    }
+
+    buf [len++] = '\n';
+
+    return len;
+}
+
+// printf rounds the double arg / coef, not the fraction: on a tie of the fraction the double is a bit
+// above or below it, or exactly on it for dyadic ties, and then the even neighbour wins
+int Round_tie_up (arg_t arg, int accuracy_coef, unsigned long long val)
+{
+    double quot = fabs ((double) arg / accuracy_coef);
+
+    // exact sign of quot * 2 * OUT_PRECISION - (2 * val + 1), fma rounds once
+    double diff = fma (quot, 2.0 * OUT_PRECISION, -(double) (2 * val + 1));
+
+    if (diff != 0) return diff > 0;
+
+    return (int) (val & 1);
+}
+
+int FlushOut (Cpu_t *cpu)
+{
+    if (cpu == nullptr || cpu -> out_buf == nullptr) return OK;
+    if (cpu -> out_len == 0) return OK;
+
+    if (cpu -> write_cb)
+    {
+        int err = cpu -> write_cb (cpu -> io_ctx, cpu -> out_buf, cpu -> out_len) ? FWRITE_ERROR : OK;
+        cpu -> out_len = 0;
+
+        return err;
+    }
+
+    if (cpu -> out_file == nullptr) return CaptureOut (cpu, cpu -> out_buf, cpu -> out_len);
+
+    size_t written = fwrite (cpu -> out_buf, sizeof (char), cpu -> out_len, cpu -> out_file);
+    fflush (cpu -> out_file);
+
+    int err = written == cpu -> out_len ? OK : FWRITE_ERROR;
+    cpu -> out_len = 0;
+
+    return err;
+}
+
+int CaptureOut (Cpu_t *cpu, const char *str, size_t len)
+{
+    if (cpu == nullptr || str == nullptr) return NULLPTR_ARG;
+
+    if (cpu -> capture_len + len > cpu -> capture_max_len)
+    {
+        size_t old_len = cpu -> capture_max_len;
+        size_t new_len = old_len ? old_len * 2 : OUT_BUF_SIZE;
+        while (new_len < cpu -> capture_len + len) new_len *= 2;
+
+        char *capture = (char *) Recalloc (cpu -> capture, new_len, sizeof (char), old_len);
+        if (capture == nullptr) return ALLOC_ERROR;
+
+        cpu -> capture         = capture;
+        cpu -> capture_max_len = new_len;
+    }
+
+    memcpy (cpu -> capture + cpu -> capture_len, str, len);
+    cpu -> capture_len += len;
+
+    if (str == cpu -> out_buf) cpu -> out_len = 0;
+
+    return OK;
+}
+
+int ScanArg (Cpu_t *cpu, arg_t *arg)
+{
+    if (cpu == nullptr || arg == nullptr) return NULLPTR_ARG;
+
+    // works like scanf ("%d"): skips spaces, stops at the first character that is not a digit
+
+    while (1)
+    {
+        while (cpu -> in_pos < cpu -> in_len && isspace (cpu -> in_buf [cpu -> in_pos])) cpu -> in_pos++;
+
+        if (cpu -> in_pos < cpu -> in_len) break;
+        if (cpu -> in_eof)  return EOF;
+        if (cpu -> in_wait) return RUN_BLOCKED;
+        if (FillIn (cpu))   return EOF;
+    }
+
+    // the number may go on in the next blocks, they are read until something else or the end
+    size_t end = cpu -> in_pos + (cpu -> in_buf [cpu -> in_pos] == '-' || cpu -> in_buf [cpu -> in_pos] == '+');
+
+    while (1)
+    {
+        while (end < cpu -> in_len && (unsigned) (cpu -> in_buf [end] - '0') < 10) end++;
+
+        if (end < cpu -> in_len || cpu -> in_eof) break;
+        if (cpu -> in_wait) return RUN_BLOCKED;
+
+        end -= cpu -> in_pos;                           // FillIn moves the rest to the front
+        if (FillIn (cpu)) break;
+    }
+
+    const char *ch = cpu -> in_buf + cpu -> in_pos;     // in_buf is null-terminated
+
+    int sign = (*ch == '-') ? -1 : 1;
+    if (*ch == '-' || *ch == '+') ch++;
+
+    if ((unsigned) (*ch - '0') >= 10) return 0;
+
+    arg_t val = 0;
+    while ((unsigned) (*ch - '0') < 10) val = val * 10 + (*ch++ - '0');
+
+    *arg = sign * val;
+    cpu -> in_pos = (size_t) (ch - cpu -> in_buf);
+
+    return 1;
+}
+
+int FillIn (Cpu_t *cpu)
 {
-    if (accuracy_coef == 1) return printf ("%d\n", arg);
-    else                    return printf ("%.3lf\n", (double) arg / accuracy_coef);  
+    if (cpu == nullptr || cpu -> in_buf == nullptr) return NULLPTR_ARG;
+
+    FlushOut (cpu);     // the program may be waiting for an answer to what it printed
+
+    size_t rest = cpu -> in_len - cpu -> in_pos;
+    memmove (cpu -> in_buf, cpu -> in_buf + cpu -> in_pos, rest);
+
+    cpu -> in_pos = 0;
+    cpu -> in_len = rest;
+
+    long got = 0;
+    if      (cpu -> read_cb) got = cpu -> read_cb (cpu -> io_ctx, cpu -> in_buf + rest, IN_BUF_SIZE - 1 - rest);
+    else if (cpu -> in_file) got = (long) read (fileno (cpu -> in_file), cpu -> in_buf + rest, (unsigned) (IN_BUF_SIZE - 1 - rest));
+
+    if (got <= 0) cpu -> in_eof = 1;
+    else          cpu -> in_len += (size_t) got;
+
+    cpu -> in_buf [cpu -> in_len] = '\0';
+
+    return got <= 0 ? EOF : OK;
 }
 
-int ScanArg (arg_t *arg)
+// appends input for a VM with in_wait set, returns how much of str fitted
+size_t CpuFeed (Cpu_t *cpu, const char *str, size_t len)
 {
-    return scanf ("%d", arg);
+    if (cpu == nullptr || cpu -> in_buf == nullptr || str == nullptr) return 0;
+
+    size_t rest = cpu -> in_len - cpu -> in_pos;
+    memmove (cpu -> in_buf, cpu -> in_buf + cpu -> in_pos, rest);
+
+    cpu -> in_pos = 0;
+
+    if (len > IN_BUF_SIZE - 1 - rest) len = IN_BUF_SIZE - 1 - rest;
+    memcpy (cpu -> in_buf + rest, str, len);
+
+    cpu -> in_len = rest + len;
+    cpu -> in_buf [cpu -> in_len] = '\0';
+
+    return len;
 }
 
 
 void CpuErr (Cpu_t *cpu, int err, FILE *stream)
 {
+    FlushOut (cpu);
+
     fprintf (stream, "ERROR: %d\n", err);
 
-    if (cpu == nullptr || err == NULLPTR_ARG) fprintf (stream, "Nullptr error.\n");
-    else if (err == OK)                       fprintf (stream, "OK.\n"); 
-    else if (err == FOPEN_ERROR)              fprintf (stream, "Cannot open the file.\n");
-    else if (err == ALLOC_ERROR)              fprintf (stream, "Cannot allocate memory.\n");
-    else if (err == WRONG_SIGNATURE)          fprintf (stream, "Code file has wrong signature.\n");
+    if (cpu == nullptr || err == NULLPTR_ARG) fprintf (stream, "%s\n", CpuErrText (NULLPTR_ARG));
     else if (err == WRONG_VERSION)            fprintf (stream, "Code version differs from cpu version:\n"
                                                                "code version - %d;\n"
-                                                               "cpu  version - %d.\n", cpu -> code [-2], VERSION);
-    else if (err == WRONG_CODESIZE)           fprintf (stream, "Code file has wrong code size:\n");
+                                                               "cpu  version - %d.\n", cpu -> header ? cpu -> header [VERSION_POS] : 0, VERSION);
+    else if (err == OK              || err == FOPEN_ERROR     || err == ALLOC_ERROR ||
+             err == WRONG_SIGNATURE || err == WRONG_CODESIZE  || err == RECORDS_FAILED)
+    {
+        fprintf (stream, "%s\n", CpuErrText (err));
+    }
     else
     {
         PrintCode (cpu, stream);
-             if (err == EMPTY_STACK)          fprintf (stream, "Cannot get a value from stack.\n");
-        else if (err == DIV_BY_ZERO)          fprintf (stream, "Division by zero.\n");
-        else if (err == SQRT_OF_NEG)          fprintf (stream, "Square root of negative number.\n");
-        else if (err == UNKNOWN_CMD)          fprintf (stream, "Unknown command.\n");
-        else if (err == INCORRECT_REG)        fprintf (stream, "Incorrect register name.\n");
-        else if (err == INCORRECT_RAM_ADRESS) fprintf (stream, "Incorrect RAM adress.\n");
-        else if (err == INCORRECT_ARG_TYPE)   fprintf (stream, "Incorrect argument type.\n");
-        else if (err == INCORRECT_JMP_IP)     fprintf (stream, "Incorrect ip to jump.\n");
-        else if (err == EMPTY_CALL_STACK)     fprintf (stream, "Cannot return (call stack is empty).\n");
-        else                                  fprintf (stream, "Unknown error.\n");
+        fprintf (stream, "%s\n", CpuErrText (err));
+    }
+}
+
+const char *CpuErrText (int err)
+{
+    switch (err)
+    {
+        case OK:                   return "OK.";
+        case NULLPTR_ARG:          return "Nullptr error.";
+        case FOPEN_ERROR:          return "Cannot open the file.";
+        case ALLOC_ERROR:          return "Cannot allocate memory.";
+        case WRONG_SIGNATURE:      return "Code file has wrong signature.";
+        case WRONG_VERSION:        return "Code version differs from cpu version.";
+        case WRONG_CODESIZE:       return "Code file has wrong code size.";
+        case RECORDS_FAILED:       return "Some records failed, see the output.";
+        case RECORD_TOO_LONG:      return "Record does not fit the input buffer.";
+        case EMPTY_STACK:          return "Cannot get a value from stack.";
+        case DIV_BY_ZERO:          return "Division by zero.";
+        case SQRT_OF_NEG:          return "Square root of negative number.";
+        case UNKNOWN_CMD:          return "Unknown command.";
+        case INCORRECT_REG:        return "Incorrect register name.";
+        case INCORRECT_RAM_ADRESS: return "Incorrect RAM adress.";
+        case INCORRECT_ARG_TYPE:   return "Incorrect argument type.";
+        case INCORRECT_JMP_IP:     return "Incorrect ip to jump.";
+        case EMPTY_CALL_STACK:     return "Cannot return (call stack is empty).";
+        default:                   return "Unknown error.";
+    }
+}
+
+void PrintDump (Cpu_t *cpu, FILE *stream)
+{
+    if (cpu == nullptr || stream == nullptr) return;
+
+    fprintf (stream, "\nCPU DUMP:\n\n");
+    PrintCode (cpu, stream);
+    PrintRegs (cpu, stream);
+    fprintf (stream, "\n");
+}
+
+// output is captured, dump_file is then a scratch file and the dump is moved into the capture at once,
+// so it keeps its place among the output
+int CaptureDump (Cpu_t *cpu)
+{
+    if (cpu == nullptr) return NULLPTR_ARG;
+
+    FILE *scratch = cpu -> dump_file;
+    if (scratch == nullptr) return OK;
+
+    rewind (scratch);
+    PrintDump (cpu, scratch);
+
+    long len = ftell (scratch);
+    if (len < 0 || fflush (scratch)) return FWRITE_ERROR;
+
+    rewind (scratch);
+
+    char chunk [BUFLEN] = "";
+
+    while (len > 0)
+    {
+        size_t part = (size_t) len < BUFLEN ? (size_t) len : BUFLEN;
+        if (fread (chunk, sizeof (char), part, scratch) != part) return FWRITE_ERROR;
+
+        int err = CaptureOut (cpu, chunk, part);
+        if (err) return err;
+
+        len -= (long) part;
     }
+
+    return OK;
 }
 
 void PrintCode (Cpu_t *cpu, FILE *stream)
@@ -290,13 +946,18 @@ void PrintCode (Cpu_t *cpu, FILE *stream)
     int  left = cpu -> ip > 5 ? cpu -> ip - 5 : 0;
     int right = left + 11 < cpu -> code_size ? left + 11 : cpu -> code_size;
 
+    if (cpu -> code == nullptr) return;
+
     fprintf (stream, "IP:   ");
     for (int index = left; index < right; index ++) fprintf (stream, " %04X ", index);
-    fprintf (stream, "\nCMD:  ");
-    for (int index = left; index < right; index ++) fprintf (stream, " %04X ", cpu -> code [index]);
+    fprintf (stream, "\nCODE: ");
+    for (int index = left; index < right; index ++) fprintf (stream, "   %02X ", cpu -> code [index]);
     fprintf (stream, "\n      ");
     for (int index = left; index < right; index ++) fprintf (stream, index == cpu -> ip ? "   ^  " : "      " );
     fprintf (stream, "\n");
+
+    int src_line = GetSourceLine (cpu, cpu -> ip > 0 ? cpu -> ip - 1 : 0);     // ip is already past the command
+    if (src_line) fprintf (stream, "Source line: %d\n", src_line);
 }
 
 void PrintRegs (Cpu_t *cpu, FILE *stream)
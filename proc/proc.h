@@ -3,7 +3,6 @@
 
 typedef int    arg_t;
 typedef int    cmd_t;
-typedef arg_t Elem_t;
 
 
 // #include <TXLib.h>
@@ -14,26 +13,36 @@ typedef arg_t Elem_t;
 #include <sys/stat.h>
 #include <math.h>
 #include <time.h>
-#include "stack.h"
+#include <unistd.h>
+#include <x86intrin.h>
+#include <new>
+#include <thread>
+#include <atomic>
+#include "../stack/stack.h"
 #include "txtfuncs.h"
+#include "libproc.h"
+#include "fixmath.h"
 
-const int VERSION = 15;
+const int VERSION = 16;
+const int OLD_VERSION = 15;                                 // header without stack depths, still accepted
 const int SIGNATURE = 0x54ABC228;
 
 const size_t BUFLEN = 128;
-const size_t MAX_LABEL_LEN = 20;
+const size_t MAX_LABEL_LEN = 48;                           // function labels carry the source name, local ones the function too
 
 const int NUM_OF_ASM = 2;
+const size_t ASM_CHUNK_LINES = 1 << 14;                     // a bigger text is cut at function labels and assembled in parallel
 
 const size_t MAX_NUM_OF_ARGS = 2;
 const size_t ARG_SIZE = sizeof (arg_t);
 const size_t CMD_SIZE = sizeof (cmd_t);
 
-const int CODE_SHIFT = 4;
+const int CODE_SHIFT = 7;
+const int OLD_CODE_SHIFT = 4;
 const size_t INFO_SIZE = sizeof (cmd_t) * CODE_SHIFT;
 
 const size_t ERROR_MSG_SIZE = 100;
-FILE *ERROR_STREAM = stdout;
+extern thread_local FILE *ERROR_STREAM;                    // defined next to main, one per thread
 
 const int CMD_MASK = 0x000000FF;
 
@@ -47,30 +56,151 @@ const size_t PIXEL_HEIGTH = 3;
 
 const size_t      STACK_BASE_CAPACITY = 16;
 const size_t CALL_STACK_BASE_CAPACITY =  8;
+const size_t    STACK_RESERVE_MAX = 1 << 16;                 // header depths above it are not trusted
+
+const size_t OUT_BUF_SIZE   = 1 << 16;
+const size_t  IN_BUF_SIZE   = 1 << 16;
+const size_t MAX_NUM_LEN    = 32;                           // longest formatted or parsed number
+const size_t OUT_FLUSH_SIZE = OUT_BUF_SIZE - MAX_NUM_LEN;
+const int    OUT_PRECISION  = 1000;                         // 3 digits after the point, as "%.3lf"
 
 const int SECS_IN_DAY = 24 * 60 * 60;
 
 const char ACCURACY_CMD_NAME [] = "#ACCURACY";
+const char     LINE_CMD_NAME [] = "#LINE";
+const char   EXPORT_CMD_NAME [] = "#EXPORT";                // a label other units can use, and its number of arguments
+const char   IMPORT_CMD_NAME [] = "#IMPORT";                // the number of arguments a label of another unit is called with
+const char   LOCAL_LABEL_MARK   = '.';                      // .name belongs to the last label without it
+
+const int    LINES_SIGNATURE   = 0x4C494E45;                // "LINE", starts the line table after the code
+const int    LINES_HEADER_SIZE = 2;                         // signature, number of entries
+const size_t LINES_BASE_NUM    = 32;
+
+const char  SYMBOLS_OPTION [] = "--symbols";
+const char  PROFILE_OPTION [] = "--profile";
+const char  SYMBOLS_EXT    [] = ".sym";
+const char  PROFILE_FILE_NAME [] = "profile.txt";
+const char  RECORDS_OPTION [] = "--records";
+const char  THREADS_OPTION [] = "-j";
+const char    CACHE_OPTION [] = "--cache";
+const char    INPUT_OPTION [] = "--input";                  // program input, for when the code comes on stdin
+
+const char   OBJECT_OPTION [] = "-c";                     // asm: write a unit for the linker, not a program
+const char   OUTPUT_OPTION [] = "-o";
+const char   LINK_FILE_NAME [] = "code";
+const char   MAIN_LABEL_NAME [] = "main";
+
+const int    OBJ_SIGNATURE   = 0x4F424A33;                  // "OBJ3", a unit before it is placed
+const int    ARGS_UNKNOWN    = -1;                          // an export or import without a number of arguments
+const int    OBJ_HEADER_SIZE = 6;                           // signature, image words, globals, exports, imports, relocations
+const size_t RELOCS_BASE_NUM = 32;
+const int    LINK_START_SIZE = 10;                          // PUSH 0, POP rdx, PUSH globals, POP rcx, JMP main
+
+const int    CACHE_SIGNATURE   = 0x43414348;                // "CACH", a verified image in the code cache
+const int    CACHE_HEADER_SIZE = 5;                         // signature, version, hash (2 words), image words
+const size_t CACHE_NAME_LEN    = 512;
+
+const size_t PROFILE_HOT_IPS = 20;
+const size_t PROFILE_BASE_FRAMES = 16;
+
+struct Map_t
+{
+    void  *data;                                // read-only view of a whole file, nullptr - not mapped
+    size_t size;
+    void  *handle;                              // file mapping object on Windows
+};
 
-struct Cpu_t
+struct Line_t
 {
-    int ip;
-    cmd_t *code;
+    int ip;                                     // first ip generated from the line
+    int line;
+};
+
+struct Line_table_t
+{
+    size_t     num;
+    size_t max_num;
+    Line_t *list;
+};
+
+struct Func_depth_t
+{
+    int state;
+    int max;                                    // highest operand stack depth above the entry depth
+    int net;                                    // depth change from entry to RET
+    int calls;                                  // deepest chain of calls made from it
+
+    size_t first_callee;                        // its call targets in Depth_work_t.callees
+    size_t callees_num;
+    size_t callee_pos;                          // next one to walk into
+};
+
+// one set of buffers for the whole program, a function resets only the ips it reached
+struct Depth_work_t
+{
+    const cmd_t *code;
     int code_size;
 
-    Stack_t      stk;
-    Stack_t call_stk;
+    Func_depth_t *funcs;                        // indexed by entry ip
+    int *depth;                                 // DEPTH_UNSET outside the function being analysed
+    int *todo;                                  // ips reached by the function, in the order they were reached
+    int *stack;                                 // functions whose callees are being walked
+
+    int   *callees;
+    size_t callees_num;
+    size_t callees_max_num;
+};
+
+struct Cpu_t
+{
+    int ip;                                     // byte of code the next command starts at
+    cmd_t *header;                              // header words are at negative positions, code starts here
+    const unsigned char *code;                  // packed commands, the same memory as header
+    int code_size;                              // in bytes
+    Map_t map;                                  // header points into it when the file is mapped
+
+    int *word_ips;                              // ip of every word of the code before packing, -1 inside a command;
+    int  word_ips_num;                          // nullptr - no jump computes its target
+
+    Stack_t <arg_t>      stk;
+    Stack_t <int>   call_stk;
 
     arg_t regs [NUM_OF_REGS];
     arg_t ram  [RAM_SIZE];
 
     int accuracy_coef;
+
+    char  *out_buf;
+    size_t out_len;
+
+    char  *in_buf;
+    size_t in_pos;
+    size_t in_len;
+    int    in_eof;
+    int    in_wait;                             // 1 - input is fed by CpuFeed, IN blocks instead of reading in_file
+
+    const Line_t *lines;                        // points into the code image, nullptr without #LINE info
+    size_t    lines_num;
+
+    FILE *  in_file;                            // not owned, stdin and stdout by default
+    FILE * out_file;                            // nullptr - output is kept in capture
+    FILE *dump_file;                            // DUMP goes here when out_file is nullptr, nullptr - nowhere,
+                                                // a scratch file for CaptureDump when output is captured
+
+    Proc_read_t  read_cb;                       // used instead of in_file and out_file when set
+    Proc_write_t write_cb;
+    void *io_ctx;
+
+    char  *capture;
+    size_t capture_len;
+    size_t capture_max_len;
 };
 
 struct Label_t
 {
     char name [MAX_LABEL_LEN + 1];
     int ip;
+    int args;                                   // exports and imports: number of arguments, or ARGS_UNKNOWN
 };
 
 struct Label_list_t
@@ -78,6 +208,103 @@ struct Label_list_t
     size_t     num;
     size_t max_num;
     Label_t *list;
+
+    struct Obj_t *obj;                          // nullptr - a whole program, every label is defined in it
+    char scope [MAX_LABEL_LEN + 1];             // last label without LOCAL_LABEL_MARK
+    struct Asm_chunk_t *chunk;                  // nullptr - the text is assembled in one piece
+};
+
+struct Reloc_t
+{
+    int pos;                                    // word of the code the linker moves
+    int kind;
+    int sym;                                    // RELOC_SYMBOL: index in the imports
+};
+
+struct Reloc_list_t
+{
+    size_t     num;
+    size_t max_num;
+    Reloc_t *list;
+};
+
+// a unit: its code starts at ip 0 and its global slots at [1], the linker moves both
+struct Obj_t
+{
+    Label_list_t exports;
+    Label_list_t imports;                       // ip is not used
+    Reloc_list_t relocs;
+    int globals;                                // highest global slot used
+
+    cmd_t *image;                               // linker only, header, code and line table as asm made them
+    int  code_base;
+    int  globals_base;
+};
+
+// lines from a function label up to the next chunk, assembled like a unit: references to labels of
+// its own are RELOC_CODE, to the others' RELOC_SYMBOL, and the merge resolves them like the linker
+struct Asm_chunk_t
+{
+    size_t first;
+    size_t last;                                // not included
+
+    cmd_t *cmds;                                // header and code, ips from 0
+    Label_list_t labels;
+    Obj_t obj;
+    Line_table_t line_table;
+
+    size_t *exports;                            // lines of #EXPORT and #IMPORT, the labels may be in any chunk
+    size_t exports_num;
+    size_t exports_max;
+
+    int base;                                   // ip of the chunk in the whole code
+    int err;
+};
+
+struct Asm_chunks_t
+{
+    Text *txt;
+
+    Asm_chunk_t *list;
+    size_t num;
+
+    FILE *errors;                               // ERROR_STREAM of the caller, it is one per thread
+    std::atomic <size_t> next;                  // first chunk nobody has taken yet
+};
+
+struct Prof_frame_t
+{
+    int target;
+    unsigned long long start;
+};
+
+struct Profile_t
+{
+    const Cpu_t *cpu;
+    int     code_size;
+
+    unsigned long long *ip_count;
+    unsigned long long  op_count [CMD_MASK + 1];
+
+    unsigned long long *call_count;             // indexed by the ip of the called function
+    unsigned long long *call_cycles;            // inclusive, recursive calls are counted once
+    int                *call_active;
+
+    Prof_frame_t *frames;
+    size_t        frames_num;
+    size_t        frames_max_num;
+
+    unsigned long long start;
+    unsigned long long cycles;
+
+    Label_list_t symbols;                       // sorted by ip
+};
+
+// what RunCodeSlice returns besides errors, OK means HLT
+enum RUN_STATES
+{
+    RUN_YIELD   = -10,                          // budget is over, call again to go on
+    RUN_BLOCKED = -11,                          // IN is waiting for CpuFeed, ip stays on it
 };
 
 enum REGISTERS
@@ -112,6 +339,9 @@ enum ERRORS
     INCORRECT_JMP_IP     = 15,
     EMPTY_CALL_STACK     = 16,
     SQRT_OF_NEG          = 17,
+    RECORDS_FAILED       = 18,
+    LINK_ERROR           = 19,
+    RECORD_TOO_LONG      = 20,
 };
 
 #endif
@@ -133,19 +363,111 @@ enum ARG_TYPES
     ARG_MEM = 0x400,
 };
 
+// packed code, the form the cpu runs: opcode byte, then a mode byte (argument flags, register above them)
+// when the command has arguments, then the immediate as a zigzag varint. Ips are byte offsets: a jump with
+// a lone immediate holds the byte ip of its target, the line table and the symbols are in bytes too. A jump
+// that computes its target (register, memory) still gets a word ip, as before packing, the cpu looks it up
+// in word_ips. Asm and link make word images, WriteCmds and the loader pack them.
+const int ARG_SHIFT         = 8;
+const int ARG_FLAGS_MASK    = 0x7;              // (cmd >> ARG_SHIFT) & ARG_FLAGS_MASK
+const int CMD_REG_SHIFT     = 16;               // register of a fetched command, above its flags
+const int COMPACT_MODE_BIT  = 0x80;             // in the opcode byte: a mode byte follows
+const int COMPACT_REG_SHIFT = 3;
+const int COMPACT_MAX_REG   = 31;
+const int MAX_VARINT_LEN    = 5;
+
 enum CODE_POSITIONS
 {
     SIGNATURE_POS = -CODE_SHIFT,
       VERSION_POS = -CODE_SHIFT + 1,
      CODESIZE_POS = -CODE_SHIFT + 2,
-     ACCURACY_POS = -CODE_SHIFT + 3,
+   STACKDEPTH_POS = -CODE_SHIFT + 3,
+    CALLDEPTH_POS = -CODE_SHIFT + 4,
+        FLAGS_POS = -CODE_SHIFT + 5,
+     ACCURACY_POS = -CODE_SHIFT + 6,
+};
+
+enum CODE_FLAGS
+{
+    FLAG_DEPTH_EXACT = 1,                       // no recursion, STACKDEPTH and CALLDEPTH are upper bounds
+    FLAG_COMPACT     = 2,                       // packed code, CODESIZE is in bytes, the line table starts at the next word
+    FLAG_WORD_JUMPS  = 4,                       // packed code has jumps with computed targets, the loader makes word_ips
 };
 
+enum RELOC_KINDS
+{
+    RELOC_CODE   = 0,                           // a label of the unit, plus where the unit is placed
+    RELOC_GLOBAL = 1,                           // a bare RAM address, plus the globals of the units before
+    RELOC_SYMBOL = 2,                           // a label of another unit
+};
+
+enum DEPTH_STATES
+{
+    DEPTH_NEW  = 0,
+    DEPTH_BUSY = 1,                             // its callees are being walked, a call to it is recursion
+    DEPTH_DONE = 2,
+};
+
+const int DEPTH_UNSET  = -0x7FFFFFFF;           // ip not reached yet
+const int DEPTH_NO_RET = -0x7FFFFFFF;           // function never returns
+
 // asm funcs ----------------------------------------------------------------------------------------------------------
 
-int Compile (struct Text *txt, cmd_t **cmds_p);
+int Compile (struct Text *txt, cmd_t **cmds_p, Label_list_t *label_list, unsigned threads_num);
+
+int Compile_whole (Text *txt, cmd_t **cmds_p, Label_list_t *label_list, Line_table_t *line_table);
+
+int Compile_chunks (Text *txt, cmd_t **cmds_p, Label_list_t *label_list, Line_table_t *line_table, unsigned threads_num);
+
+int Split_chunks (Asm_chunks_t *chunks);
+
+int Is_scope_label (const char *line);
+
+void AsmWorker (Asm_chunks_t *chunks);
+
+int Assemble_chunk (Text *txt, Asm_chunk_t *chunk);
+
+int Chunk_add_export (Asm_chunk_t *chunk, size_t line);
+
+int Merge_chunks (Asm_chunks_t *chunks, cmd_t **cmds_p, Label_list_t *label_list, Line_table_t *line_table);
+
+int Merge_reloc (Label_list_t *label_list, Label_t **sorted, cmd_t *code, Asm_chunk_t *chunk, Reloc_t *reloc);
+
+int Merge_exports (Text *txt, Asm_chunk_t *chunk, Label_list_t *label_list);
+
+int Compare_label_names (const void *label1, const void *label2);
+
+int Find_label (Label_t **sorted, size_t num, const char *name);
+
+void ChunksDtor (Asm_chunks_t *chunks);
+
+int Assemble (Text *txt, size_t first, size_t last, cmd_t *cmds, Label_list_t *label_list, Line_table_t *line_table, int pass);
+
+int AddLine (Line_table_t *line_table, int ip, char *args);
+
+int Put_line (Line_table_t *line_table, int ip, int src_line);
+
+int PutLineTable (cmd_t **cmds_p, Line_table_t *line_table);
+
+size_t GetImageSize (const cmd_t *cmds);
 
-int Assemble (Text *txt, cmd_t *cmds, Label_list_t *label_list, int pass);
+int PutStackDepth (cmd_t *cmds);
+
+int Depth_work_ctor (Depth_work_t *work, const cmd_t *code, int code_size);
+
+void Depth_work_dtor (Depth_work_t *work);
+
+int Depth_walk (Depth_work_t *work);
+
+int Func_calls (Depth_work_t *work, int entry);
+
+int Func_depth (Depth_work_t *work, int entry);
+
+int Cmd_target (const cmd_t *code, int code_size, int ip, int *next, int *target);
+
+void Depth_reset (Depth_work_t *work, int todo_num);
+
+int Depth_visit (int *depth, int code_size, int *todo, int *todo_num, int ip, int new_depth);
 
 int SetAccuracyCoef (cmd_t *cmds, char *line);
 
@@ -153,16 +475,40 @@ int LabelListCtor (Label_list_t *label_list);
 
 int AddLabel (char *cmd, Label_list_t *label_list, int ip, size_t line);
 
-int CheckLabelName (char **name_p, Label_list_t *label_list, size_t line);
+int CheckLabelName (char **name_p, char *full_name, Label_list_t *label_list, size_t line);
+
+int Scope_label (const char *name, Label_list_t *label_list, char *full_name);
+
+void Set_label_scope (const char *cmd, Label_list_t *label_list);
 
 int ExpandLabelList (Label_list_t *label_list);
 
 int GetLabelIp (char *name, Label_list_t *label_list);
 
-int WriteCmds (const char *output_file_name, cmd_t *cmds);
+void LabelListDtor (Label_list_t *label_list);
+
+int WriteSymbols (const char *output_file_name, Label_list_t *label_list);
+
+int WriteCmds (const char *output_file_name, cmd_t *cmds, Label_list_t *label_list);
 
 int PutArgs (char *args, cmd_t *cmds, int *ip, Label_list_t *label_list, size_t line, int loop);
 
+int Put_label_ip (char *name, cmd_t *cmds, int pos, Label_list_t *label_list, int pass);
+
+int AddReloc (Label_list_t *label_list, const cmd_t *cmds, int pos, int kind, int sym, int pass);
+
+int AddImport (Obj_t *obj, const char *name);
+
+int AddSymbol (Label_list_t *label_list, const char *cmd, char *args, size_t line);
+
+int AddExport (Label_list_t *label_list, char *name, int num_of_args, size_t line);
+
+int ObjCtor (Obj_t *obj);
+
+void ObjDtor (Obj_t *obj);
+
+int WriteObj (const char *output_file_name, cmd_t *cmds, Obj_t *obj);
+
 char *DeleteSpaces (char *str);
 
 void AsmErr (int err, FILE *stream);
@@ -172,24 +518,101 @@ void AsmErr (int err, FILE *stream);
 
 int CpuCtor (Cpu_t *cpu);
 
+int CpuReset (Cpu_t *cpu);
+
+void CpuTrim (Cpu_t *cpu);
+
 int ReadCode (const char *input_file_name, Cpu_t *cpu);
 
+int LoadCode (Cpu_t *cpu, const cmd_t *image, size_t words);
+
+int Read_code_copy (const char *input_file_name, Cpu_t *cpu);
+
+int Set_code (Cpu_t *cpu, cmd_t *image, size_t words);
+
+int Set_mapped_code (Cpu_t *cpu, Map_t *map, size_t skip);
+
+int Check_image (const cmd_t *image, size_t words);
+
+int Attach_code (Cpu_t *cpu, cmd_t *image, size_t words);
+
+int Make_word_ips (Cpu_t *cpu);
+
+cmd_t *Upgrade_image (const cmd_t *image, size_t *words_p);
+
+int Is_old_image (const cmd_t *image, size_t words);
+
+size_t Image_words (const Cpu_t *cpu);
+
+void Reserve_stacks (Cpu_t *cpu);
+
+void Free_code (Cpu_t *cpu);
+
+int MapFile (const char *file_name, Map_t *map);
+
+void UnmapFile (Map_t *map);
+
+unsigned long long CodeHash (const void *data, size_t size);
+
+int VerifyCode (const Cpu_t *cpu);
+
+int ReadCodeCached (const char *input_file_name, Cpu_t *cpu, const char *cache_dir);
+
+int Cache_write (const char *cache_name, unsigned long long hash, const cmd_t *image, size_t words);
+
+int ReadLineTable (Cpu_t *cpu, size_t tail_size);
+
+int GetSourceLine (const Cpu_t *cpu, int ip);
+
 int InfoCheck (Cpu_t *cpu);
 
 int RunCode (Cpu_t *cpu);
 
+int RunCodeProfile (Cpu_t *cpu, Profile_t *prof);
+
+int RunCodeSlice (Cpu_t *cpu, long long budget);
+
+template <int PROFILE, int SLICE>
+int Run_code (Cpu_t *cpu, Profile_t *prof, long long budget);
+
+cmd_t Fetch_cmd (Cpu_t *cpu);
+
+arg_t Fetch_imm (Cpu_t *cpu);
+
+void Skip_args (Cpu_t *cpu, cmd_t cmd);
+
 int GetArgs (Cpu_t *cpu, cmd_t cmd, arg_t *arg);
 
 int GetArgAdress (Cpu_t *cpu, cmd_t cmd, arg_t **val_ptr_p);
 
+int GetJumpIp (Cpu_t *cpu, cmd_t cmd, int *ip_p);
+
 void FreeCpu (Cpu_t *cpu);
 
-int PrintArg (arg_t arg, int accuracy_coef);
+int PrintArg (Cpu_t *cpu, arg_t arg);
+
+size_t FormatArg (char *buf, arg_t arg, int accuracy_coef);
+
+int Round_tie_up (arg_t arg, int accuracy_coef, unsigned long long val);
+
+int FlushOut (Cpu_t *cpu);
+
+int CaptureOut (Cpu_t *cpu, const char *str, size_t len);
 
-int ScanArg (arg_t *arg);
+int ScanArg (Cpu_t *cpu, arg_t *arg);
+
+int FillIn (Cpu_t *cpu);
+
+size_t CpuFeed (Cpu_t *cpu, const char *str, size_t len);
 
 void CpuErr (Cpu_t *cpu, int err, FILE *stream);
 
+const char *CpuErrText (int err);
+
+void PrintDump (Cpu_t *cpu, FILE *stream);
+
+int CaptureDump (Cpu_t *cpu);
+
 void PrintCode (Cpu_t *cpu, FILE *stream);
 
 void PrintRegs (Cpu_t *cpu, FILE *stream);
@@ -197,6 +620,75 @@ void PrintRegs (Cpu_t *cpu, FILE *stream);
 int PrintMem (Cpu_t *cpu);
 
 int MondayToday (void);
+
+//---------------------------------------------------------------------------------------------------------------------
+// pack funcs ---------------------------------------------------------------------------------------------------------
+
+int PackImage (const cmd_t *image, size_t words, cmd_t **new_image_p, size_t *new_words_p, int **byte_ips_p);
+
+int Pack_layout (const cmd_t *code, int code_size, int *byte_ips, unsigned char *im_lens, int *word_jumps_p);
+
+int Pack_cmd (const cmd_t *code, int code_size, int ip, int *next_p, int *target_p);
+
+void Pack_emit (const cmd_t *code, int code_size, const int *byte_ips, const unsigned char *im_lens, unsigned char *bytes);
+
+int Is_packed_image (const cmd_t *image, size_t words);
+
+int UnpackCmd (const unsigned char *code, int code_size, int ip, cmd_t *cmd_p, arg_t *im_p);
+
+int Is_const_jump (cmd_t cmd);
+
+int Cmd_args_num (int op);
+
+size_t Code_words (int code_size);
+
+size_t Varint_len (int val);
+
+size_t Put_varint (unsigned char *bytes, int val, size_t len);
+
+int Get_varint (const unsigned char *bytes, size_t len, size_t *pos_p, int *val_p);
+
+//---------------------------------------------------------------------------------------------------------------------
+// link funcs ---------------------------------------------------------------------------------------------------------
+
+int ReadObj (const char *input_file_name, Obj_t *obj);
+
+int Read_section (const char **data_p, size_t *left_p, void *dest, size_t num, size_t size);
+
+int Link (Obj_t *objs, size_t num, cmd_t **cmds_p);
+
+int Link_place (Obj_t *objs, size_t num, int *code_size_p, int *globals_p, size_t *lines_num_p);
+
+int Link_find (Obj_t *objs, size_t num, const char *name);
+
+int Link_check_args (Obj_t *objs, size_t num);
+
+int Link_relocate (Obj_t *objs, size_t num, size_t unit, cmd_t *code);
+
+void Link_start (cmd_t *code, int globals, int main_ip);
+
+//---------------------------------------------------------------------------------------------------------------------
+// profiler funcs -----------------------------------------------------------------------------------------------------
+
+int ProfileRun (Cpu_t *cpu, const char *code_file_name, const char *symbols_file_name, const char *report_file_name);
+
+int ProfileCtor (Profile_t *prof, int code_size);
+
+void ProfileDtor (Profile_t *prof);
+
+int ProfileCall (Profile_t *prof, int target);
+
+void ProfileRet (Profile_t *prof);
+
+void ProfileFinish (Profile_t *prof);
+
+int ReadSymbols (const char *input_file_name, Label_list_t *symbols);
+
+const char *GetSymbol (Label_list_t *symbols, int ip, int *offset);
+
+const char *GetCmdName (int cmd);
+
+int WriteProfile (const char *output_file_name, Profile_t *prof);
 //---------------------------------------------------------------------------------------------------------------------
 
 #endif
\ No newline at end of file
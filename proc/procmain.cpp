@@ -0,0 +1,149 @@
+#include "records.h"
+
+
+#define Ret_if_err(func)                    \
+    err = func;                             \
+    if (err)                                \
+    {                                       \
+        CpuErr (&cpu, err, ERROR_STREAM);   \
+        return err;                         \
+    }
+
+
+thread_local FILE *ERROR_STREAM = stdout;
+
+
+static int Run_lib (const char *code_file_name, const char *cache_dir_name, FILE *inp_file);
+
+static long Std_read (void *ctx, char *buf, size_t len);
+
+static int Std_write (void *ctx, const char *buf, size_t len);
+
+
+int main (int argc, char *argv[])
+{    
+    const char *  input_file_name = "a";
+    const char *symbols_file_name = nullptr;
+    const char *profile_file_name = nullptr;
+    const char *records_file_name = nullptr;
+    const char *  cache_dir_name    = nullptr;
+    const char *   data_file_name   = nullptr;
+    unsigned threads_num = 0;
+    int use_lanes = 0;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if (strncmp (argv [index], PROFILE_OPTION, sizeof (PROFILE_OPTION) - 1) == 0)
+        {
+            const char *eq = argv [index] + sizeof (PROFILE_OPTION) - 1;
+            profile_file_name = *eq == '=' ? eq + 1 : PROFILE_FILE_NAME;
+        }
+        else if (strcmp (argv [index], SYMBOLS_OPTION) == 0 && index + 1 < argc)
+        {
+            symbols_file_name = argv [++index];
+        }
+        else if (strcmp (argv [index], RECORDS_OPTION) == 0 && index + 1 < argc)
+        {
+            records_file_name = argv [++index];
+        }
+        else if (strcmp (argv [index], CACHE_OPTION) == 0 && index + 1 < argc)
+        {
+            cache_dir_name = argv [++index];
+        }
+        else if (strcmp (argv [index], INPUT_OPTION) == 0 && index + 1 < argc)
+        {
+            data_file_name = argv [++index];
+        }
+        else if (strcmp (argv [index], LANES_OPTION) == 0)
+        {
+            use_lanes = 1;
+        }
+        else if (strcmp (argv [index], THREADS_OPTION) == 0 && index + 1 < argc)
+        {
+            int num = atoi (argv [++index]);
+            threads_num = num > 0 ? (unsigned) num : 0;
+        }
+        else input_file_name = argv [index];
+    }
+
+    FILE *inp_file = stdin;
+    if (data_file_name && (inp_file = fopen (data_file_name, "r")) == nullptr)
+    {
+        fprintf (ERROR_STREAM, "ERROR: %d\nCan't open %s\n", FOPEN_ERROR, data_file_name);
+        return FOPEN_ERROR;
+    }
+
+    // plain runs go through libproc, records and profile modes need the whole Cpu_t
+    if (records_file_name == nullptr && profile_file_name == nullptr)
+    {
+        int err = Run_lib (input_file_name, cache_dir_name, inp_file);
+        if (inp_file != stdin) fclose (inp_file);
+
+        return err;
+    }
+
+    struct Cpu_t cpu = {};
+    int err = OK;
+
+    Ret_if_err (CpuCtor (&cpu));
+
+    cpu.in_file = inp_file;
+
+    Ret_if_err (cache_dir_name ? ReadCodeCached (input_file_name, &cpu, cache_dir_name) :
+                                 ReadCode       (input_file_name, &cpu));
+
+    Ret_if_err (InfoCheck (&cpu));
+
+    if (records_file_name)
+    {
+        Ret_if_err (RecordsRun (&cpu, records_file_name, threads_num, use_lanes, stdout));
+    }
+    else
+    {
+        Ret_if_err (ProfileRun (&cpu, input_file_name, symbols_file_name, profile_file_name));
+    }
+
+    FreeCpu (&cpu);
+    if (inp_file != stdin) fclose (inp_file);
+
+    return OK;
+}
+
+static int Run_lib (const char *code_file_name, const char *cache_dir_name, FILE *inp_file)
+{
+    Proc_t *proc = ProcCreate ();
+    if (proc == nullptr)
+    {
+        fprintf (ERROR_STREAM, "ERROR: %d\n%s\n", ALLOC_ERROR, ProcErrText (ALLOC_ERROR));
+        return ALLOC_ERROR;
+    }
+
+    Proc_io_t io = {Std_read, Std_write, inp_file, stdout};
+    ProcSetIo (proc, &io);
+
+    int err = cache_dir_name ? ProcLoadCached (proc, code_file_name, cache_dir_name) :
+                               ProcLoadFile   (proc, code_file_name);
+    if (err == OK) err = ProcRun (proc);
+
+    if (err) ProcPrintErr (proc, err, ERROR_STREAM);
+
+    ProcDestroy (proc);
+
+    return err;
+}
+
+// ctx is the input FILE
+static long Std_read (void *ctx, char *buf, size_t len)
+{
+    return (long) read (fileno ((FILE *) ctx), buf, (unsigned) len);
+}
+
+static int Std_write (void *ctx, const char *buf, size_t len)
+{
+    (void) ctx;
+
+    size_t written = fwrite (buf, sizeof (char), len, stdout);
+    fflush (stdout);
+
+    return written != len;
+}
@@ -0,0 +1,390 @@
+#include "proc.h"
+
+
+static int Compare_by_count (const void *a, const void *b, const unsigned long long *count);
+
+static thread_local const unsigned long long *SORT_COUNT = nullptr;     // qsort has no context argument
+
+static int Compare_ips (const void *a, const void *b);
+
+static int Compare_labels (const void *a, const void *b);
+
+
+int ProfileRun (Cpu_t *cpu, const char *code_file_name, const char *symbols_file_name, const char *report_file_name)
+{
+    if (cpu == nullptr || code_file_name == nullptr || report_file_name == nullptr) return NULLPTR_ARG;
+
+    Profile_t prof = {};
+
+    int err = ProfileCtor (&prof, cpu -> code_size);
+    if (err) return err;
+
+    if (symbols_file_name)
+    {
+        err = ReadSymbols (symbols_file_name, &(prof.symbols));
+        if (err)
+        {
+            ProfileDtor (&prof);
+            return err;
+        }
+    }
+    else
+    {
+        char default_name [BUFLEN] = "";
+        snprintf (default_name, BUFLEN, "%s%s", code_file_name, SYMBOLS_EXT);
+
+        ReadSymbols (default_name, &(prof.symbols));    // symbols are optional
+    }
+
+    prof.cpu = cpu;
+
+    err = RunCodeProfile (cpu, &prof);
+
+    int write_err = WriteProfile (report_file_name, &prof);
+
+    ProfileDtor (&prof);
+
+    return err ? err : write_err;
+}
+
+int ProfileCtor (Profile_t *prof, int code_size)
+{
+    if (prof == nullptr) return NULLPTR_ARG;
+
+    size_t size = code_size > 0 ? (size_t) code_size : 1;
+
+    prof -> code_size = code_size;
+
+    prof -> ip_count    = (unsigned long long *) calloc (size, sizeof (prof -> ip_count    [0]));
+    prof -> call_count  = (unsigned long long *) calloc (size, sizeof (prof -> call_count  [0]));
+    prof -> call_cycles = (unsigned long long *) calloc (size, sizeof (prof -> call_cycles [0]));
+    prof -> call_active = (int *)                calloc (size, sizeof (prof -> call_active [0]));
+    prof -> frames      = (Prof_frame_t *)       calloc (PROFILE_BASE_FRAMES, sizeof (prof -> frames [0]));
+
+    memset (prof -> op_count, 0, sizeof (prof -> op_count));
+
+    prof -> frames_num     = 0;
+    prof -> frames_max_num = PROFILE_BASE_FRAMES;
+
+    prof -> start  = 0;
+    prof -> cycles = 0;
+
+    prof -> cpu     = nullptr;
+    prof -> symbols = {};
+
+    if (prof -> ip_count == nullptr || prof -> call_count  == nullptr || prof -> call_cycles == nullptr ||
+        prof -> frames   == nullptr || prof -> call_active == nullptr)
+    {
+        ProfileDtor (prof);
+        return ALLOC_ERROR;
+    }
+
+    return OK;
+}
+
+void ProfileDtor (Profile_t *prof)
+{
+    if (prof == nullptr) return;
+
+    free (prof -> ip_count);
+    free (prof -> call_count);
+    free (prof -> call_cycles);
+    free (prof -> call_active);
+    free (prof -> frames);
+    free (prof -> symbols.list);
+
+    *prof = {};
+}
+
+int ProfileCall (Profile_t *prof, int target)
+{
+    if (target < 0 || target >= prof -> code_size) return INCORRECT_JMP_IP;
+
+    if (prof -> frames_num >= prof -> frames_max_num)
+    {
+        size_t old_num = prof -> frames_max_num;
+
+        Prof_frame_t *frames = (Prof_frame_t *) Recalloc (prof -> frames, old_num * 2, sizeof (Prof_frame_t), old_num);
+        if (frames == nullptr) return ALLOC_ERROR;
+
+        prof -> frames = frames;
+        prof -> frames_max_num *= 2;
+    }
+
+    prof -> frames [prof -> frames_num].target = target;
+    prof -> frames [prof -> frames_num].start  = __rdtsc ();
+    prof -> frames_num++;
+
+    prof -> call_count  [target]++;
+    prof -> call_active [target]++;
+
+    return OK;
+}
+
+void ProfileRet (Profile_t *prof)
+{
+    if (prof -> frames_num == 0) return;
+
+    Prof_frame_t *frame = prof -> frames + --(prof -> frames_num);
+
+    // only the outermost activation adds its time, otherwise recursion is counted many times
+    if (--(prof -> call_active [frame -> target]) == 0)
+        prof -> call_cycles [frame -> target] += __rdtsc () - frame -> start;
+}
+
+void ProfileFinish (Profile_t *prof)
+{
+    if (prof == nullptr) return;
+
+    while (prof -> frames_num > 0) ProfileRet (prof);
+
+    prof -> cycles = __rdtsc () - prof -> start;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+int ReadSymbols (const char *input_file_name, Label_list_t *symbols)
+{
+    if (input_file_name == nullptr || symbols == nullptr) return NULLPTR_ARG;
+
+    FILE *inp_file = fopen (input_file_name, "r");
+    if (inp_file == nullptr) return FOPEN_ERROR;
+
+    Label_t label = {};
+
+    while (fscanf (inp_file, "%d %48s", &(label.ip), label.name) == 2)
+    {
+        if (symbols -> num >= symbols -> max_num)
+        {
+            size_t old_num = symbols -> max_num;
+            size_t new_num = old_num ? old_num * 2 : 32;
+
+            Label_t *list = (Label_t *) Recalloc (symbols -> list, new_num, sizeof (Label_t), old_num);
+            if (list == nullptr)
+            {
+                fclose (inp_file);
+                return ALLOC_ERROR;
+            }
+
+            symbols -> list    = list;
+            symbols -> max_num = new_num;
+        }
+
+        symbols -> list [symbols -> num++] = label;
+    }
+
+    fclose (inp_file);
+
+    qsort (symbols -> list, symbols -> num, sizeof (Label_t), Compare_labels);
+
+    return OK;
+}
+
+const char *GetSymbol (Label_list_t *symbols, int ip, int *offset)
+{
+    if (symbols == nullptr || symbols -> num == 0 || symbols -> list [0].ip > ip) return nullptr;
+
+    size_t left = 0, right = symbols -> num;      // last label with label.ip <= ip
+
+    while (right - left > 1)
+    {
+        size_t mid = (left + right) / 2;
+
+        if (symbols -> list [mid].ip <= ip) left  = mid;
+        else                                right = mid;
+    }
+
+    if (offset) *offset = ip - symbols -> list [left].ip;
+
+    return symbols -> list [left].name;
+}
+
+const char *GetCmdName (int cmd)
+{
+#define DEF_CMD(name, num, arg, ...)  \
+    case CMD_##name:                  \
+        return #name;
+
+    switch (cmd & CMD_MASK)
+    {
+        #include "cmd.h"
+
+        default:
+            return "???";
+    }
+
+#undef DEF_CMD
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+int WriteProfile (const char *output_file_name, Profile_t *prof)
+{
+    if (output_file_name == nullptr || prof == nullptr) return NULLPTR_ARG;
+
+    FILE *out_file = fopen (output_file_name, "w");
+    if (out_file == nullptr) return FOPEN_ERROR;
+
+    unsigned long long total = 0;
+    for (int ip = 0; ip < prof -> code_size; ip++) total += prof -> ip_count [ip];
+
+    double total_div = total          ? (double) total          : 1;
+    double cycle_div = prof -> cycles ? (double) prof -> cycles : 1;
+
+    fprintf (out_file, "PROFILE\n\n"
+                       "instructions: %llu\n"
+                       "cycles:       %llu\n", total, prof -> cycles);
+
+    int *order = (int *) calloc ((size_t) (prof -> code_size > CMD_MASK ? prof -> code_size : CMD_MASK) + 1, sizeof (int));
+    if (order == nullptr)
+    {
+        fclose (out_file);
+        return ALLOC_ERROR;
+    }
+
+    // opcodes ----------------------------------------------------------------------------------------------------------
+
+    int num = 0;
+    for (int op = 0; op <= CMD_MASK; op++) if (prof -> op_count [op]) order [num++] = op;
+
+    SORT_COUNT = prof -> op_count;
+    qsort (order, (size_t) num, sizeof (int), Compare_ips);
+
+    fprintf (out_file, "\nOPCODES:\n%14s %7s  %s\n", "count", "%", "cmd");
+
+    for (int index = 0; index < num; index++)
+        fprintf (out_file, "%14llu %6.2lf%%  %s\n", prof -> op_count [order [index]],
+                           100.0 * (double) prof -> op_count [order [index]] / total_div, GetCmdName (order [index]));
+
+    // functions --------------------------------------------------------------------------------------------------------
+
+    num = 0;
+    for (int ip = 0; ip < prof -> code_size; ip++) if (prof -> call_count [ip]) order [num++] = ip;
+
+    SORT_COUNT = prof -> call_cycles;
+    qsort (order, (size_t) num, sizeof (int), Compare_ips);
+
+    fprintf (out_file, "\nFUNCTIONS (inclusive cycles):\n%14s %18s %7s  %s\n", "calls", "cycles", "%", "function");
+
+    for (int index = 0; index < num; index++)
+    {
+        int ip = order [index];
+        int offset = 0;
+        const char *name = GetSymbol (&(prof -> symbols), ip, &offset);
+
+        fprintf (out_file, "%14llu %18llu %6.2lf%%  ", prof -> call_count [ip], prof -> call_cycles [ip],
+                           100.0 * (double) prof -> call_cycles [ip] / cycle_div);
+
+        if (name && offset == 0) fprintf (out_file, "%s", name);
+        else                     fprintf (out_file, "%04X", ip);
+
+        int src_line = GetSourceLine (prof -> cpu, ip);
+        if (src_line) fprintf (out_file, " (line %d)", src_line);
+
+        fprintf (out_file, "\n");
+    }
+
+    // source lines ----------------------------------------------------------------------------------------------------
+
+    if (prof -> cpu && prof -> cpu -> lines_num)
+    {
+        const Cpu_t *cpu = prof -> cpu;
+
+        int max_line = 0;
+        for (size_t index = 0; index < cpu -> lines_num; index++)
+            if (cpu -> lines [index].line > max_line) max_line = cpu -> lines [index].line;
+
+        unsigned long long *line_count = (unsigned long long *) calloc ((size_t) max_line + 1, sizeof (line_count [0]));
+        if (line_count == nullptr)
+        {
+            free (order);
+            fclose (out_file);
+            return ALLOC_ERROR;
+        }
+
+        num = 0;
+        for (size_t index = 0; index < cpu -> lines_num; index++)
+        {
+            int  first_ip = cpu -> lines [index].ip;
+            int   last_ip = index + 1 < cpu -> lines_num ? cpu -> lines [index + 1].ip : prof -> code_size;
+            if (last_ip > prof -> code_size) last_ip = prof -> code_size;
+
+            unsigned long long count = 0;
+            for (int ip = first_ip; ip < last_ip; ip++) count += prof -> ip_count [ip];
+
+            if (count == 0) continue;
+
+            int line = cpu -> lines [index].line;
+            if (line_count [line] == 0) order [num++] = line;
+            line_count [line] += count;
+        }
+
+        SORT_COUNT = line_count;
+        qsort (order, (size_t) num, sizeof (int), Compare_ips);
+
+        fprintf (out_file, "\nSOURCE LINES:\n%14s %7s  %s\n", "count", "%", "line");
+
+        for (int index = 0; index < num; index++)
+            fprintf (out_file, "%14llu %6.2lf%%  %d\n", line_count [order [index]],
+                               100.0 * (double) line_count [order [index]] / total_div, order [index]);
+
+        free (line_count);
+    }
+
+    // hot addresses ----------------------------------------------------------------------------------------------------
+
+    num = 0;
+    for (int ip = 0; ip < prof -> code_size; ip++) if (prof -> ip_count [ip]) order [num++] = ip;
+
+    SORT_COUNT = prof -> ip_count;
+    qsort (order, (size_t) num, sizeof (int), Compare_ips);
+
+    if ((size_t) num > PROFILE_HOT_IPS) num = (int) PROFILE_HOT_IPS;
+
+    fprintf (out_file, "\nHOT ADDRESSES:\n%14s %7s  %-6s %-6s %-6s %s\n", "count", "%", "ip", "cmd", "line", "label");
+
+    for (int index = 0; index < num; index++)
+    {
+        int ip = order [index];
+        int offset = 0;
+        const char *name = GetSymbol (&(prof -> symbols), ip, &offset);
+
+        int src_line = GetSourceLine (prof -> cpu, ip);
+
+        fprintf (out_file, "%14llu %6.2lf%%  %04X   %-6s ", prof -> ip_count [ip],
+                           100.0 * (double) prof -> ip_count [ip] / total_div, ip, GetCmdName (prof -> cpu ? prof -> cpu -> code [ip] & ~COMPACT_MODE_BIT : -1));
+
+        if (src_line) fprintf (out_file, "%-6d ", src_line);
+        else          fprintf (out_file, "%-6s ", "-");
+
+        if (name) fprintf (out_file, "%s+%d\n", name, offset);
+        else      fprintf (out_file, "\n");
+    }
+
+    SORT_COUNT = nullptr;
+
+    free (order);
+    fclose (out_file);
+
+    return OK;
+}
+
+static int Compare_by_count (const void *a, const void *b, const unsigned long long *count)
+{
+    unsigned long long count_a = count [*(const int *) a];
+    unsigned long long count_b = count [*(const int *) b];
+
+    if (count_a != count_b) return count_a < count_b ? 1 : -1;
+
+    return *(const int *) a - *(const int *) b;
+}
+
+static int Compare_ips (const void *a, const void *b)
+{
+    return Compare_by_count (a, b, SORT_COUNT);
+}
+
+static int Compare_labels (const void *a, const void *b)
+{
+    return ((const Label_t *) a) -> ip - ((const Label_t *) b) -> ip;
+}
@@ -0,0 +1,337 @@
+#include "records.h"
+
+
+int RecordsRun (Cpu_t *image, const char *records_file_name, unsigned threads_num, int use_lanes, FILE *out_file)
+{
+    if (image == nullptr || image -> code == nullptr || records_file_name == nullptr || out_file == nullptr) return NULLPTR_ARG;
+
+    if (threads_num == 0) threads_num = std::thread::hardware_concurrency ();
+    if (threads_num == 0) threads_num = 1;
+
+    FILE *rec_file = fopen (records_file_name, "rb");
+    if (rec_file == nullptr) return FOPEN_ERROR;
+
+    Records_t recs = {};
+
+    int err = RecordsCtor (&recs, image, threads_num, use_lanes);
+
+    std::thread *threads = new (std::nothrow) std::thread [threads_num];
+    if (threads == nullptr && err == OK) err = ALLOC_ERROR;
+
+    while (err == OK)
+    {
+        err = RecordsReadBlock (&recs, rec_file);
+        if (err || recs.num == 0) break;
+
+        recs.next = 0;
+
+        unsigned active = recs.num < threads_num ? (unsigned) recs.num : threads_num;
+
+        for (unsigned worker = 0; worker < active; worker++) threads [worker] = std::thread (RecordsWorker, &recs, worker);
+        for (unsigned worker = 0; worker < active; worker++) threads [worker].join ();
+
+        err = RecordsWriteBlock (&recs, out_file);
+    }
+
+    fflush (out_file);
+
+    if (err == OK && recs.failed)
+    {
+        fprintf (ERROR_STREAM, "%u of %u records failed.\n", (unsigned) recs.failed, (unsigned) recs.first);
+        err = RECORDS_FAILED;
+    }
+
+    delete [] threads;
+    RecordsDtor (&recs);
+    fclose (rec_file);
+
+    return err;
+}
+
+int RecordsCtor (Records_t *recs, Cpu_t *image, unsigned threads_num, int use_lanes)
+{
+    if (recs == nullptr || image == nullptr) return NULLPTR_ARG;
+
+    recs -> workers = (Cpu_t *)    calloc (threads_num, sizeof (Cpu_t));
+    recs -> block   = (Record_t *) calloc (RECORDS_BLOCK_SIZE, sizeof (Record_t));
+    recs -> text    = (char *)     calloc (RECORDS_TEXT_SIZE, sizeof (char));
+
+    if (recs -> workers == nullptr || recs -> block == nullptr || recs -> text == nullptr)
+    {
+        RecordsDtor (recs);
+        return ALLOC_ERROR;
+    }
+
+    recs -> text_max_len = RECORDS_TEXT_SIZE;
+
+    if (use_lanes)
+    {
+        recs -> lanes = (Lanes_t *) calloc (threads_num, sizeof (Lanes_t));
+        if (recs -> lanes == nullptr)
+        {
+            RecordsDtor (recs);
+            return ALLOC_ERROR;
+        }
+    }
+
+    for (unsigned worker = 0; worker < threads_num; worker++)
+    {
+        Cpu_t *cpu = recs -> workers + worker;
+
+        recs -> workers_num++;
+
+        int err = CpuCtor (cpu);
+        cpu -> dump_file = nullptr;                     // not stdout, RecordsDtor closes it
+        if (err)
+        {
+            RecordsDtor (recs);
+            return err;
+        }
+
+        // read-only view of the image, FreeCpu must not free it
+        cpu -> header    = image -> header;
+        cpu -> code      = image -> code;
+        cpu -> code_size = image -> code_size;
+        cpu -> lines     = image -> lines;
+        cpu -> lines_num = image -> lines_num;
+
+        cpu -> word_ips     = image -> word_ips;
+        cpu -> word_ips_num = image -> word_ips_num;
+
+        Reserve_stacks (cpu);
+
+        cpu ->  in_file = nullptr;
+        cpu -> out_file = nullptr;
+
+        // DUMP text joins the record output through this scratch file
+        cpu -> dump_file = tmpfile ();
+        if (cpu -> dump_file == nullptr)
+        {
+            RecordsDtor (recs);
+            return FOPEN_ERROR;
+        }
+
+        if (recs -> lanes)
+        {
+            err = LanesCtor (recs -> lanes + worker, image);
+            if (err)
+            {
+                RecordsDtor (recs);
+                return err;
+            }
+        }
+    }
+
+    return OK;
+}
+
+void RecordsDtor (Records_t *recs)
+{
+    if (recs == nullptr) return;
+
+    for (unsigned worker = 0; worker < recs -> workers_num; worker++)
+    {
+        recs -> workers [worker].header   = nullptr;
+        recs -> workers [worker].word_ips = nullptr;
+        if (recs -> workers [worker].dump_file) fclose (recs -> workers [worker].dump_file);
+        FreeCpu (recs -> workers + worker);
+
+        if (recs -> lanes) LanesDtor (recs -> lanes + worker);
+    }
+
+    free (recs -> workers);
+    free (recs -> lanes);
+    free (recs -> block);
+    free (recs -> text);
+
+    recs -> workers = nullptr;
+    recs -> lanes   = nullptr;
+    recs -> block   = nullptr;
+    recs -> text    = nullptr;
+
+    recs -> workers_num = 0;
+}
+
+int RecordsReadBlock (Records_t *recs, FILE *rec_file)
+{
+    if (recs == nullptr || rec_file == nullptr) return NULLPTR_ARG;
+
+    recs -> first   += recs -> num;
+    recs -> num      = 0;
+    recs -> text_len = 0;
+
+    char buf [BUFLEN] = "";
+
+    while (recs -> num < RECORDS_BLOCK_SIZE && fgets (buf, BUFLEN, rec_file))
+    {
+        Record_t *rec = recs -> block + recs -> num++;
+
+        rec -> input     = recs -> text_len;
+        rec -> input_len = 0;
+
+        // a record is one line, fgets may return it in pieces; the text of a record too long
+        // for the input buffer is dropped, the record fails alone
+        while (1)
+        {
+            size_t len = strlen (buf);
+            int end_of_line = len > 0 && buf [len - 1] == '\n';
+
+            if (rec -> input_len + len < IN_BUF_SIZE)
+            {
+                int err = Records_add_text (recs, buf, len);
+                if (err) return err;
+            }
+            rec -> input_len += len;
+
+            if (end_of_line || !fgets (buf, BUFLEN, rec_file)) break;
+        }
+    }
+
+    return OK;
+}
+
+int Records_add_text (Records_t *recs, const char *str, size_t len)
+{
+    if (recs -> text_len + len > recs -> text_max_len)
+    {
+        size_t old_len = recs -> text_max_len;
+        size_t new_len = old_len * 2;
+        while (new_len < recs -> text_len + len) new_len *= 2;
+
+        char *text = (char *) Recalloc (recs -> text, new_len, sizeof (char), old_len);
+        if (text == nullptr) return ALLOC_ERROR;
+
+        recs -> text         = text;
+        recs -> text_max_len = new_len;
+    }
+
+    memcpy (recs -> text + recs -> text_len, str, len);
+    recs -> text_len += len;
+
+    return OK;
+}
+
+void RecordsWorker (Records_t *recs, unsigned worker)
+{
+    if (recs -> lanes)
+    {
+        Records_lanes_worker (recs, worker);
+        return;
+    }
+
+    while (1)
+    {
+        size_t index = recs -> next++;
+        if (index >= recs -> num) return;
+
+        Records_run_one (recs, worker, index);
+    }
+}
+
+void Records_lanes_worker (Records_t *recs, unsigned worker)
+{
+    Cpu_t   *cpu   = recs -> workers + worker;
+    Lanes_t *lanes = recs -> lanes   + worker;
+
+    while (1)
+    {
+        size_t first = recs -> next.fetch_add (LANES);
+        if (first >= recs -> num) return;
+
+        int count = recs -> num - first < (size_t) LANES ? (int) (recs -> num - first) : LANES;
+
+        LanesReset (lanes);
+
+        for (int lane = 0; lane < count; lane++)
+        {
+            Record_t *rec = recs -> block + first + lane;
+            if (rec -> input_len < IN_BUF_SIZE) LanesSetInput (lanes, lane, recs -> text + rec -> input, rec -> input_len);
+        }
+
+        LanesRun (lanes);
+
+        // a lane that failed is run again alone, so its output and error match the plain engine
+        for (int lane = 0; lane < count; lane++)
+        {
+            Record_t *rec = recs -> block + first + lane;
+
+            if (lanes -> err [lane] || rec -> input_len >= IN_BUF_SIZE)
+            {
+                Records_run_one (recs, worker, first + lane);
+                continue;
+            }
+
+            rec -> worker = worker;
+            rec -> output = cpu -> capture_len;
+            rec -> err    = CaptureOut (cpu, lanes -> out [lane], lanes -> out_len [lane]);
+
+            rec -> output_len = cpu -> capture_len - rec -> output;
+        }
+    }
+}
+
+void Records_run_one (Records_t *recs, unsigned worker, size_t index)
+{
+    Cpu_t *cpu = recs -> workers + worker;
+    Record_t *rec = recs -> block + index;
+
+    rec -> worker = worker;
+    rec -> output = cpu -> capture_len;
+
+    rec -> err = rec -> input_len < IN_BUF_SIZE ? RunRecord (cpu, recs -> text + rec -> input, rec -> input_len) : RECORD_TOO_LONG;
+
+    if (rec -> err)
+    {
+        char msg [ERROR_MSG_SIZE] = "";
+        int len = snprintf (msg, ERROR_MSG_SIZE, "ERROR: %d (record %u)\n", rec -> err, (unsigned) (recs -> first + index + 1));
+        if (len > 0) CaptureOut (cpu, msg, (size_t) len);
+    }
+
+    rec -> output_len = cpu -> capture_len - rec -> output;
+}
+
+int RunRecord (Cpu_t *cpu, const char *input, size_t input_len)
+{
+    if (cpu == nullptr || input == nullptr) return NULLPTR_ARG;
+
+    CpuReset (cpu);
+
+    // the whole record is the input, IN gets EOF after it
+    memcpy (cpu -> in_buf, input, input_len);
+    cpu -> in_buf [input_len] = '\0';
+    cpu -> in_len = input_len;
+    cpu -> in_eof = 1;
+
+    int err = RunCode (cpu);
+
+    int flush_err = FlushOut (cpu);
+
+    return err ? err : flush_err;
+}
+
+int RecordsWriteBlock (Records_t *recs, FILE *out_file)
+{
+    if (recs == nullptr || out_file == nullptr) return NULLPTR_ARG;
+
+    for (size_t index = 0; index < recs -> num; index++)
+    {
+        Record_t *rec = recs -> block + index;
+
+        if (rec -> err) recs -> failed++;
+
+        if (rec -> output_len == 0) continue;
+
+        const char *output = recs -> workers [rec -> worker].capture + rec -> output;
+
+        if (fwrite (output, sizeof (char), rec -> output_len, out_file) != rec -> output_len) return FWRITE_ERROR;
+    }
+
+    // a block is a phase: stacks grown by its deepest record shrink before the next one
+    for (unsigned worker = 0; worker < recs -> workers_num; worker++)
+    {
+        recs -> workers [worker].capture_len = 0;
+        CpuTrim (recs -> workers + worker);
+    }
+
+    return OK;
+}
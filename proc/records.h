@@ -0,0 +1,67 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include <new>
+#include <thread>
+#include <atomic>
+#include "proc.h"
+#include "lanes.h"
+
+
+const size_t RECORDS_BLOCK_SIZE = 4096;         // records read, run and written at a time
+const size_t RECORDS_TEXT_SIZE  = 1 << 16;
+
+struct Record_t
+{
+    size_t input;                               // offset of the input line in Records_t::text
+    size_t input_len;
+
+    unsigned worker;                            // the output is in this worker's capture
+    size_t   output;
+    size_t   output_len;
+
+    int err;
+};
+
+struct Records_t
+{
+    Cpu_t   *workers;                           // share the code of one loaded image
+    unsigned workers_num;
+
+    Lanes_t *lanes;                             // one lock-step engine per worker, nullptr - plain engine only
+
+    Record_t *block;
+    size_t    num;
+    size_t    first;                            // index of block [0] in the whole file
+
+    char  *text;
+    size_t text_len;
+    size_t text_max_len;
+
+    std::atomic <size_t> next;
+
+    size_t failed;
+};
+
+
+int RecordsRun (Cpu_t *image, const char *records_file_name, unsigned threads_num, int use_lanes, FILE *out_file);
+
+int RecordsCtor (Records_t *recs, Cpu_t *image, unsigned threads_num, int use_lanes);
+
+void RecordsDtor (Records_t *recs);
+
+int RecordsReadBlock (Records_t *recs, FILE *rec_file);
+
+int Records_add_text (Records_t *recs, const char *str, size_t len);
+
+void RecordsWorker (Records_t *recs, unsigned worker);
+
+void Records_lanes_worker (Records_t *recs, unsigned worker);
+
+void Records_run_one (Records_t *recs, unsigned worker, size_t index);
+
+int RunRecord (Cpu_t *cpu, const char *input, size_t input_len);
+
+int RecordsWriteBlock (Records_t *recs, FILE *out_file);
+
+#endif
@@ -1,16 +1,448 @@
-#include <stdlib.h>
-#include <string.h>
+#include "run.h"
+
+
+thread_local FILE *ERROR_STREAM = stdout;
+
 
 int main (int argc, char *argv[])
 {
-    for (int index = 1; index < argc; index++)
-    {   
-        char cmd[100] = "asm.exe ";
-        strcat (cmd, argv[index]);
-        strcat (cmd, " code");
+    unsigned threads_num = std::thread::hardware_concurrency ();
+    if (threads_num == 0) threads_num = 1;
+
+    long long budget = 0;
+
+    Batch_t batch = {};
+    Text list = {};
+    int err = OK;
+
+    // run.exe [-j N | -s budget] [-l list] [prog.txt ...], list lines are "prog.txt [input.txt]", job names point into the list
+    for (int index = 1; index < argc && err == OK; index++)
+    {
+        if (strcmp (argv [index], THREADS_OPTION) == 0 && index + 1 < argc)
+        {
+            int num = atoi (argv [++index]);
+            if (num > 0) threads_num = (unsigned) num;
+        }
+        else if (strcmp (argv [index], SLICE_OPTION) == 0 && index + 1 < argc)
+        {
+            budget = atoll (argv [++index]);
+            if (budget <= 0) budget = SCHED_BASE_BUDGET;
+        }
+        else if (strcmp (argv [index], LIST_OPTION) == 0 && index + 1 < argc && list.buffer == nullptr)
+        {
+            err = ReadText (argv [++index], &list);
+            if (err == OK) err = BatchReadList (&batch, &list);
+        }
+        else err = BatchAddJob (&batch, argv [index], nullptr);
+    }
+
+    if (err)
+    {
+        fprintf (ERROR_STREAM, "ERROR: %d\nCannot read the job list.\n", err);
+        FreeText (&list);
+        BatchDtor (&batch);
+        return err;
+    }
+
+    auto start = std::chrono::steady_clock::now ();
+
+    // -s runs every job on this thread, budget instructions at a time
+    if (budget) threads_num = 1;
+
+    err = budget ? BatchSched (&batch, budget) : BatchRun (&batch, threads_num);
+
+    double total_ms = std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+    if (err == OK) BatchReport (&batch, stdout, threads_num, total_ms);
+
+    FreeText (&list);
+    BatchDtor (&batch);
+
+    return err;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+int BatchAddJob (Batch_t *batch, const char *code_file_name, const char *input_file_name)
+{
+    if (batch == nullptr || code_file_name == nullptr) return NULLPTR_ARG;
+
+    if (batch -> num >= batch -> max_num)
+    {
+        size_t old_num = batch -> max_num;
+        size_t new_num = old_num ? old_num * 2 : BASE_JOBS_NUM;
+
+        Job_t *jobs = (Job_t *) Recalloc ((void *) batch -> jobs, new_num, sizeof (Job_t), old_num);
+        if (jobs == nullptr) return ALLOC_ERROR;
+
+        batch -> jobs    = jobs;
+        batch -> max_num = new_num;
+    }
+
+    Job_t *job = batch -> jobs + batch -> num++;
+
+    job ->  code_file_name =  code_file_name;
+    job -> input_file_name = input_file_name;
+
+    return OK;
+}
+
+int BatchReadList (Batch_t *batch, Text *list)
+{
+    if (batch == nullptr || list == nullptr || list -> lines == nullptr) return NULLPTR_ARG;
+
+    for (size_t line = 0; line < list -> len; line++)
+    {
+        // names are cut in place, the list text lives as long as the batch
+        char *ch = list -> lines [line];
+
+        while (isspace (*ch)) ch++;
+        if (*ch == '\0') continue;
+
+        char *code_file_name = ch;
+        while (*ch && !isspace (*ch)) ch++;
+
+        char *input_file_name = nullptr;
+        if (*ch)
+        {
+            *ch++ = '\0';
+            while (isspace (*ch)) ch++;
+
+            if (*ch)
+            {
+                input_file_name = ch;
+                while (*ch && !isspace (*ch)) ch++;
+                *ch = '\0';
+            }
+        }
+
+        int err = BatchAddJob (batch, code_file_name, input_file_name);
+        if (err) return err;
+    }
+
+    return OK;
+}
+
+int BatchRun (Batch_t *batch, unsigned threads_num)
+{
+    if (batch == nullptr) return NULLPTR_ARG;
+
+    if (threads_num > batch -> num) threads_num = (unsigned) batch -> num;
+
+    batch -> next = 0;
+
+    std::thread *workers = new (std::nothrow) std::thread [threads_num];
+    if (workers == nullptr) return ALLOC_ERROR;
+
+    for (unsigned index = 0; index < threads_num; index++) workers [index] = std::thread (BatchWorker, batch);
+    for (unsigned index = 0; index < threads_num; index++) workers [index].join ();
+
+    delete [] workers;
+
+    return OK;
+}
+
+void BatchWorker (Batch_t *batch)
+{
+    FILE *errors = ERROR_STREAM;
+
+    while (1)
+    {
+        size_t index = batch -> next++;
+        if (index >= batch -> num) return;
+
+        Job_t *job = batch -> jobs + index;
+
+        FILE *capture = tmpfile ();
+        if (capture == nullptr)
+        {
+            job -> err = FOPEN_ERROR;
+            continue;
+        }
+
+        ERROR_STREAM = capture;
+
+        auto start = std::chrono::steady_clock::now ();
+
+        job -> err = RunJob (job, capture);
+
+        job -> time_ms = std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+        ERROR_STREAM = errors;                  // not left pointing at a closed file
+
+        ReadCapture (capture, &(job -> output), &(job -> output_len));
+        fclose (capture);
+    }
+}
+
+int BatchSched (Batch_t *batch, long long budget)
+{
+    if (batch == nullptr) return NULLPTR_ARG;
+
+    Sched_t sched = {};
+    SchedCtor (&sched, budget);
+
+    int   *ids    = (int *)   calloc (batch -> num, sizeof (int));
+    FILE **inputs = (FILE **) calloc (batch -> num, sizeof (FILE *));
+    size_t *jobs  = (size_t *) calloc (batch -> num, sizeof (size_t));
+
+    if (ids == nullptr || inputs == nullptr || jobs == nullptr)
+    {
+        free (ids);
+        free (inputs);
+        free (jobs);
+        return ALLOC_ERROR;
+    }
+
+    for (size_t index = 0; index < batch -> num; index++)
+    {
+        Job_t *job = batch -> jobs + index;
+        cmd_t *cmds = nullptr;
+
+        ids [index] = -1;
+
+        if (job -> input_file_name)
+        {
+            inputs [index] = fopen (job -> input_file_name, "rb");
+            if (inputs [index] == nullptr) job -> err = FOPEN_ERROR;
+        }
+
+        // assembler messages belong to the job, as in BatchWorker
+        FILE *capture = tmpfile ();
+        FILE *errors  = ERROR_STREAM;
+
+        if (capture) ERROR_STREAM = capture;
+
+        if (job -> err == OK) job -> err = AssembleImage (job -> code_file_name, &cmds);
+        if (job -> err == OK) job -> err = SchedAdd (&sched, cmds, GetImageSize (cmds), ids + index);
+
+        ERROR_STREAM = errors;
+
+        free (cmds);
+
+        if (job -> err == OK) jobs [ids [index]] = index;
+
+        if (capture && job -> err)
+        {
+            AsmErr (job -> err, capture);
+            ReadCapture (capture, &(job -> output), &(job -> output_len));
+        }
+
+        if (capture) fclose (capture);
+    }
+
+    int err = OK;
+
+    // run whoever is ready, then give the waiting ones their next piece of input
+    while (err == OK)
+    {
+        int id = 0;
+
+        while (1)
+        {
+            auto start = std::chrono::steady_clock::now ();
+
+            err = SchedStep (&sched, &id);
+            if (err || id < 0) break;
+
+            batch -> jobs [jobs [id]].time_ms += std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+        }
+
+        int fed = 0;
+
+        for (size_t index = 0; index < batch -> num && err == OK; index++)
+        {
+            Vm_t *vm = SchedGet (&sched, ids [index]);
+            if (vm == nullptr || vm -> state != VM_BLOCKED) continue;
+
+            err = Batch_feed (&sched, ids [index], inputs + index);
+            fed = 1;
+        }
+
+        if (!fed) break;
+    }
+
+    for (size_t index = 0; index < batch -> num; index++)
+    {
+        Vm_t *vm = SchedGet (&sched, ids [index]);
+        if (vm) Batch_collect (batch -> jobs + index, vm);
+
+        if (inputs [index]) fclose (inputs [index]);
+    }
+
+    SchedDtor (&sched);
+
+    free (ids);
+    free (inputs);
+    free (jobs);
+
+    return err;
+}
+
+int Batch_feed (Sched_t *sched, int id, FILE **inp_file_p)
+{
+    char buf [SCHED_FEED_SIZE] = "";
+
+    size_t got = *inp_file_p ? fread (buf, sizeof (char), SCHED_FEED_SIZE, *inp_file_p) : 0;
+
+    if (got == 0)
+    {
+        if (*inp_file_p) fclose (*inp_file_p);
+        *inp_file_p = nullptr;
+
+        return SchedClose (sched, id);
+    }
+
+    size_t taken = 0;
+
+    int err = SchedFeed (sched, id, buf, got, &taken);
+    if (err) return err;
+
+    // the rest is read again next time
+    if (taken < got) fseek (*inp_file_p, (long) taken - (long) got, SEEK_CUR);
+
+    return OK;
+}
+
+int Batch_collect (Job_t *job, Vm_t *vm)
+{
+    if (job == nullptr || vm == nullptr) return NULLPTR_ARG;
+
+    job -> err = vm -> state == VM_DONE ? vm -> err : RUN_BLOCKED;
+
+    job -> output = (char *) calloc (vm -> cpu.capture_len + ERROR_MSG_SIZE, sizeof (char));
+    if (job -> output == nullptr) return ALLOC_ERROR;
+
+    if (vm -> cpu.capture_len) memcpy (job -> output, vm -> cpu.capture, vm -> cpu.capture_len);
+    job -> output_len = vm -> cpu.capture_len;
+
+    if (job -> err)
+    {
+        int len = snprintf (job -> output + job -> output_len, ERROR_MSG_SIZE, "ERROR: %d\n", job -> err);
+        if (len > 0) job -> output_len += (size_t) len;
+    }
+
+    return OK;
+}
+
+int RunJob (Job_t *job, FILE *out_file)
+{
+    if (job == nullptr || out_file == nullptr) return NULLPTR_ARG;
+
+    struct Cpu_t cpu = {};
+
+    int err = CpuCtor (&cpu);
+
+    FILE *inp_file = nullptr;
+    if (err == OK && job -> input_file_name)
+    {
+        inp_file = fopen (job -> input_file_name, "rb");
+        if (inp_file == nullptr) err = FOPEN_ERROR;
+    }
+
+    cpu.  in_file = inp_file;
+    cpu. out_file = out_file;
+
+    if (err == OK) err = AssembleFile (job -> code_file_name, &cpu);
+
+    if (err == OK)
+    {
+        err = InfoCheck (&cpu);
+        if (err == OK) err = RunCode (&cpu);
+        if (err)       CpuErr (&cpu, err, out_file);
+    }
+    else AsmErr (err, out_file);
+
+    FreeCpu (&cpu);
+    if (inp_file) fclose (inp_file);
+
+    return err;
+}
+
+int AssembleFile (const char *code_file_name, Cpu_t *cpu)
+{
+    if (code_file_name == nullptr || cpu == nullptr) return NULLPTR_ARG;
+
+    cmd_t *cmds = nullptr;
+
+    int err = AssembleImage (code_file_name, &cmds);
+    if (err == OK) err = LoadCode (cpu, cmds, GetImageSize (cmds));
+
+    free (cmds);
+
+    return err;
+}
+
+int AssembleImage (const char *code_file_name, cmd_t **cmds_p)
+{
+    if (code_file_name == nullptr || cmds_p == nullptr) return NULLPTR_ARG;
+
+    struct Text txt = {};
+    Label_list_t label_list = {};
+
+    int err = ReadText (code_file_name, &txt);
+    if (err == OK) err = Compile (&txt, cmds_p, &label_list, 1);     // the jobs are the parallel part
+
+    LabelListDtor (&label_list);
+    FreeText (&txt);
+
+    return err;
+}
+
+int ReadCapture (FILE *capture, char **buf_p, size_t *len_p)
+{
+    if (capture == nullptr || buf_p == nullptr || len_p == nullptr) return NULLPTR_ARG;
+
+    fflush (capture);
+
+    long size = ftell (capture);
+    if (size <= 0) return OK;
+
+    *buf_p = (char *) calloc ((size_t) size + 1, sizeof (char));
+    if (*buf_p == nullptr) return ALLOC_ERROR;
+
+    rewind (capture);
+    *len_p = fread (*buf_p, sizeof (char), (size_t) size, capture);
+
+    return OK;
+}
+
+void BatchReport (Batch_t *batch, FILE *stream, unsigned threads_num, double total_ms)
+{
+    if (batch == nullptr || stream == nullptr) return;
+
+    size_t failed = 0;
+    double jobs_ms = 0;
+
+    for (size_t index = 0; index < batch -> num; index++)
+    {
+        Job_t *job = batch -> jobs + index;
 
-        system (cmd);
-        system ("proc.exe code");
+        fprintf (stream, "[%u] %s", (unsigned) (index + 1), job -> code_file_name);
+        if (job -> input_file_name) fprintf (stream, " < %s", job -> input_file_name);
+
+        if (job -> err) fprintf (stream, ": ERROR %d, %.3lf ms\n", job -> err, job -> time_ms);
+        else            fprintf (stream, ": OK, %.3lf ms\n",                   job -> time_ms);
+
+        if (job -> output_len) fwrite (job -> output, sizeof (char), job -> output_len, stream);
+
+        if (job -> err) failed++;
+        jobs_ms += job -> time_ms;
     }
-    return 0;
-}
\ No newline at end of file
+
+    fprintf (stream, "\n%u jobs, %u failed, %u threads: %.3lf ms wall, %.3lf ms in jobs\n",
+                     (unsigned) batch -> num, (unsigned) failed, threads_num, total_ms, jobs_ms);
+}
+
+void BatchDtor (Batch_t *batch)
+{
+    if (batch == nullptr) return;
+
+    for (size_t index = 0; index < batch -> num; index++) free (batch -> jobs [index].output);
+
+    free (batch -> jobs);
+
+    batch -> jobs    = nullptr;
+    batch -> num     = 0;
+    batch -> max_num = 0;
+}
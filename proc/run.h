@@ -0,0 +1,66 @@
+#ifndef RUN_H
+#define RUN_H
+
+#include <new>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "proc.h"
+#include "sched.h"
+
+
+const char  LIST_OPTION [] = "-l";
+const char SLICE_OPTION [] = "-s";
+
+const size_t SCHED_FEED_SIZE = 512;             // input goes to waiting VMs in pieces of this size
+
+const size_t BASE_JOBS_NUM = 16;
+
+struct Job_t
+{
+    const char *code_file_name;                 // asm text
+    const char *input_file_name;                // nullptr - program gets EOF on IN
+
+    int err;
+    char  *output;                              // everything the job printed, errors included
+    size_t output_len;
+    double time_ms;
+};
+
+struct Batch_t
+{
+    Job_t *jobs;
+    size_t num;
+    size_t max_num;
+
+    std::atomic <size_t> next;                  // first job nobody has taken yet
+};
+
+
+int BatchAddJob (Batch_t *batch, const char *code_file_name, const char *input_file_name);
+
+int BatchReadList (Batch_t *batch, Text *list);
+
+int BatchRun (Batch_t *batch, unsigned threads_num);
+
+void BatchWorker (Batch_t *batch);
+
+int BatchSched (Batch_t *batch, long long budget);
+
+int Batch_feed (Sched_t *sched, int id, FILE **inp_file_p);
+
+int Batch_collect (Job_t *job, Vm_t *vm);
+
+int RunJob (Job_t *job, FILE *out_file);
+
+int AssembleFile (const char *code_file_name, Cpu_t *cpu);
+
+int AssembleImage (const char *code_file_name, cmd_t **cmds_p);
+
+int ReadCapture (FILE *capture, char **buf_p, size_t *len_p);
+
+void BatchReport (Batch_t *batch, FILE *stream, unsigned threads_num, double total_ms);
+
+void BatchDtor (Batch_t *batch);
+
+#endif
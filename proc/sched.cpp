@@ -0,0 +1,200 @@
+#include "sched.h"
+
+
+int SchedCtor (Sched_t *sched, long long budget)
+{
+    if (sched == nullptr) return NULLPTR_ARG;
+
+    sched -> vms     = nullptr;
+    sched -> num     = 0;
+    sched -> max_num = 0;
+
+    sched -> queue = nullptr;
+    sched -> head  = 0;
+    sched -> len   = 0;
+
+    sched -> budget = budget > 0 ? budget : SCHED_BASE_BUDGET;
+
+    return OK;
+}
+
+void SchedDtor (Sched_t *sched)
+{
+    if (sched == nullptr) return;
+
+    for (size_t id = 0; id < sched -> num; id++)
+    {
+        FreeCpu (&(sched -> vms [id] -> cpu));
+        free (sched -> vms [id]);
+    }
+
+    free (sched -> vms);
+    free (sched -> queue);
+
+    sched -> vms     = nullptr;
+    sched -> queue   = nullptr;
+    sched -> num     = 0;
+    sched -> max_num = 0;
+    sched -> len     = 0;
+}
+
+// the image is copied, the caller keeps it
+int SchedAdd (Sched_t *sched, const cmd_t *image, size_t words, int *id_p)
+{
+    if (sched == nullptr || image == nullptr || id_p == nullptr) return NULLPTR_ARG;
+
+    if (sched -> num >= sched -> max_num)
+    {
+        int err = Sched_grow (sched);
+        if (err) return err;
+    }
+
+    Vm_t *vm = (Vm_t *) calloc (1, sizeof (Vm_t));
+    if (vm == nullptr) return ALLOC_ERROR;
+
+    int err = CpuCtor (&(vm -> cpu));
+    if (err == OK) err = LoadCode (&(vm -> cpu), image, words);
+    if (err == OK) err = InfoCheck (&(vm -> cpu));
+
+    if (err)
+    {
+        FreeCpu (&(vm -> cpu));
+        free (vm);
+        return err;
+    }
+
+    vm -> cpu.  in_file = nullptr;
+    vm -> cpu. out_file = nullptr;
+    vm -> cpu.  in_wait = 1;
+
+    vm -> state = VM_READY;
+
+    int id = (int) sched -> num++;
+    sched -> vms [id] = vm;
+
+    Sched_push (sched, id);
+
+    *id_p = id;
+    return OK;
+}
+
+// runs one slice of the first ready VM, *id_p is -1 when nobody is ready
+int SchedStep (Sched_t *sched, int *id_p)
+{
+    if (sched == nullptr || id_p == nullptr) return NULLPTR_ARG;
+
+    *id_p = -1;
+    if (sched -> len == 0) return OK;
+
+    int id = sched -> queue [sched -> head];
+    sched -> head = (sched -> head + 1) % sched -> max_num;
+    sched -> len--;
+
+    Vm_t *vm = sched -> vms [id];
+
+    int res = RunCodeSlice (&(vm -> cpu), sched -> budget);
+    vm -> slices++;
+
+    if (res == RUN_YIELD) Sched_push (sched, id);
+    else
+    {
+        FlushOut (&(vm -> cpu));                // what it printed before waiting is seen at once
+
+        if (res == RUN_BLOCKED) vm -> state = VM_BLOCKED;
+        else
+        {
+            vm -> state = VM_DONE;
+            vm -> err   = res;
+        }
+    }
+
+    *id_p = id;
+    return OK;
+}
+
+int SchedRun (Sched_t *sched)
+{
+    int id = 0;
+
+    while (1)
+    {
+        int err = SchedStep (sched, &id);
+        if (err) return err;
+
+        if (id < 0) return OK;
+    }
+}
+
+int SchedFeed (Sched_t *sched, int id, const char *str, size_t len, size_t *taken_p)
+{
+    if (str == nullptr || taken_p == nullptr) return NULLPTR_ARG;
+
+    Vm_t *vm = SchedGet (sched, id);
+    if (vm == nullptr) return NULLPTR_ARG;
+
+    // a finished program drops its input
+    *taken_p = vm -> state == VM_DONE ? len : CpuFeed (&(vm -> cpu), str, len);
+
+    if (vm -> state == VM_BLOCKED && *taken_p > 0)
+    {
+        vm -> state = VM_READY;
+        Sched_push (sched, id);
+    }
+
+    return OK;
+}
+
+// no more input, IN gets EOF from now on
+int SchedClose (Sched_t *sched, int id)
+{
+    Vm_t *vm = SchedGet (sched, id);
+    if (vm == nullptr) return NULLPTR_ARG;
+
+    vm -> cpu.in_eof = 1;
+
+    if (vm -> state == VM_BLOCKED)
+    {
+        vm -> state = VM_READY;
+        Sched_push (sched, id);
+    }
+
+    return OK;
+}
+
+Vm_t *SchedGet (Sched_t *sched, int id)
+{
+    if (sched == nullptr || id < 0 || (size_t) id >= sched -> num) return nullptr;
+
+    return sched -> vms [id];
+}
+
+int Sched_grow (Sched_t *sched)
+{
+    size_t old_num = sched -> max_num;
+    size_t new_num = old_num ? old_num * 2 : SCHED_BASE_VMS_NUM;
+
+    Vm_t **vms = (Vm_t **) Recalloc ((void *) sched -> vms, new_num, sizeof (Vm_t *), old_num);
+    if (vms == nullptr) return ALLOC_ERROR;
+    sched -> vms = vms;
+
+    // the ring is unrolled into the new queue, so head goes back to 0
+    int *queue = (int *) calloc (new_num, sizeof (int));
+    if (queue == nullptr) return ALLOC_ERROR;
+
+    for (size_t index = 0; index < sched -> len; index++)
+        queue [index] = sched -> queue [(sched -> head + index) % old_num];
+
+    free (sched -> queue);
+
+    sched -> queue   = queue;
+    sched -> head    = 0;
+    sched -> max_num = new_num;
+
+    return OK;
+}
+
+void Sched_push (Sched_t *sched, int id)
+{
+    sched -> queue [(sched -> head + sched -> len) % sched -> max_num] = id;
+    sched -> len++;
+}
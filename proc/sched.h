@@ -0,0 +1,64 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "proc.h"
+
+
+// Cooperative scheduler: many VMs on one thread, each runs a budget of instructions and
+// goes to the back of the run queue. A VM that reads past its input waits until SchedFeed.
+
+const long long SCHED_BASE_BUDGET  = 1000;     // instructions per slice
+const size_t    SCHED_BASE_VMS_NUM = 16;
+
+enum VM_STATES
+{
+    VM_READY   = 0,                             // in the run queue
+    VM_BLOCKED = 1,                             // waits for SchedFeed or SchedClose
+    VM_DONE    = 2,                             // halted or failed, see err
+};
+
+struct Vm_t
+{
+    Cpu_t cpu;                                  // output is kept in cpu.capture
+
+    int state;
+    int err;
+
+    unsigned long long slices;
+};
+
+struct Sched_t
+{
+    Vm_t **vms;                                 // id is the index
+    size_t num;
+    size_t max_num;
+
+    int   *queue;                               // ring of ready ids, max_num long
+    size_t head;
+    size_t len;
+
+    long long budget;
+};
+
+
+int SchedCtor (Sched_t *sched, long long budget);
+
+void SchedDtor (Sched_t *sched);
+
+int SchedAdd (Sched_t *sched, const cmd_t *image, size_t words, int *id_p);
+
+int SchedStep (Sched_t *sched, int *id_p);
+
+int SchedRun (Sched_t *sched);
+
+int SchedFeed (Sched_t *sched, int id, const char *str, size_t len, size_t *taken_p);
+
+int SchedClose (Sched_t *sched, int id);
+
+Vm_t *SchedGet (Sched_t *sched, int id);
+
+int Sched_grow (Sched_t *sched);
+
+void Sched_push (Sched_t *sched, int id);
+
+#endif
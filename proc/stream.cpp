@@ -0,0 +1,72 @@
+#include "stream.h"
+
+
+size_t GetSize (FILE *inp_file)
+{
+    if (inp_file == nullptr) return 0;
+    struct stat stat_buf = {};
+
+    fstat (fileno (inp_file), &stat_buf);
+    return stat_buf.st_size;
+}
+
+FILE *OpenStream (const char *file_name, const char *mode)
+{
+    if (file_name == nullptr || mode == nullptr) return nullptr;
+
+    if (strcmp (file_name, STD_STREAM) != 0) return fopen (file_name, mode);
+
+    FILE *file = *mode == 'r' ? stdin : stdout;
+
+#ifdef _WIN32
+    // code goes through the std streams byte for byte
+    if (strchr (mode, 'b')) _setmode (_fileno (file), _O_BINARY);
+#endif
+
+    return file;
+}
+
+void CloseStream (FILE *file)
+{
+    if (file == nullptr || file == stdin) return;
+
+    if (file == stdout) fflush (file);
+    else                fclose (file);
+}
+
+// reads up to EOF, pipes have no size to stat; pad zero bytes go before the data and one after it
+char *ReadStream (FILE *file, size_t pad, size_t *len_p)
+{
+    if (file == nullptr) return nullptr;
+
+    // a regular file fits at once, the spare byte lets fread see EOF without growing the buffer
+    size_t max_len = GetSize (file) + 1;
+    if (max_len < STREAM_CHUNK) max_len = STREAM_CHUNK;
+
+    char *buf = (char *) calloc (pad + max_len + 1, sizeof (char));
+    if (buf == nullptr) return nullptr;
+
+    size_t len = 0;
+    size_t got = 0;
+
+    while ((got = fread (buf + pad + len, sizeof (char), max_len - len, file)) > 0)
+    {
+        len += got;
+        if (len < max_len) continue;
+
+        char *new_buf = (char *) realloc (buf, pad + max_len * 2 + 1);
+        if (new_buf == nullptr)
+        {
+            free (buf);
+            return nullptr;
+        }
+
+        buf      = new_buf;
+        max_len *= 2;
+    }
+
+    buf [pad + len] = '\0';
+    if (len_p) *len_p = len;
+
+    return buf;
+}
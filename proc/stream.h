@@ -0,0 +1,29 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+
+const char   STD_STREAM [] = "-";               // file name for stdin or stdout, so stages can be piped
+const size_t STREAM_CHUNK  = 4096;
+
+
+size_t GetSize (FILE *inp_file);
+
+FILE *OpenStream (const char *file_name, const char *mode);
+
+void CloseStream (FILE *file);
+
+char *ReadStream (FILE *file, size_t pad, size_t *len_p);
+
+
+#endif
@@ -6,18 +6,14 @@ int ReadText (const char *input_file_name, struct Text *txt)
     if (input_file_name == nullptr) return NULLPTR_ARG;
     if             (txt == nullptr) return NULLPTR_ARG;
 
-    FILE *inp_file = fopen (input_file_name, "r");
+    FILE *inp_file = OpenStream (input_file_name, "r");
     if (inp_file == nullptr) return FOPEN_ERROR;
 
-    size_t filesize = GetSize (inp_file);
+    txt -> buffer = ReadStream (inp_file, 0, &(txt -> buflen));
 
-    txt -> buffer = (char *) calloc (filesize + 1, sizeof((txt -> buffer)[0]));
-    if ((txt -> buffer) == nullptr) return ALLOC_ERROR;
+    CloseStream (inp_file);
 
-    txt -> buflen = fread (txt -> buffer, sizeof((txt -> buffer)[0]), filesize, inp_file);
-    *(txt -> buffer + txt -> buflen) = '\0';
-    
-    fclose (inp_file);
+    if ((txt -> buffer) == nullptr) return ALLOC_ERROR;
 
     txt -> len = CharReplace (txt -> buffer, '\n', '\0') + 1;
 
@@ -43,15 +39,6 @@ size_t CharReplace (char *str, char ch1, char ch2)
     return count;
 }
 
-size_t GetSize (FILE *inp_file)
-{
-    if (inp_file == nullptr) return 0;
-    struct stat stat_buf = {};
-
-    fstat (fileno (inp_file), &stat_buf);
-    return stat_buf.st_size;
-}
-
 int SetLines (struct Text *txt)
 {
     if (txt           == nullptr) return NULLPTR_ARG;
@@ -10,6 +10,7 @@
 #include <math.h>
 #include <time.h>
 
+#include "stream.h"
 
 struct Text
 {
@@ -42,6 +43,9 @@ enum ERRORS
     INCORRECT_JMP_IP     = 15,
     EMPTY_CALL_STACK     = 16,
     SQRT_OF_NEG          = 17,
+    RECORDS_FAILED       = 18,
+    LINK_ERROR           = 19,
+    RECORD_TOO_LONG      = 20,
 };
 
 #endif
@@ -49,8 +53,6 @@ enum ERRORS
 
 int ReadText (const char *input_file_name, struct Text *txt);
 
-size_t GetSize (FILE *inp_file);
-
 size_t CharReplace (char *str, char ch1, char ch2);
 
 void FreeText (struct Text *txt);
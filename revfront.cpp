@@ -9,6 +9,7 @@ int GenerateText (Prog_t *prog, const char *filename)
     FILE *temp = fopen (TEMPFILENAME, "w");
     if (temp == nullptr) return TREE_NULLPTR_ARG;
 
+    Reverse_imports (prog, temp);
     Reverse (prog, temp, (prog -> tree).data.left);
 
     fclose (temp);
@@ -48,60 +49,118 @@ int ReverseFile (const char *in_name, const char *out_name)
     return TREE_OK;
 }
 
+int Reverse_imports (Prog_t *prog, FILE *file)
+{
+    for (size_t index = 0; index < prog -> func_table_size; index++)
+    {
+        Func_t *func = prog -> func_table + index;
+        if (func -> is_defined) continue;
+
+        // argument names of an import are not kept, only their number
+        fprintf (file, "@%s {", func -> name);
+        for (int arg = 0; arg < func -> num_of_args; arg++) fprintf (file, " _");
+        fprintf (file, " } ,.\n");
+    }
+
+    return TREE_OK;
+}
+
 int Reverse (Prog_t *prog, FILE *file, TreeElem_t *elem)
 {
-    if (elem == nullptr) return COMP_OK;
+    Walk_ctx_t ctx = {prog, file};
+
+    return TreeWalk (elem, Reverse_step, &ctx, 0);
+}
+
+int Reverse_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx)
+{
+    Prog_t *prog = ((Walk_ctx_t *) ctx) -> prog;
+    FILE   *file = ((Walk_ctx_t *) ctx) -> file;
+
+    TreeElem_t *elem = frame -> elem;
 
     switch (TYPE)
     {
     case TYPE_FIC:
-        return Reverse_fic (prog, file, elem);
+        return Reverse_fic (file, frame, child);
+
+    case TYPE_BLOCK:
+        return Reverse_block (file, frame, child);
 
     case TYPE_NUM:
-        return Reverse_num (file, elem);
+        Reverse_num (file, elem);
+        return WALK_DONE;
 
     case TYPE_VAR:
-        return Reverse_var (prog, file, elem);
+        Reverse_var (prog, file, elem);
+        return WALK_DONE;
     
     case TYPE_IF:
-        return Reverse_if (prog, file, elem);
+        return Reverse_if (file, frame, child);
         
     case TYPE_WHILE:
-        return Reverse_while (prog, file, elem);
+        return Reverse_while (file, frame, child);
 
     case TYPE_OP:
-        return Reverse_op (prog, file, elem);
+        return Reverse_op (file, frame, child);
     
     case TYPE_VARDEC:
-        return Reverse_vardec (prog, file, elem);
+        Reverse_vardec (prog, file, elem);
+        return WALK_DONE;
     
     case TYPE_FUNCDEC:
-        return Reverse_funcdec (prog, file, elem);
+        return Reverse_funcdec (prog, file, frame, child);
     
     case TYPE_CALL:
-        return Reverse_call (prog, file, elem);
+        return Reverse_call (prog, file, frame, child);
     
     case TYPE_RETURN:
-        return Reverse_return (prog, file, elem);
+        return Reverse_return (file, frame, child);
 
     default:
         return COMP_ERROR;
     }
 }
 
-int Reverse_fic (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_fic (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    if (L)
-    {   
-        Reverse (prog, file, L);
-        if (LTYPE == TYPE_OP || LTYPE == TYPE_NUM || LTYPE == TYPE_VAR || LTYPE == TYPE_CALL) fprintf (file, " ,.\n");
-    }
-    if (R)
-    {   
-        Reverse (prog, file, R);
-        if (RTYPE == TYPE_OP || RTYPE == TYPE_NUM || RTYPE == TYPE_VAR || RTYPE == TYPE_CALL) fprintf (file, " ,.\n");
+    TreeElem_t *elem = frame -> elem;
+
+    switch (frame -> step)
+    {
+    case 0:
+        child -> elem = L;
+        return WALK_CHILD;
+
+    case 1:
+        if (L) Reverse_end_stmt (file, L);
+        child -> elem = R;
+        return WALK_CHILD;
+
+    default:
+        if (R) Reverse_end_stmt (file, R);
+        return WALK_DONE;
     }
-    return COMP_OK;
+}
+
+int Reverse_block (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
+{
+    TreeElem_t *elem = frame -> elem;
+
+    int index = frame -> step;
+
+    if (index > 0) Reverse_end_stmt (file, STMTS [index - 1]);
+
+    if (index >= NSTMTS) return WALK_DONE;
+
+    child -> elem = STMTS [index];
+    return WALK_CHILD;
+}
+
+// other statements end themselves
+void Reverse_end_stmt (FILE *file, TreeElem_t *elem)
+{
+    if (TYPE == TYPE_OP || TYPE == TYPE_NUM || TYPE == TYPE_VAR || TYPE == TYPE_CALL) fprintf (file, " ,.\n");
 }
 
 int Reverse_num (FILE *file, TreeElem_t *elem)
@@ -156,79 +215,112 @@ int Reverse_var (Prog_t *prog, FILE *file, TreeElem_t *elem)
     return COMP_OK;
 }
 
-int Reverse_if (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_if (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    fprintf (file, "69\n/\n");
-    Reverse (prog, file, RL);
-    fprintf (file, "\\\n{");
-    
-    Reverse (prog, file, L);
-    fprintf (file, "}\n");
+    TreeElem_t *elem = frame -> elem;
 
-    if (RR)
+    switch (frame -> step)
     {
+    case 0:
+        fprintf (file, "69\n/\n");
+        child -> elem = RL;
+        return WALK_CHILD;
+
+    case 1:
+        fprintf (file, "\\\n{");
+        child -> elem = L;
+        return WALK_CHILD;
+
+    case 2:
+        fprintf (file, "}\n");
+        if (!RR) return WALK_DONE;
+
         fprintf (file, "79\n/\n");
-        Reverse (prog, file, RR);
+        child -> elem = RR;
+        return WALK_CHILD;
+
+    default:
         fprintf (file, "\\\n");
+        return WALK_DONE;
     }
-
-    return COMP_OK;
 }
 
-int Reverse_while (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_while (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    fprintf (file, "88888888 {");
-
-    Reverse (prog, file, L);
-    fprintf (file, "}\n/");
+    TreeElem_t *elem = frame -> elem;
 
-    Reverse (prog, file, R);
+    switch (frame -> step)
+    {
+    case 0:
+        fprintf (file, "88888888 {");
+        child -> elem = L;
+        return WALK_CHILD;
 
-    fprintf (file, "\\\n");
+    case 1:
+        fprintf (file, "}\n/");
+        child -> elem = R;
+        return WALK_CHILD;
 
-    return COMP_OK;
+    default:
+        fprintf (file, "\\\n");
+        return WALK_DONE;
+    }
 }
 
-int Reverse_op (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_op (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    if (VAL == OP_IN) return Reverse_in (file);
+    TreeElem_t *elem = frame -> elem;
 
-    if (!R) return Reverse_onearg (prog, file, elem);
-    
-    return Reverse_twoarg (prog, file, elem);
+    if (VAL == OP_IN)
+    {
+        Reverse_in (file);
+        return WALK_DONE;
+    }
 
-    return COMP_ERROR;
+    if (!R) return Reverse_onearg (file, frame, child);
+    
+    return Reverse_twoarg (file, frame, child);
 }
 
-int Reverse_onearg (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_onearg (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    if (VAL == OP_SIN)
+    TreeElem_t *elem = frame -> elem;
+
+    if (frame -> step == 0)
     {
-        fprintf (file, "%s {", REV_SIN_WORD);
-        Reverse (prog, file, L);
-        fprintf (file, "}");
+        fprintf (file, "%s {", VAL == OP_SIN ? REV_SIN_WORD : REV_OP_WORDS [VAL]);
+        child -> elem = L;
+        return WALK_CHILD;
     }
 
-    fprintf (file, "%s {", REV_OP_WORDS [VAL]);
-    Reverse (prog, file, L);
     fprintf (file, "}");
-
-    return COMP_OK;
+    return WALK_DONE;
 }
 
-int Reverse_twoarg (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_twoarg (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    if (LTYPE == TYPE_OP && GetOpRank (LVAL) < GetOpRank (VAL)) fprintf (file, "{");
-    Reverse (prog, file, L);
-    if (LTYPE == TYPE_OP && GetOpRank (LVAL) < GetOpRank (VAL)) fprintf (file, "}");
+    TreeElem_t *elem = frame -> elem;
+
+    switch (frame -> step)
+    {
+    case 0:
+        if (LTYPE == TYPE_OP && GetOpRank (LVAL) < GetOpRank (VAL)) fprintf (file, "{");
+        child -> elem = L;
+        return WALK_CHILD;
+
+    case 1:
+        if (LTYPE == TYPE_OP && GetOpRank (LVAL) < GetOpRank (VAL)) fprintf (file, "}");
     
-    fprintf (file, " %s ", REV_OP_WORDS [VAL]);
+        fprintf (file, " %s ", REV_OP_WORDS [VAL]);
 
-    if (RTYPE == TYPE_OP && GetOpRank (RVAL) < GetOpRank (VAL)) fprintf (file, "{");
-    Reverse (prog, file, R);
-    if (RTYPE == TYPE_OP && GetOpRank (RVAL) < GetOpRank (VAL)) fprintf (file, "}");
+        if (RTYPE == TYPE_OP && GetOpRank (RVAL) < GetOpRank (VAL)) fprintf (file, "{");
+        child -> elem = R;
+        return WALK_CHILD;
 
-    return COMP_OK;
+    default:
+        if (RTYPE == TYPE_OP && GetOpRank (RVAL) < GetOpRank (VAL)) fprintf (file, "}");
+        return WALK_DONE;
+    }
 }
 
 int Reverse_in (FILE *file)
@@ -244,72 +336,90 @@ int Reverse_vardec (Prog_t *prog, FILE *file, TreeElem_t *elem)
     return COMP_OK;
 }
 
-int Reverse_funcdec (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_funcdec (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
+    TreeElem_t *elem = frame -> elem;
+
+    if (frame -> step > 0)
+    {
+        fprintf (file, "\\\n");
+        return WALK_DONE;
+    }
+
     fprintf (file, "^%s {", (prog -> func_table [VAL]).name);
     Reverse_decargs (prog, file, L);
     fprintf (file, "}\n/\n");
-    Reverse (prog, file, R);
-    fprintf (file, "\\\n");
 
-    return COMP_OK;
+    child -> elem = R;
+    return WALK_CHILD;
 }
 
+// the arguments are variables, no walk needed
 int Reverse_decargs (Prog_t *prog, FILE *file, TreeElem_t *elem)
 {
-    if (elem == nullptr) return COMP_OK;
-
-    if (TYPE == TYPE_FIC)
+    for (TreeElem_t *link = Reverse_first_arg (elem); link; link = Reverse_next_arg (link, elem))
     {
-        Reverse_decargs (prog, file, L);
-        Reverse_decargs (prog, file, R);
-    }
-    else
-    {
-        Reverse (prog, file, elem);
+        if (link -> type != TYPE_FIC) Reverse_var (prog, file, link);
+        else if (link -> right)       Reverse_var (prog, file, link -> right);
+        else continue;
+
         fprintf (file, " ");
     }
     return COMP_OK;
 }
 
-int Reverse_call (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_call (Prog_t *prog, FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    fprintf (file, "<%s {", (prog -> func_table [VAL]).name);
+    TreeElem_t *elem = frame -> elem;
 
-    int first_arg = 1;
+    if (frame -> step == 0)
+    {
+        fprintf (file, "<%s {", (prog -> func_table [VAL]).name);
+        frame -> cursor = Reverse_first_arg (L);
+    }
 
-    Reverse_callargs (prog, file, L, &first_arg);
+    while (frame -> cursor && frame -> cursor -> type == TYPE_FIC && !(frame -> cursor -> right))
+        frame -> cursor = Reverse_next_arg (frame -> cursor, L);
 
-    fprintf (file, "}");
-    
-    return COMP_OK;
+    if (frame -> cursor == nullptr)
+    {
+        fprintf (file, "}");
+        return WALK_DONE;
+    }
+
+    // arg: an argument is printed already
+    if (frame -> arg) fprintf (file, ",.");
+    frame -> arg = 1;
+
+    child -> elem = frame -> cursor -> type == TYPE_FIC ? frame -> cursor -> right : frame -> cursor;
+    frame -> cursor = Reverse_next_arg (frame -> cursor, L);
+
+    return WALK_CHILD;
 }
 
-int Reverse_callargs (Prog_t *prog, FILE *file, TreeElem_t *elem, int *first_arg)
+// arguments hang off a FIC chain going left, the one at its bottom is printed first
+TreeElem_t *Reverse_first_arg (TreeElem_t *elem)
 {
-    if (elem == nullptr) return COMP_OK;
+    while (elem && TYPE == TYPE_FIC && L) elem = L;
+    return elem;
+}
 
-    if (TYPE == TYPE_FIC)
-    {
-        Reverse_callargs (prog, file, L, first_arg);
-        Reverse_callargs (prog, file, R, first_arg);
-    }
-    else
-    {
-        if (*first_arg) *first_arg = 0;
-        else fprintf (file, ",.");
-        Reverse (prog, file, elem);
-    }
-    return COMP_OK;
+TreeElem_t *Reverse_next_arg (TreeElem_t *link, TreeElem_t *top)
+{
+    return link == top ? nullptr : link -> parent;
 }
 
-int Reverse_return (Prog_t *prog, FILE *file, TreeElem_t *elem)
+int Reverse_return (FILE *file, TreeWalk_t *frame, TreeWalk_t *child)
 {
-    fprintf (file, "> {");
-    Reverse (prog, file, L);
-    fprintf (file, "} ,.\n");
+    if (frame -> step == 0)
+    {
+        fprintf (file, "> {");
+        child -> elem = frame -> elem -> left;
+        return WALK_CHILD;
+    }
 
-    return COMP_OK;
+    fprintf (file, "} ,.\n");
+    return WALK_DONE;
 }
 
 void Dec_to_rev_tern (int num, char *buf)
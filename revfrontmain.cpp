@@ -4,18 +4,25 @@ FILE *LOG = NULL;
 
 int main (int argc, char *argv [])
 {
-    LOG = fopen (LOGFILENAME, "w");
-    if (LOG == nullptr) return 0;
-    fprintf (LOG, "<pre>\n");
+    const char *file_args [2] = {};
+    int     file_args_num = 0;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if (TreeDumpOption (argv [index])) continue;
+        if (file_args_num < 2) file_args [file_args_num++] = argv [index];
+    }
+
+    TreeDumpStart ();
 
     const char * input_file_name = nullptr;
     const char *output_file_name = nullptr;
 
-    if (argc >= 2)  input_file_name = argv [1];
-    else            input_file_name = "save.txt";
+    if (file_args_num >= 1)  input_file_name = file_args [0];
+    else                     input_file_name = "save.txt";
 
-    if (argc >= 3) output_file_name = argv [2];
-    else           output_file_name = "revprog.txt";
+    if (file_args_num >= 2) output_file_name = file_args [1];
+    else                    output_file_name = "revprog.txt";
 
     Prog_t prog = {};
     ProgCtor (&prog);
@@ -27,6 +34,6 @@ int main (int argc, char *argv [])
 
     ProgDtor (&prog);
 
-    fclose (LOG);
+    TreeDumpFinish ();
     return 0;
 }
\ No newline at end of file
@@ -6,36 +6,37 @@
 #include <stdlib.h>
 
 
-#ifdef CANARY_PROT
-#undef CANARY_PROT
-#endif
-#ifdef   HASH_PROT
-#undef   HASH_PROT
-#endif 
-
-#ifdef CAN
-    #define CANARY_PROT 1
-#else
-    #define CANARY_PROT 0
-#endif
-
-#ifdef HASH
-    #define   HASH_PROT 2
-#else
-    #define   HASH_PROT 0
+// Checking policies, each one does what the previous does and more:
+//   Stack_none_t   - no checks at all, push and pop are plain array operations
+//   Stack_canary_t - canaries around the struct and the data, poison in free cells, StackError on every call
+//   Stack_hash_t   - and hashes of the struct and the data; the data hash is a rolling one, O(1) a push or pop,
+//                    compared with the data in full on StackRevalidate and once every capacity operations
+//   Stack_dump_t   - and a dump to LOG_FILE_NAME on every call
+// Release builds (NDEBUG) get Stack_none_t, others Stack_dump_t; -DSTACK_POLICY=Stack_hash_t picks another one.
+
+struct Stack_none_t   { enum { CANARY = 0, HASH = 0, DUMP = 0 }; };
+struct Stack_canary_t { enum { CANARY = 1, HASH = 0, DUMP = 0 }; };
+struct Stack_hash_t   { enum { CANARY = 1, HASH = 1, DUMP = 0 }; };
+struct Stack_dump_t   { enum { CANARY = 1, HASH = 1, DUMP = 1 }; };
+
+#ifndef STACK_POLICY
+    #ifdef NDEBUG
+        #define STACK_POLICY Stack_none_t
+    #else
+        #define STACK_POLICY Stack_dump_t
+    #endif
 #endif
 
 
 #define StackCtor(stk, capacity) StackConstructor (stk, capacity, #stk, __PRETTY_FUNCTION__, __FILE__, __LINE__)
 
-#define AssertOK(stk) do {int _assert_ok_err = StackError ((stk));                   \
-                          Dump((stk), LOG_FILE_NAME);                                \
+#define AssertOK(stk) do {if (!Policy::CANARY) break;                                \
+                          int _assert_ok_err = StackError ((stk));                   \
+                          if (Policy::DUMP) Dump((stk), LOG_FILE_NAME);              \
                           if (_assert_ok_err != 0) return (stk) -> error;} while (0);
 
-#define Dump(stk, filename) StackDump (stk, filename, __PRETTY_FUNCTION__, __FILE__, __LINE__); 
-
+#define Dump(stk, filename) StackDump (stk, filename, __PRETTY_FUNCTION__, __FILE__, __LINE__);
 
-typedef int Elem_t;
 
 typedef unsigned long long Canary_t;
 
@@ -43,10 +44,21 @@ const char *const LOG_FILE_NAME = "stacklog.txt";
 
 const size_t BASE_CAPACITY = 4; // sets in StackPush if capacity = 0
 
+// a full stack doubles; pops never shrink it, StackTrim does once no more than a quarter is used,
+// so a size going back and forth over a power of two does not reallocate every few operations
+const size_t STACK_GROW_FACTOR = 2;
+const size_t STACK_TRIM_RATIO  = 4;
+
 const Canary_t CANARY = 0xEEE228ABCDEF1234;
 
+// data_hash = sum of Stack_elem_hash (data [i]) * BASE^i over the live elements, mod 2^64;
+// the base is odd, so a pop can step the power back with its inverse
+const unsigned long long STACK_HASH_BASE     = 0x100000001B3;
+const unsigned long long STACK_HASH_BASE_INV = 0xCE965057AFF6957B;
 
-const Elem_t       POISON_ELEM = (Elem_t) 7 - 1000;
+
+const int          POISON_ELEM = 7 - 1000;
+const int          POISON_BYTE = 0xEE;      // elements other than int are poisoned byte by byte
 const size_t       POISON_SIZE = -73;
 const void *const  POISON_PTR  = (void *) 3;
 
@@ -59,56 +71,32 @@ struct StackInfo_t
     int              line;
 };
 
+template <typename Elem, typename Policy = STACK_POLICY>
 struct Stack_t
 {
-    #ifdef CANARY_PROT
-    Canary_t leftcan;
-    #endif
+    typedef Elem Elem_type;
+
+    Canary_t leftcan;                           // canaries and hashes are only set by the policies using them
 
-    #ifdef HASH_PROT
     int struct_hash;
-    int   data_hash;
-    #endif
+    unsigned long long data_hash;
+    unsigned long long hash_pow;                // STACK_HASH_BASE^size
+    size_t         hash_countdown;              // operations left until the next full check
 
     int status;
 
     struct StackInfo_t info;
 
-    Elem_t *data;
+    Elem   *data;
     size_t  size;
     size_t capacity;
-    
+    size_t min_capacity;                        // StackTrim never shrinks below it: the initial or reserved capacity
+
     int error;
 
-    #ifdef CANARY_PROT
     Canary_t rightcan;
-    #endif
 };
 
-int StackConstructor (struct Stack_t *stk, size_t capacity, const char *name, const char *func_name, const char *file_name, int line);
-
-int StackDtor (struct Stack_t *stk);
-
-int StackPush (struct Stack_t *stk, Elem_t elem);
-
-int StackPop (struct Stack_t *stk, Elem_t *value);
-
-int StackResize (struct Stack_t *stk, size_t capacity, int param);
-
-int StackError (struct Stack_t *stk);
-
-void StackDump (struct Stack_t *stk, const char *filename, const char *func_name, const char *file_name, int line);
-
-void* Recalloc(void *memptr, size_t num, size_t size, size_t old_num);
-
-int GetHash (char *ptr, size_t len);
-
-void SetHash (struct Stack_t *stk);
-
-int CheckStructHash (struct Stack_t *stk);
-
-int CheckDataHash (struct Stack_t *stk);
-
 enum STACKERRORS
 {
     ACCESS_ERROR =  1,
@@ -121,8 +109,8 @@ enum STACKERRORS
 
 enum STACKSTATUS
 {
-    CREATED        = 0, 
-    CONSTRUCTED    = 1, 
+    CREATED        = 0,
+    CONSTRUCTED    = 1,
     DECONSTRUCTED  = 2,
 };
 
@@ -132,4 +120,546 @@ enum RESIZE_PARAMS
         SET_HASH = 1,
 };
 
-#endif
\ No newline at end of file
+
+void* Recalloc(void *memptr, size_t num, size_t size, size_t old_num);
+
+int GetHash (const char *ptr, size_t len);
+
+unsigned long long Stack_elem_hash (const void *elem, size_t len);
+
+void StackPrintElem (FILE *log, int elem);
+
+
+template <typename Elem, typename Policy>
+int StackConstructor (Stack_t <Elem, Policy> *stk, size_t capacity, const char *name, const char *func_name, const char *file_name, int line);
+
+template <typename Elem, typename Policy>
+int StackDtor (Stack_t <Elem, Policy> *stk);
+
+template <typename Elem, typename Policy>
+int StackPush (Stack_t <Elem, Policy> *stk, typename Stack_t <Elem, Policy>::Elem_type value);
+
+template <typename Elem, typename Policy>
+int StackPop (Stack_t <Elem, Policy> *stk, typename Stack_t <Elem, Policy>::Elem_type *value);
+
+template <typename Elem, typename Policy>
+int StackResize (Stack_t <Elem, Policy> *stk, size_t capacity, int param);
+
+template <typename Elem, typename Policy>
+int StackReserve (Stack_t <Elem, Policy> *stk, size_t capacity);
+
+template <typename Elem, typename Policy>
+int StackTrim (Stack_t <Elem, Policy> *stk);
+
+template <typename Elem, typename Policy>
+int StackError (Stack_t <Elem, Policy> *stk);
+
+template <typename Elem, typename Policy>
+int StackRevalidate (Stack_t <Elem, Policy> *stk);
+
+template <typename Elem, typename Policy>
+void StackDump (Stack_t <Elem, Policy> *stk, const char *filename, const char *func_name, const char *file_name, int line);
+
+template <typename Elem, typename Policy>
+void Stack_dump_body (Stack_t <Elem, Policy> *stk, FILE *log);
+
+template <typename Elem, typename Policy>
+void SetHash (Stack_t <Elem, Policy> *stk);
+
+template <typename Elem, typename Policy>
+int CheckStructHash (Stack_t <Elem, Policy> *stk);
+
+template <typename Elem, typename Policy>
+int CheckDataHash (Stack_t <Elem, Policy> *stk);
+
+template <typename Elem, typename Policy>
+void Stack_hash_push (Stack_t <Elem, Policy> *stk, const Elem *elem);
+
+template <typename Elem, typename Policy>
+void Stack_hash_pop (Stack_t <Elem, Policy> *stk, const Elem *elem);
+
+template <typename Elem, typename Policy>
+void Stack_hash_tick (Stack_t <Elem, Policy> *stk);
+
+
+//---------------------------------------------------------------------------------------------------------------------
+
+template <typename Elem>
+inline Elem StackPoison (void)
+{
+    Elem elem;
+    memset ((void *) &elem, POISON_BYTE, sizeof (Elem));
+
+    return elem;
+}
+
+template <>
+inline int StackPoison <int> (void)
+{
+    return POISON_ELEM;
+}
+
+template <typename Elem>
+int Stack_is_poison (const Elem *elem)
+{
+    Elem poison = StackPoison <Elem> ();
+
+    return memcmp ((const void *) elem, (const void *) &poison, sizeof (Elem)) == 0;
+}
+
+template <typename Elem>
+void StackPrintElem (FILE *log, const Elem &elem)
+{
+    const unsigned char *bytes = (const unsigned char *) &elem;
+
+    for (size_t index = 0; index < sizeof (Elem); index++) fprintf (log, "%02x", bytes [index]);
+}
+
+// the data with canaries around it when the policy wants them; nullptr and the old data kept on failure
+template <typename Elem, typename Policy>
+Elem *Stack_realloc_data (Stack_t <Elem, Policy> *stk, size_t capacity)
+{
+    if (!Policy::CANARY) return (Elem *) Recalloc ((void *) stk -> data, capacity, sizeof (Elem), stk -> data ? stk -> capacity : 0);
+
+    char *raw = stk -> data ? (char *) stk -> data - sizeof (Canary_t) : nullptr;
+    size_t old_len = stk -> data ? stk -> capacity * sizeof (Elem) + 2 * sizeof (Canary_t) : 0;
+
+    raw = (char *) Recalloc ((void *) raw, capacity * sizeof (Elem) + 2 * sizeof (Canary_t), 1, old_len);
+    if (raw == nullptr) return nullptr;
+
+    Elem *data = (Elem *) (raw + sizeof (Canary_t));
+
+    memcpy (raw,                        &CANARY, sizeof (Canary_t));
+    memcpy ((char *) (data + capacity), &CANARY, sizeof (Canary_t));
+
+    return data;
+}
+
+template <typename Elem, typename Policy>
+void Stack_free_data (Stack_t <Elem, Policy> *stk)
+{
+    if (stk -> data == nullptr || stk -> data == POISON_PTR) return;
+
+    if (Policy::CANARY) free ((void *) ((char *) stk -> data - sizeof (Canary_t)));
+    else                free ((void *)           stk -> data);
+}
+
+template <typename Elem, typename Policy>
+int StackConstructor (Stack_t <Elem, Policy> *stk, size_t capacity, const char *name, const char *func_name, const char *file_name, int line)
+{
+    if (stk == nullptr) return ACCESS_ERROR;
+
+    if (stk -> status != CREATED)
+    {
+        stk -> error = STATUS_ERROR;
+        if (Policy::DUMP) Dump (stk, LOG_FILE_NAME);
+        return stk -> error;
+    }
+
+    stk -> info.     name =      name;
+    stk -> info.func_name = func_name;
+    stk -> info.file_name = file_name;
+    stk -> info.     line =      line;
+
+    stk -> data = nullptr;
+    stk -> data = Stack_realloc_data (stk, capacity);
+    if (stk -> data == nullptr) return DATA_ERROR;
+
+    stk -> capacity = capacity;
+    stk -> min_capacity = capacity;
+    stk -> size = 0;
+
+    if (Policy::CANARY)
+    {
+        stk ->  leftcan = CANARY;
+        stk -> rightcan = CANARY;
+
+        for (size_t index = 0; index < capacity; index++)
+            stk -> data[index] = StackPoison <Elem> ();
+    }
+
+    stk -> data_hash      = 0;
+    stk -> hash_pow       = 1;
+    stk -> hash_countdown = capacity + BASE_CAPACITY;
+
+    stk -> status = CONSTRUCTED;
+
+    SetHash (stk);
+
+    AssertOK(stk);
+
+    return 0;
+}
+
+template <typename Elem, typename Policy>
+int StackDtor (Stack_t <Elem, Policy> *stk)
+{
+    AssertOK(stk);
+
+    Stack_free_data (stk);
+
+    stk -> capacity = POISON_SIZE;
+    stk -> size     = POISON_SIZE;
+
+    stk -> data = (Elem*) POISON_PTR;
+
+    stk -> struct_hash = 0;
+    stk ->   data_hash = 0;
+
+    stk -> status = DECONSTRUCTED;
+
+    return 0;
+}
+
+template <typename Elem, typename Policy>
+int StackPush (Stack_t <Elem, Policy> *stk, typename Stack_t <Elem, Policy>::Elem_type value)
+{
+    AssertOK(stk);
+
+    int err = 0;
+
+    if (stk -> size >= stk -> capacity)
+    {
+        if (stk -> capacity == 0) err = StackResize (stk, BASE_CAPACITY                        , NOT_SET_HASH);
+        else                      err = StackResize (stk, stk -> capacity * STACK_GROW_FACTOR, NOT_SET_HASH);
+    }
+
+    if (!err)
+    {
+        (stk -> data)[(stk -> size)++] = value;
+
+        Stack_hash_push (stk, &value);
+        Stack_hash_tick (stk);
+    }
+
+    SetHash (stk);
+
+    AssertOK(stk);
+
+    return err;
+}
+
+template <typename Elem, typename Policy>
+int StackPop (Stack_t <Elem, Policy> *stk, typename Stack_t <Elem, Policy>::Elem_type *value)
+{
+    AssertOK(stk);
+
+    if (stk -> size <= 0) return SIZE_ERROR;
+
+    stk -> size--;
+    if (value) *value = (stk -> data) [stk -> size];
+
+    Stack_hash_pop  (stk, stk -> data + stk -> size);
+    Stack_hash_tick (stk);
+
+    if (Policy::CANARY) stk -> data [stk -> size] = StackPoison <Elem> ();
+
+    SetHash (stk);
+
+    AssertOK(stk);
+
+    return 0;
+}
+
+template <typename Elem, typename Policy>
+int StackResize (Stack_t <Elem, Policy> *stk, size_t capacity, int param)
+{
+    if (param == SET_HASH) AssertOK(stk);
+
+    Elem *data = Stack_realloc_data (stk, capacity);
+    if (data == nullptr) return DATA_ERROR;
+
+    stk -> data = data;
+
+    if (Policy::CANARY && capacity > stk -> capacity)
+    {
+        for (size_t index = stk -> capacity; index < capacity; index++)
+            stk -> data[index] = StackPoison <Elem> ();
+    }
+
+    stk -> capacity = capacity;
+
+    if (param == SET_HASH)
+    {
+        SetHash (stk);
+        AssertOK(stk);
+    }
+
+    return 0;
+}
+
+// capacity is allocated at once and kept, pushes up to it never reallocate
+template <typename Elem, typename Policy>
+int StackReserve (Stack_t <Elem, Policy> *stk, size_t capacity)
+{
+    AssertOK(stk);
+
+    int err = 0;
+    if (capacity > stk -> capacity) err = StackResize (stk, capacity, NOT_SET_HASH);
+
+    if (!err && capacity > stk -> min_capacity) stk -> min_capacity = capacity;
+
+    SetHash (stk);
+
+    AssertOK(stk);
+
+    return err;
+}
+
+// gives memory back after a deep phase: down to twice the size, never below min_capacity
+template <typename Elem, typename Policy>
+int StackTrim (Stack_t <Elem, Policy> *stk)
+{
+    AssertOK(stk);
+
+    int err = 0;
+
+    if (stk -> size * STACK_TRIM_RATIO <= stk -> capacity)
+    {
+        size_t capacity = stk -> size * STACK_GROW_FACTOR;
+        if (capacity < stk -> min_capacity) capacity = stk -> min_capacity;
+
+        if (capacity < stk -> capacity) err = StackResize (stk, capacity, NOT_SET_HASH);
+    }
+
+    SetHash (stk);
+
+    AssertOK(stk);
+
+    return err;
+}
+
+template <typename Elem, typename Policy>
+int StackError (Stack_t <Elem, Policy> *stk)
+{
+    if (stk == NULL) return ACCESS_ERROR;
+
+    if (stk -> status != CONSTRUCTED && stk -> status != CREATED)
+    {
+        stk -> error |=     STATUS_ERROR;
+        return stk -> error;
+    }
+
+    if (Policy::CANARY && (stk -> leftcan != CANARY || stk -> rightcan != CANARY))
+        stk -> error |=     STRUCT_ERROR;
+
+    if (Policy::HASH && !CheckStructHash (stk))
+        stk -> error |=     STRUCT_ERROR;
+
+    if (stk -> data == NULL || stk -> data == POISON_PTR)
+        stk -> error |=     ACCESS_ERROR;
+
+    if (stk -> size > stk -> capacity || stk -> size == POISON_SIZE || stk -> capacity == POISON_SIZE)
+        stk -> error |=       SIZE_ERROR;
+
+    if (Policy::CANARY && !(stk -> error & (ACCESS_ERROR | SIZE_ERROR)))
+    {
+        Canary_t left  = 0;
+        Canary_t right = 0;
+
+        memcpy (&left,  (char *) stk -> data - sizeof (Canary_t),     sizeof (Canary_t));
+        memcpy (&right, (char *) (stk -> data + stk -> capacity), sizeof (Canary_t));
+
+        if (left != CANARY || right != CANARY)
+            stk -> error |=   DATA_ERROR;
+    }
+
+    if (stk -> info.     name == NULL || stk -> info.     name == POISON_PTR ||
+        stk -> info.func_name == NULL || stk -> info.func_name == POISON_PTR ||
+        stk -> info.file_name == NULL || stk -> info.file_name == POISON_PTR ||
+        stk -> info.     line <= 0)
+        stk -> error |=       INFO_ERROR;
+
+    return stk -> error;
+}
+
+// full check, O(size): StackError, the data hash against the data and the poison in free cells
+template <typename Elem, typename Policy>
+int StackRevalidate (Stack_t <Elem, Policy> *stk)
+{
+    if (StackError (stk)) return stk -> error;
+
+    if (!CheckDataHash (stk)) stk -> error |= DATA_ERROR;
+
+    if (Policy::CANARY)
+    {
+        for (size_t index = stk -> size; index < stk -> capacity; index++)
+            if (!Stack_is_poison (stk -> data + index)) stk -> error |= DATA_ERROR;
+    }
+
+    return stk -> error;
+}
+
+template <typename Elem, typename Policy>
+void StackDump (Stack_t <Elem, Policy> *stk, const char *filename, const char *func_name, const char *file_name, int line)
+{
+    #ifndef NDEBUG
+    FILE *log = fopen (filename, "w");
+    if (log == NULL) return;
+
+    if (func_name == NULL) func_name = "NULL";
+    if (file_name == NULL) file_name = "NULL";
+
+    fprintf (log, "%s at %s(%d):\n", func_name, file_name, line);
+
+    Stack_dump_body (stk, log);
+
+    fclose (log);
+    #else
+    (void) stk; (void) filename; (void) func_name; (void) file_name; (void) line;
+    #endif
+    return;
+}
+
+template <typename Elem, typename Policy>
+void Stack_dump_body (Stack_t <Elem, Policy> *stk, FILE *log)
+{
+    if (stk == NULL)
+    {
+        fprintf (log, "stack [NULL] <-- ACCESS ERROR\n");
+        return;
+    }
+
+    fprintf (log, "ERROR: %d\n", stk -> error);
+
+    if (stk -> error & INFO_ERROR)
+    {
+        fprintf (log, "unknown stack [%p] <-- INFO ERROR:", (void *) stk);
+        return;
+    }
+
+    if (stk -> error & STATUS_ERROR)
+    {
+        if      (stk -> status == CREATED)
+            fprintf (log, "\tSTATUS ERROR (STACK HAS NOT BEEN CONSTRUCTED)\n\n");
+        else if (stk -> status == DECONSTRUCTED)
+            fprintf (log, "\tSTATUS ERROR (STACK HAS BEEN DECONSTRUCTED)\n\n");
+        else
+            fprintf (log, "\tSTATUS ERROR (UNDEFINED STATUS)\n\n");
+        return;
+    }
+
+    fprintf (log, "stack [%p] \"%s\" at %s at %s(%d):\n{\n", (void *) stk,
+                                                            stk -> info.     name,
+                                                            stk -> info.func_name,
+                                                            stk -> info.file_name,
+                                                            stk -> info.     line);
+
+    if (stk -> error & STRUCT_ERROR)
+    {
+        fprintf (log, "\tSTRUCT ERROR\n}\n\n");
+        return;
+    }
+
+    if (stk -> size == POISON_SIZE)             fprintf (log, "\tsize     = POISON"                  );
+    else                                        fprintf (log, "\tsize     = %Illu", stk -> size      );
+
+    if (stk -> error & SIZE_ERROR)              fprintf (log, " <-- SIZE ERROR");
+    fprintf (log, "\n");
+
+    if (stk -> size == POISON_SIZE)             fprintf (log, "\tcapacity = POISON\n"                );
+    else                                        fprintf (log, "\tcapacity = %Illu\n", stk -> capacity);
+
+    if (stk -> error & ACCESS_ERROR)
+    {
+        if (stk -> data == POISON_PTR)          fprintf (log, "\tdata [POISON] <-- ACCESS ERROR\n");
+        else                                    fprintf (log, "\tdata [%p] <-- ACCESS ERROR\n", (void *) stk -> data);
+        fprintf (log, "}\n\n");
+        return;
+    }
+    else                                        fprintf (log, "\tdata [%p]\n\t{\n", (void *) stk -> data);
+
+    if (stk -> error & DATA_ERROR)
+    {
+        fprintf (log, "\t\tDATA ERROR\n\t}\n}\n\n");
+        return;
+    }
+
+    for (size_t index = 0; index < stk -> capacity; index++)
+    {
+                                                fprintf (log, index < stk -> size ? "\t\t*" : "\t\t ");
+        if (Stack_is_poison (stk -> data + index)) fprintf (log, "[%Illu] = POISON\n", index);
+        else
+        {
+                                                fprintf (log, "[%Illu] = ", index);
+                                                StackPrintElem (log, stk -> data [index]);
+                                                fprintf (log, "\n");
+        }
+    }
+
+                                                fprintf (log, "\t}\n}\n\n");
+}
+
+template <typename Elem, typename Policy>
+void SetHash (Stack_t <Elem, Policy> *stk)
+{
+    if (!Policy::HASH) return;
+
+    stk -> struct_hash = 0;
+    stk -> struct_hash = GetHash ((char *) stk, sizeof (*stk));
+}
+
+template <typename Elem, typename Policy>
+int CheckStructHash (Stack_t <Elem, Policy> *stk)
+{
+    if (!Policy::HASH) return 1;
+
+    int hashbuf = stk -> struct_hash;
+
+    stk -> struct_hash = 0;
+
+    if (hashbuf != GetHash ((char *) stk, sizeof (*stk))) return 0;
+
+    stk -> struct_hash = hashbuf;
+
+    return 1;
+}
+
+// the rolling hash computed from scratch
+template <typename Elem, typename Policy>
+int CheckDataHash (Stack_t <Elem, Policy> *stk)
+{
+    if (!Policy::HASH) return 1;
+
+    unsigned long long hash = 0;
+    unsigned long long pow  = 1;
+
+    for (size_t index = 0; index < stk -> size; index++)
+    {
+        hash += Stack_elem_hash (stk -> data + index, sizeof (Elem)) * pow;
+        pow  *= STACK_HASH_BASE;
+    }
+
+    return hash == stk -> data_hash && pow == stk -> hash_pow;
+}
+
+template <typename Elem, typename Policy>
+void Stack_hash_push (Stack_t <Elem, Policy> *stk, const Elem *elem)
+{
+    if (!Policy::HASH) return;
+
+    stk -> data_hash += Stack_elem_hash (elem, sizeof (Elem)) * stk -> hash_pow;
+    stk -> hash_pow  *= STACK_HASH_BASE;
+}
+
+template <typename Elem, typename Policy>
+void Stack_hash_pop (Stack_t <Elem, Policy> *stk, const Elem *elem)
+{
+    if (!Policy::HASH) return;
+
+    stk -> hash_pow  *= STACK_HASH_BASE_INV;
+    stk -> data_hash -= Stack_elem_hash (elem, sizeof (Elem)) * stk -> hash_pow;
+}
+
+// a full check once every capacity operations keeps the cost O(1) a push or pop on average
+template <typename Elem, typename Policy>
+void Stack_hash_tick (Stack_t <Elem, Policy> *stk)
+{
+    if (!Policy::HASH || --(stk -> hash_countdown) > 0) return;
+
+    stk -> hash_countdown = stk -> capacity + BASE_CAPACITY;
+
+    if (!CheckDataHash (stk)) stk -> error |= DATA_ERROR;
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "tree.h"
 
+static int VERIFY_LEVEL = -1;                   // -1 until read from VERIFY_ENV
+
 int Tree_ctor (Tree_t *tree, const char *name, const char *func_name, const char *file_name, int line)
 {
     if (tree == nullptr) return TREE_NULLPTR_ARG;
@@ -54,7 +56,7 @@ int TreeDtor (Tree_t *tree)
 
 int TreeFreeData (Tree_t *tree, TreeElem_t *elem)
 {
-    TreeVerify (tree);
+    TreeVerifyEdit (tree, elem);
 
     if (elem == nullptr) return TREE_OK;
 
@@ -65,13 +67,26 @@ int Tree_free_data (TreeElem_t *elem, int *size)
 {
     if (elem == nullptr) return TREE_OK;
 
-    if (L) Tree_free_data (L, size);
-    if (R) Tree_free_data (R, size);
+    Tree_stack_t stk = {};
+    if (StackCtor (&stk, BASE_CAPACITY)) return TREE_ALLOC_ERROR;
 
-    free (elem);
-    if (size) *size -= 1;
+    int err = TREE_OK;
 
-    return TREE_OK;
+    while (elem)
+    {
+        if (Tree_push_children (&stk, elem)) err = TREE_ALLOC_ERROR;
+
+        if (TYPE == TYPE_BLOCK) free (STMTS);
+        free (elem);
+        if (size) *size -= 1;
+
+        elem = nullptr;
+        if (stk.size) StackPop (&stk, &elem);
+    }
+
+    StackDtor (&stk);
+
+    return err;
 }
 
 
@@ -82,7 +97,7 @@ TreeElem_t *TreeAllocElem (void)
 
 int TreeAddElem (Tree_t *tree, TreeElem_t *parent, int position, TreeElem_t *newelem)
 {
-    TreeVerify (tree);
+    TreeVerifyEdit (tree, parent);
 
     if (parent == nullptr || newelem == nullptr) TreeErr (tree, TREE_NULLPTR_ARG);
 
@@ -106,14 +121,94 @@ int TreeAddRight (Tree_t *tree, TreeElem_t *parent, TreeElem_t *newelem)
     return TreeAddElem (tree, parent, RIGHT, newelem);
 }
 
+// left and right for plain nodes, the statements for blocks; TreeChild may be nullptr
+int TreeChildrenNum (TreeElem_t *elem)
+{
+    return TYPE == TYPE_BLOCK ? NSTMTS : 2;
+}
+
+TreeElem_t *TreeChild (TreeElem_t *elem, int index)
+{
+    if (TYPE == TYPE_BLOCK) return index < NSTMTS ? STMTS [index] : nullptr;
+
+    return index == 0 ? L : index == 1 ? R : nullptr;
+}
+
+// pushed last to first, so they are popped in order
+int Tree_push_children (Tree_stack_t *stk, TreeElem_t *elem)
+{
+    int err = 0;
+
+    for (int index = TreeChildrenNum (elem) - 1; index >= 0; index--)
+    {
+        TreeElem_t *child = TreeChild (elem, index);
+        if (child) err |= StackPush (stk, child);
+    }
+
+    return err;
+}
+
+// the whole tree, for phase boundaries; below TREE_VERIFY_PHASE only the header
 int Tree_verify (Tree_t *tree)
 {
+    int level = Tree_verify_level ();
+    if (level == TREE_VERIFY_NONE) return 0;
+
+    if (tree == nullptr) return TREE_NULLPTR_ARG;
+
+    Tree_verify_header (tree);
+
+    if (level < TREE_VERIFY_PHASE) return tree -> err;
+
+    int size = tree -> size;
+
+    if (tree -> data.left)
+        tree -> err |= Tree_verify_data (tree -> data.left, &size);
+
+    if (size != 0) tree -> err |= TREE_INCORRECT_SIZE;
+
+    return tree -> err;
+}
+
+// O(1): the header, elem and its links, for edits inside a phase
+int Tree_verify_edit (Tree_t *tree, TreeElem_t *elem)
+{
+    int level = Tree_verify_level ();
+    if (level == TREE_VERIFY_NONE) return 0;
+    if (level == TREE_VERIFY_FULL) return Tree_verify (tree);
+
+    if (tree == nullptr) return TREE_NULLPTR_ARG;
+
+    Tree_verify_header (tree);
+
+    if (elem) tree -> err |= Tree_verify_node (tree, elem);
+
+    return tree -> err;
+}
+
+void TreeSetVerifyLevel (int level)
+{
+    VERIFY_LEVEL = level;
+}
+
+int Tree_verify_level (void)
+{
+    if (VERIFY_LEVEL >= 0) return VERIFY_LEVEL;
+
     #ifdef NDEBUG
-    return 0;
+    VERIFY_LEVEL = TREE_VERIFY_NONE;
     #else
+    VERIFY_LEVEL = TREE_VERIFY_PHASE;
+    #endif
 
-    if (tree == nullptr) return TREE_NULLPTR_ARG;
+    const char *env = getenv (VERIFY_ENV);
+    if (env != nullptr) VERIFY_LEVEL = atoi (env);
+
+    return VERIFY_LEVEL;
+}
 
+void Tree_verify_header (Tree_t *tree)
+{
     if (tree -> status != TREE_CONSTRUCTED) tree -> err |= TREE_STATUS_ERROR;
     if (tree -> size < 0)                   tree -> err |= TREE_INCORRECT_SIZE;
 
@@ -121,41 +216,67 @@ int Tree_verify (Tree_t *tree)
         tree -> info.file_name == nullptr ||
         tree -> info.func_name == nullptr   ) tree -> err |= TREE_INFO_CORRUPTED;
 
-    int size = tree -> size;
-
     if (tree -> data.right || tree -> data.parent) tree -> err |= TREE_DATA_CORRUPTED;
 
-    if (tree -> data.left)
+    if (tree -> data.left && tree -> data.left -> parent != &(tree -> data)) tree -> err |= TREE_DATA_CORRUPTED;
+}
+
+int Tree_verify_node (Tree_t *tree, TreeElem_t *elem)
+{
+    int err = TREE_OK;
+
+    if (elem != &(tree -> data))
     {
-        if (tree -> data.left -> parent != &(tree -> data)) tree -> err |= TREE_DATA_CORRUPTED;
-        tree -> err |= Tree_verify_data (tree -> data.left, &size);
+        if (VAL == POISON_VAL)                          err |= TREE_DATA_CORRUPTED;
+        if (P == nullptr || (PL != elem && PR != elem && P -> type != TYPE_BLOCK)) err |= TREE_DATA_CORRUPTED;
     }
-    if (size != 0) tree -> err |= TREE_INCORRECT_SIZE;
 
-    return tree -> err;
-    #endif
+    if (L && LP != elem) err |= TREE_DATA_CORRUPTED;
+    if (R && RP != elem) err |= TREE_DATA_CORRUPTED;
+
+    return err;
 }
 
 int Tree_verify_data (TreeElem_t *elem, int *size)
 {
-    if (*size < 0) return TREE_DATA_CORRUPTED;
+    Tree_stack_t stk = {};
+    if (StackCtor (&stk, BASE_CAPACITY)) return TREE_ALLOC_ERROR;
 
     int err = TREE_OK;
 
-    if (VAL == POISON_VAL) err |= TREE_DATA_CORRUPTED;
-
-    if (L)
-    {   
-        if (LP != elem) err |= TREE_DATA_CORRUPTED;
-        err |= Tree_verify_data (L, size);
-    }
-    if (R)
+    while (elem)
     {
-        if (RP != elem) err |= TREE_DATA_CORRUPTED;
-        err |= Tree_verify_data (R, size);
+        // a loop in the links would never end the walk, size runs out first
+        if (*size < 0)
+        {
+            err |= TREE_DATA_CORRUPTED;
+            break;
+        }
+
+        if (VAL == POISON_VAL) err |= TREE_DATA_CORRUPTED;
+
+        if (L && LP != elem) err |= TREE_DATA_CORRUPTED;
+        if (R && RP != elem) err |= TREE_DATA_CORRUPTED;
+
+        if (TYPE == TYPE_BLOCK)
+        {
+            if (L || R || NSTMTS < 0 || NSTMTS > ((TreeBlock_t *) elem) -> capacity) err |= TREE_DATA_CORRUPTED;
+
+            for (int index = 0; index < NSTMTS; index++)
+                if (STMTS [index] == nullptr || STMTS [index] -> parent != elem) err |= TREE_DATA_CORRUPTED;
+        }
+
+        if (err & TREE_DATA_CORRUPTED) break;
+
+        if (Tree_push_children (&stk, elem)) err |= TREE_ALLOC_ERROR;
+
+        *size -= 1;
+
+        elem = nullptr;
+        if (stk.size) StackPop (&stk, &elem);
     }
 
-    *size -= 1;
+    StackDtor (&stk);
 
     return err;
 }
@@ -164,23 +285,66 @@ void Tree_print_error (Tree_t *tree, const char *func_name, const char *file_nam
 {
     int err = tree == nullptr ? TREE_NULLPTR_ARG : tree -> err;
     
-    printf ("\nERROR (%d) in (%s) at (%s) at line (%d).\n", err, func_name, file_name, line);
+    fprintf (stderr, "\nERROR (%d) in (%s) at (%s) at line (%d).\n", err, func_name, file_name, line);
 
     Tree_dump (tree, func_name, file_name, line);
 }
 
 int Tree_get_size (TreeElem_t *elem)
 {
-    if (elem == nullptr) return 0;
+    Tree_stack_t stk = {};
+    if (StackCtor (&stk, BASE_CAPACITY)) return 0;
 
-    int size = 1;
+    int size = 0;
+
+    while (elem)
+    {
+        size++;
 
-    if (L) size += Tree_get_size (L);
-    if (R) size += Tree_get_size (R);
+        Tree_push_children (&stk, elem);
+
+        elem = nullptr;
+        if (stk.size) StackPop (&stk, &elem);
+    }
+
+    StackDtor (&stk);
 
     return size;
 }
 
+// walks the subtree of root on an explicit stack instead of the C one, so its depth is not limited:
+// step gets the node on top with frame -> step counting its calls so far, and returns WALK_CHILD
+// to have child -> elem (if any) walked in full before its next call, WALK_DONE or an error to stop;
+// arg is the root's frame -> arg, the step sets child -> arg for the others
+int TreeWalk (TreeElem_t *root, Tree_step_t step, void *ctx, int arg)
+{
+    if (root == nullptr) return TREE_OK;
+
+    Tree_walk_stack_t stk = {};
+    if (StackCtor (&stk, BASE_CAPACITY)) return TREE_ALLOC_ERROR;
+
+    TreeWalk_t frame = {root, nullptr, 0, arg};
+
+    int err = StackPush (&stk, frame) ? TREE_ALLOC_ERROR : TREE_OK;
+
+    while (err == TREE_OK && stk.size)
+    {
+        TreeWalk_t *top = stk.data + stk.size - 1;
+        TreeWalk_t child = {};
+
+        int ret = step (top, &child, ctx);
+        top -> step++;
+
+        if      (ret == WALK_DONE)  StackPop (&stk, &frame);
+        else if (ret != WALK_CHILD) err = ret;
+        else if (child.elem && StackPush (&stk, child)) err = TREE_ALLOC_ERROR;
+    }
+
+    StackDtor (&stk);
+
+    return err;
+}
+
 TreeElem_t *CreateNode (int type, int value, TreeElem_t *left, TreeElem_t *right)
 {
     TreeElem_t *elem = TreeAllocElem ();
@@ -199,4 +363,45 @@ TreeElem_t *CreateNode (int type, int value, TreeElem_t *left, TreeElem_t *right
 TreeElem_t *CreateOp (int op, TreeElem_t *left, TreeElem_t *right)
 {
     return CreateNode (TYPE_OP, op, left, right);
-}
\ No newline at end of file
+}
+
+TreeElem_t *CreateBlock (int value)
+{
+    TreeBlock_t *block = (TreeBlock_t *) calloc (1, sizeof (TreeBlock_t));
+    if (block == nullptr) return nullptr;
+
+    block -> stmts = (TreeElem_t **) calloc (BLOCK_BASE_CAPACITY, sizeof (TreeElem_t *));
+    if (block -> stmts == nullptr)
+    {
+        free (block);
+        return nullptr;
+    }
+
+    block -> capacity = BLOCK_BASE_CAPACITY;
+
+    block -> elem.type  = TYPE_BLOCK;
+    block -> elem.value = value;
+
+    return &(block -> elem);
+}
+
+int BlockAddStmt (TreeElem_t *elem, TreeElem_t *stmt)
+{
+    if (elem == nullptr || stmt == nullptr) return TREE_NULLPTR_ARG;
+
+    TreeBlock_t *block = (TreeBlock_t *) elem;
+
+    if (block -> size == block -> capacity)
+    {
+        TreeElem_t **stmts = (TreeElem_t **) realloc (block -> stmts, 2 * (size_t) block -> capacity * sizeof (TreeElem_t *));
+        if (stmts == nullptr) return TREE_ALLOC_ERROR;
+
+        block -> stmts     = stmts;
+        block -> capacity *= 2;
+    }
+
+    block -> stmts [block -> size++] = stmt;
+    stmt -> parent = elem;
+
+    return TREE_OK;
+}
@@ -6,11 +6,47 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include "../stack/stack.h"
 
 
 const char *const LOGFILENAME = "log/treelog.html";
 extern FILE *LOG;
 
+const char *const DUMP_OPTION = "--dump";       // --dump for everything, --dump=level for less
+const char *const DUMP_ENV    = "TREE_DUMP";    // level, when there is no option
+
+const size_t DUMP_CMD_SIZE = 4096;              // one dot run renders as many images as fit in a command
+
+const char *const VERIFY_ENV = "TREE_VERIFY";   // verification level, NDEBUG builds default to none, others to phase
+
+enum TREE_VERIFY_LEVELS
+{
+    TREE_VERIFY_NONE  = 0,
+    TREE_VERIFY_LOCAL = 1,                      // tree header, and the nodes around every edit
+    TREE_VERIFY_PHASE = 2,                      // and the whole tree in TreeVerify, at phase boundaries
+    TREE_VERIFY_FULL  = 3,                      // and the whole tree on every edit, O(n) each
+};
+
+enum DUMP_LEVELS
+{
+    DUMP_OFF    = 0,
+    DUMP_TEXT   = 1,                            // text dumps in the log
+    DUMP_IMAGES = 2,                            // and graphviz images, rendered in the background
+};
+
+enum TREE_WALK_RETS
+{
+    WALK_DONE  = -1,                            // the node is finished, back to its parent
+    WALK_CHILD = -2,                            // walk the child in full, then call the step again
+};
+
+// walks push and pop once a node and edit their frames in place, so no dumps and no hashes
+#ifdef NDEBUG
+    #define TREE_STACK_POLICY Stack_none_t
+#else
+    #define TREE_STACK_POLICY Stack_canary_t
+#endif
+
 const int POISON_VAL = 0xE228F3AE;
 
 struct TreeInfo_t
@@ -25,6 +61,7 @@ struct TreeElem_t
 {
     int type;
     int value;
+    int line;       // source line, 0 if unknown
 
     TreeElem_t* parent;
     TreeElem_t*  left;
@@ -41,6 +78,32 @@ struct Tree_t
     TreeElem_t data;
 };
 
+// a statement sequence: the statements in one array instead of a chain of FICs, a node each;
+// left and right stay nullptr, the statements have the block as their parent
+struct TreeBlock_t
+{
+    TreeElem_t elem;                            // first, so a block is a node too
+
+    TreeElem_t **stmts;
+    int size;
+    int capacity;
+};
+
+const int BLOCK_BASE_CAPACITY = 4;
+
+struct TreeWalk_t
+{
+    TreeElem_t *elem;
+    TreeElem_t *cursor;                         // for steps going along a chain below the node
+    int step;                                   // calls of the step on this node so far
+    int arg;                                    // whatever the walk keeps per node: a depth, a label
+};
+
+typedef int (*Tree_step_t) (TreeWalk_t *frame, TreeWalk_t *child, void *ctx);
+
+typedef Stack_t <TreeElem_t *, TREE_STACK_POLICY> Tree_stack_t;
+typedef Stack_t <TreeWalk_t,   TREE_STACK_POLICY> Tree_walk_stack_t;
+
 enum TREESTATUS
 {
     TREE_CREATED       = 0,
@@ -82,6 +145,7 @@ enum NODE_TYPES
     TYPE_FUNCDEC =  8,
     TYPE_CALL    =  9,
     TYPE_RETURN  = 10,
+    TYPE_BLOCK   = 11,                          // a TreeBlock_t
 };
 
 enum OPERATORS
@@ -129,6 +193,9 @@ enum OPERATORS
 #define PL (P ->   left)
 #define PR (P ->  right)
 
+#define STMTS  (((TreeBlock_t *) elem) -> stmts)     // TYPE_BLOCK only
+#define NSTMTS (((TreeBlock_t *) elem) ->  size)
+
 // -----------------------------------------------------------------------
 
 #define TreeCtor(tree) Tree_ctor (tree, #tree, __PRETTY_FUNCTION__, __FILE__, __LINE__)
@@ -144,6 +211,13 @@ enum OPERATORS
                                 return _tree_verify_err;                \
                             }}
 
+#define TreeVerifyEdit(tree, elem) {int _tree_verify_err = Tree_verify_edit (tree, elem);  \
+                                    if (_tree_verify_err)                                   \
+                                    {                                                       \
+                                        TreePrintError (tree);                              \
+                                        return _tree_verify_err;                            \
+                                    }}
+
 #define TreePrintError(tree) Tree_print_error (tree, __PRETTY_FUNCTION__, __FILE__, __LINE__)
 
 #define TreeErr(tree, error)  {tree -> err |= error;   \
@@ -171,8 +245,24 @@ int TreeAddLeft (Tree_t *tree, TreeElem_t *parent, TreeElem_t *newelem);
 
 int TreeAddRight (Tree_t *tree, TreeElem_t *parent, TreeElem_t *newelem);
 
+int TreeChildrenNum (TreeElem_t *elem);
+
+TreeElem_t *TreeChild (TreeElem_t *elem, int index);
+
+int Tree_push_children (Tree_stack_t *stk, TreeElem_t *elem);
+
 int Tree_verify (Tree_t *tree);
 
+int Tree_verify_edit (Tree_t *tree, TreeElem_t *elem);
+
+void TreeSetVerifyLevel (int level);
+
+int Tree_verify_level (void);
+
+void Tree_verify_header (Tree_t *tree);
+
+int Tree_verify_node (Tree_t *tree, TreeElem_t *elem);
+
 int Tree_verify_data (TreeElem_t *elem, int *size);
 
 void Tree_print_error (Tree_t *tree, const char *func_name, const char *file_name, int line);
@@ -183,16 +273,34 @@ void Tree_txt_dmup (Tree_t *tree, FILE *stream, const char *func_name, const cha
 
 void Tree_print_data (FILE *stream, TreeElem_t *elem);
 
+int Tree_print_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx);
+
 void Tree_dump (Tree_t *tree, const char *func_name, const char *file_name, int line);
 
-void Tree_generate_img (Tree_t *tree, int imgnum);
+int TreeDumpOption (const char *arg);
+
+void TreeDumpStart (void);
+
+void TreeDumpFinish (void);
+
+void Tree_render_worker (void);
+
+int Tree_generate_img (Tree_t *tree, int imgnum);
 
 void Tree_draw_data (FILE *graph, TreeElem_t *elem, int rank, int *size, int print_adress);
 
+int Tree_draw_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx);
+
+int TreeWalk (TreeElem_t *root, Tree_step_t step, void *ctx, int arg);
+
 int Tree_get_size (TreeElem_t *elem);
 
 TreeElem_t *CreateNode (int type, int value, TreeElem_t *left, TreeElem_t *right);
 
 TreeElem_t *CreateOp (int op, TreeElem_t *left, TreeElem_t *right);
 
+TreeElem_t *CreateBlock (int value);
+
+int BlockAddStmt (TreeElem_t *block, TreeElem_t *stmt);
+
 #endif
\ No newline at end of file
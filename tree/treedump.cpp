@@ -1,11 +1,16 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "tree.h"
 
 const char *const IMGNUMFILE = "log/imgnum.txt";
-const char *const  GRAPHFILE = "log/graph.txt";
+const char *const  GRAPHFILE = "log/images/dumpimg%d.dot";     // dot -O renders it to dumpimg%d.dot.png
+const size_t   DUMP_NAME_LEN = 64;
 
 const char *const  LEFTCOLOR  = "green";
 const char *const RIGHTCOLOR  =   "red";
 const char *const PARENTCOLOR = "black";
+const char *const   STMTCOLOR =  "blue";
 
 
 const char *const FICCOLOR     = "lightgrey";
@@ -19,12 +24,39 @@ const char *const VARDECCOLOR  = "green";
 const char *const CALLCOLOR    = "orange";
 const char *const FUNCDECCOLOR = "purple";
 const char *const RETURNCOLOR  = "purple";
+const char *const BLOCKCOLOR   = "white";
 
 const char *const COLORS[] = {"lightgrey", "blue", "lightgreen", "lightyellow", "lightyellow", "lightyellow",
-                              "lightblue", "green", "purple", "orange", "purple"};
-const char *const TYPES [] = {"FIC", "NUM", "VAR", "IF", "ELSE", "WHILE", "OP", "VARDEC", "FUNCDEC", "CALL", "RETURN"};
+                              "lightblue", "green", "purple", "orange", "purple", "white"};
+const char *const TYPES [] = {"FIC", "NUM", "VAR", "IF", "ELSE", "WHILE", "OP", "VARDEC", "FUNCDEC", "CALL", "RETURN", "BLOCK"};
 
 
+// images wait here for the render worker, compilation never waits for dot
+struct Dump_state_t
+{
+    int level;
+    int option_set;
+    int imgnum;                                 // next free image number, -1 until read from IMGNUMFILE
+
+    int   *queue;
+    size_t queue_len;
+    size_t queue_max_len;
+    int    stop;
+
+    std::mutex              lock;
+    std::condition_variable ready;
+    std::thread             worker;
+};
+
+static Dump_state_t DUMP = {DUMP_OFF, 0, -1, nullptr, 0, 0, 0, {}, {}, {}};
+
+struct Tree_draw_t
+{
+    FILE *graph;
+    int  *size;                                 // nodes left to draw, a guard against loops in the links
+    int   print_adress;
+};
+
 
 void Tree_txt_dmup (Tree_t *tree, FILE *stream, const char *func_name, const char *file_name, int line)
 {
@@ -58,41 +90,191 @@ void Tree_txt_dmup (Tree_t *tree, FILE *stream, const char *func_name, const cha
 
 void Tree_print_data (FILE *stream, TreeElem_t *elem)
 {
-    fprintf (stream, "(");
-    if (L) Tree_print_data (stream, L);
-    fprintf (stream, "TYPE = %d; VAL = %d", TYPE, VAL);
-    if (R) Tree_print_data (stream, R);
-    fprintf (stream, ")");
+    TreeWalk (elem, Tree_print_step, stream, 0);
+}
+
+int Tree_print_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx)
+{
+    FILE *stream = (FILE *) ctx;
+    TreeElem_t *elem = frame -> elem;
+
+    switch (frame -> step)
+    {
+    case 0:
+        fprintf (stream, "(");
+        if (TYPE == TYPE_BLOCK) fprintf (stream, "TYPE = %d; VAL = %d", TYPE, VAL);
+        child -> elem = TreeChild (elem, 0);
+        return WALK_CHILD;
+
+    case 1:
+        if (TYPE != TYPE_BLOCK) fprintf (stream, "TYPE = %d; VAL = %d", TYPE, VAL);
+        child -> elem = TreeChild (elem, 1);
+        return WALK_CHILD;
+
+    default:
+        if (frame -> step < TreeChildrenNum (elem))
+        {
+            child -> elem = TreeChild (elem, frame -> step);
+            return WALK_CHILD;
+        }
+        fprintf (stream, ")");
+        return WALK_DONE;
+    }
 }
 
 void Tree_dump (Tree_t *tree, const char *func_name, const char *file_name, int line)
 {
+    if (DUMP.level == DUMP_OFF || LOG == nullptr) return;
+
     fprintf (LOG, "<pre>\n");
     Tree_txt_dmup (tree, LOG, func_name, file_name, line);
 
-    if (tree != nullptr)
+    if (tree == nullptr || DUMP.level < DUMP_IMAGES) return;
+
+    if (DUMP.imgnum < 0)
     {
-        int imgnum = 0;
+        DUMP.imgnum = 0;
+
         FILE *numfile = fopen (IMGNUMFILE, "r");
         if (numfile != nullptr)
         {
-            fscanf (numfile, "%d", &imgnum);
+            if (fscanf (numfile, "%d", &DUMP.imgnum) != 1) DUMP.imgnum = 0;
             fclose (numfile);
-            numfile = fopen (IMGNUMFILE, "w");
-            fprintf (numfile, "%d", imgnum + 1);
+        }
+    }
+
+    int imgnum = DUMP.imgnum;
+    if (Tree_generate_img (tree, imgnum)) return;
+
+    DUMP.imgnum++;
+    fprintf (LOG, "<img src=\"./images/dumpimg%d.dot.png\", width=\"80%%\">", imgnum);
+
+    std::lock_guard <std::mutex> guard (DUMP.lock);
+
+    if (DUMP.queue_len == DUMP.queue_max_len)
+    {
+        size_t new_len = DUMP.queue_max_len ? DUMP.queue_max_len * 2 : 16;
+
+        int *queue = (int *) realloc (DUMP.queue, new_len * sizeof (int));
+        if (queue == nullptr) return;
+
+        DUMP.queue         = queue;
+        DUMP.queue_max_len = new_len;
+    }
+
+    DUMP.queue [DUMP.queue_len++] = imgnum;
+    DUMP.ready.notify_one ();
+}
+
+// 1 if arg is the dump option
+int TreeDumpOption (const char *arg)
+{
+    size_t len = strlen (DUMP_OPTION);
+
+    if (arg == nullptr || strncmp (arg, DUMP_OPTION, len) != 0) return 0;
+
+    if      (arg [len] == '\0') DUMP.level = DUMP_IMAGES;
+    else if (arg [len] ==  '=')  DUMP.level = atoi (arg + len + 1);
+    else return 0;
+
+    DUMP.option_set = 1;
+    return 1;
+}
+
+// dumps are off unless asked for, by the option or by the environment
+void TreeDumpStart (void)
+{
+    if (!DUMP.option_set)
+    {
+        const char *env = getenv (DUMP_ENV);
+        if (env != nullptr) DUMP.level = atoi (env);
+    }
+
+    if (DUMP.level <= DUMP_OFF) return;
+
+    LOG = fopen (LOGFILENAME, "w");
+    if (LOG == nullptr)
+    {
+        DUMP.level = DUMP_OFF;
+        return;
+    }
+
+    fprintf (LOG, "<pre>\n");
+
+    if (DUMP.level >= DUMP_IMAGES) DUMP.worker = std::thread (Tree_render_worker);
+}
+
+// waits for the images still queued
+void TreeDumpFinish (void)
+{
+    if (DUMP.worker.joinable ())
+    {
+        {
+            std::lock_guard <std::mutex> guard (DUMP.lock);
+            DUMP.stop = 1;
+        }
+
+        DUMP.ready.notify_one ();
+        DUMP.worker.join ();
+    }
+
+    if (DUMP.imgnum >= 0)
+    {
+        FILE *numfile = fopen (IMGNUMFILE, "w");
+        if (numfile != nullptr)
+        {
+            fprintf (numfile, "%d", DUMP.imgnum);
             fclose (numfile);
         }
-        Tree_generate_img (tree, imgnum);
-        fprintf (LOG, "<img src=\"./images/dumpimg%d.png\", width=\"80%%\">", imgnum);
     }
 
+    free (DUMP.queue);
+    DUMP.queue         = nullptr;
+    DUMP.queue_len     = 0;
+    DUMP.queue_max_len = 0;
+
+    if (LOG != nullptr) fclose (LOG);
+    LOG = nullptr;
+}
+
+// takes everything queued so far and renders it with one dot run
+void Tree_render_worker (void)
+{
+    char cmd [DUMP_CMD_SIZE] = "";
+
+    while (1)
+    {
+        std::unique_lock <std::mutex> guard (DUMP.lock);
+        DUMP.ready.wait (guard, [] { return DUMP.queue_len > 0 || DUMP.stop; });
+
+        if (DUMP.queue_len == 0) return;
+
+        int len = snprintf (cmd, DUMP_CMD_SIZE, "dot -T png -O");
+        size_t taken = 0;
+
+        while (taken < DUMP.queue_len && (size_t) len + DUMP_NAME_LEN < DUMP_CMD_SIZE)
+        {
+            len += snprintf (cmd + len, DUMP_CMD_SIZE - (size_t) len, " ");
+            len += snprintf (cmd + len, DUMP_CMD_SIZE - (size_t) len, GRAPHFILE, DUMP.queue [taken++]);
+        }
+
+        DUMP.queue_len -= taken;
+        memmove (DUMP.queue, DUMP.queue + taken, DUMP.queue_len * sizeof (int));
+
+        guard.unlock ();
+
+        system (cmd);
+    }
 }
 
 
-void Tree_generate_img (Tree_t *tree, int imgnum)
+int Tree_generate_img (Tree_t *tree, int imgnum)
 {
-    FILE *graph = fopen (GRAPHFILE, "w");
-    if (graph == nullptr) return;
+    char graph_name [DUMP_NAME_LEN] = "";
+    snprintf (graph_name, DUMP_NAME_LEN, GRAPHFILE, imgnum);
+
+    FILE *graph = fopen (graph_name, "w");
+    if (graph == nullptr) return TREE_NULLPTR_ARG;
 
     fprintf (graph, "digraph {\n rankdir = TB;\n"
                     "node [shape = record, fontsize = 12, style = \"rounded, filled\", fillcolor = white];\n"
@@ -106,48 +288,63 @@ void Tree_generate_img (Tree_t *tree, int imgnum)
 
     fclose (graph);
 
-    char cmd [64] = "";
-    sprintf (cmd, "dot -T png -o log/images/dumpimg%d.png %s", imgnum, GRAPHFILE);
-    system (cmd);
+    return TREE_OK;
 }
 
 void Tree_draw_data (FILE *graph, TreeElem_t *elem, int rank, int *size, int print_adress)
 {
-    if (*size < 0 || elem == nullptr) return;
+    Tree_draw_t draw = {graph, size, print_adress};
 
-    fprintf (graph, "r%d [style = invis];\n", rank);
-    if (TYPE >= 0 && TYPE <= 10) fprintf (graph, "elem%p [label = \"{type = %s|value = %d", elem, TYPES [TYPE], VAL);
-    else                         fprintf (graph, "elem%p [label = \"{type = %d|value = %d", elem, TYPE        , VAL);
+    TreeWalk (elem, Tree_draw_step, &draw, rank);
+}
 
+int Tree_draw_step (TreeWalk_t *frame, TreeWalk_t *child, void *ctx)
+{
+    Tree_draw_t *draw = (Tree_draw_t *) ctx;
+    FILE *graph = draw -> graph;
+    TreeElem_t *elem = frame -> elem;
 
-    if (print_adress) fprintf (graph, "|{{adress|parent|left|right}|{%p|%p|%p|%p}}}\"", elem, P, L, R);
-    else              fprintf (graph, "}\"");
+    int rank = frame -> arg;
 
-    if (TYPE >= 0 && TYPE <= 10) fprintf (graph, ", fillcolor = %s", COLORS [TYPE]);
+    // a node left over from a loop in the links, the rest is not drawn
+    if (*(draw -> size) < 0) return WALK_DONE;
 
-    if (rank == 0)
+    if (frame -> step == 0)
     {
-        fprintf (graph, ", color = red");
-    }
+        fprintf (graph, "r%d [style = invis];\n", rank);
+        if (TYPE >= 0 && TYPE <= TYPE_BLOCK) fprintf (graph, "elem%p [label = \"{type = %s|value = %d", elem, TYPES [TYPE], VAL);
+        else                                 fprintf (graph, "elem%p [label = \"{type = %d|value = %d", elem, TYPE        , VAL);
 
-    fprintf (graph, "];\n");
-    fprintf (graph, "{rank = same; \"r%d\"; \"elem%p\"}", rank, elem);
 
-    *size -= 1;
+        if (draw -> print_adress) fprintf (graph, "|{{adress|parent|left|right}|{%p|%p|%p|%p}}}\"", elem, P, L, R);
+        else                      fprintf (graph, "}\"");
 
-    if (P)
-    {
-        fprintf (graph, "elem%p -> elem%p [color = %s, weight = 1];\n", elem, P, PARENTCOLOR);
-    }
+        if (TYPE >= 0 && TYPE <= TYPE_BLOCK) fprintf (graph, ", fillcolor = %s", COLORS [TYPE]);
 
-    if (L)
-    {
-        fprintf (graph, "elem%p -> elem%p [color = %s, weight = 1];\n", elem, L, LEFTCOLOR);
-        Tree_draw_data (graph, L, rank + 1, size, print_adress);
-    }
-    if (R)
-    {
-        fprintf (graph, "elem%p -> elem%p [color = %s, weight = 1];\n", elem, R, RIGHTCOLOR);
-        Tree_draw_data (graph, R, rank + 1, size, print_adress);
+        if (rank == 0)
+        {
+            fprintf (graph, ", color = red");
+        }
+
+        fprintf (graph, "];\n");
+        fprintf (graph, "{rank = same; \"r%d\"; \"elem%p\"}", rank, elem);
+
+        *(draw -> size) -= 1;
+
+        if (P)
+        {
+            fprintf (graph, "elem%p -> elem%p [color = %s, weight = 1];\n", elem, P, PARENTCOLOR);
+        }
     }
+
+    if (frame -> step >= TreeChildrenNum (elem)) return WALK_DONE;
+
+    child -> elem = TreeChild (elem, frame -> step);
+    child -> arg  = frame -> arg + 1;
+
+    const char *color = TYPE == TYPE_BLOCK ? STMTCOLOR : frame -> step == 0 ? LEFTCOLOR : RIGHTCOLOR;
+
+    if (child -> elem) fprintf (graph, "elem%p -> elem%p [color = %s, weight = 1];\n", elem, child -> elem, color);
+
+    return WALK_CHILD;
 }